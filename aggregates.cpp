@@ -0,0 +1,155 @@
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+#include "aggregates.h"
+#include "bytes.h"
+#include "metrics.h"
+
+using namespace std;
+
+// Tournament Tree
+
+void extrema_init(ExtremaTree &tree, const vector<int32_t> &values) {
+  tree.leaves = 1;
+  while (tree.leaves < values.size())
+    tree.leaves <<= 1;
+  tree.nodes.assign(2 * tree.leaves, EXTREMA_NONE);
+  for (size_t i = 0; i < values.size(); ++i)
+    tree.nodes[tree.leaves + i] = values[i];
+  for (uint32_t i = tree.leaves - 1; i > 0; --i)
+    tree.nodes[i] = max(tree.nodes[2 * i], tree.nodes[2 * i + 1]);
+}
+
+void extrema_set(ExtremaTree &tree, uint32_t index, int32_t value) {
+  uint32_t i = tree.leaves + index;
+  tree.nodes[i] = value;
+  for (i >>= 1; i > 0; i >>= 1) {
+    int32_t top = max(tree.nodes[2 * i], tree.nodes[2 * i + 1]);
+    if (tree.nodes[i] == top)
+      break; // nothing above changes either
+    tree.nodes[i] = top;
+  }
+}
+
+int32_t extrema_top(const ExtremaTree &tree) {
+  return tree.nodes.size() > 1 ? tree.nodes[1] : EXTREMA_NONE;
+}
+
+// Aggregates
+
+static void glyph_leaves(const FontAggregates &aggregates, uint16_t glyph,
+                         const GlyphBounds &b, int32_t *leaf) {
+  for (int a = 0; a < AGG_COUNT; ++a)
+    leaf[a] = EXTREMA_NONE;
+  if (b.empty)
+    return;
+  leaf[AGG_X_MIN] = -b.xMin;
+  leaf[AGG_Y_MIN] = -b.yMin;
+  leaf[AGG_X_MAX] = b.xMax;
+  leaf[AGG_Y_MAX] = b.yMax;
+  leaf[AGG_POINTS] = b.points;
+  leaf[AGG_CONTOURS] = b.contours;
+  if (glyph < aggregates.advances.size()) {
+    int32_t lsb = aggregates.lsbs[glyph];
+    int32_t extent = lsb + (b.xMax - b.xMin);
+    leaf[AGG_LSB] = -lsb;
+    leaf[AGG_RSB] = -(aggregates.advances[glyph] - extent);
+    leaf[AGG_EXTENT] = extent;
+  }
+}
+
+FontAggregates build_font_aggregates(const VerifiedFont &font) {
+  FontAggregates aggregates;
+  shared_ptr<const HorizontalMetrics> metricsCache = font_horizontal_metrics(font);
+  const HorizontalMetrics &metrics = *metricsCache;
+  if (metrics.advances.size() >= font.numGlyphs) {
+    aggregates.advances = metrics.advances;
+    aggregates.lsbs = metrics.lsbs;
+  }
+  const uint8_t *head = table_data(font, TABLE_HEAD);
+  aggregates.lsbIsXMin = (be16(head + 16) & 0x0002) != 0;
+
+  vector<int32_t> values[AGG_COUNT];
+  for (auto &v : values)
+    v.resize(font.numGlyphs);
+  for (uint16_t g = 0; g < font.numGlyphs; ++g) {
+    GlyphBounds b = {true, 0, 0, 0, 0, 0, 0};
+    if (!font.cff && font.loca[g] != font.loca[g + 1]) {
+      // validate_font checked the header and endPts of every glyph
+      const uint8_t *glyph = font.data.data() + font.glyfOffset + font.loca[g];
+      int16_t contours = (int16_t)be16(glyph);
+      b.empty = false;
+      b.xMin = (int16_t)be16(glyph + 2);
+      b.yMin = (int16_t)be16(glyph + 4);
+      b.xMax = (int16_t)be16(glyph + 6);
+      b.yMax = (int16_t)be16(glyph + 8);
+      if (contours > 0) {
+        b.contours = contours;
+        b.points = be16(glyph + 10 + 2 * (contours - 1)) + 1;
+      }
+    }
+    int32_t leaf[AGG_COUNT];
+    glyph_leaves(aggregates, g, b, leaf);
+    for (int a = 0; a < AGG_COUNT; ++a)
+      values[a][g] = leaf[a];
+  }
+  for (int a = 0; a < AGG_COUNT; ++a)
+    extrema_init(aggregates.trees[a], values[a]);
+  return aggregates;
+}
+
+void set_glyph_bounds(FontAggregates &aggregates, uint16_t glyph, const GlyphBounds &bounds) {
+  if (aggregates.lsbIsXMin && !bounds.empty && glyph < aggregates.lsbs.size())
+    aggregates.lsbs[glyph] = bounds.xMin;
+  int32_t leaf[AGG_COUNT];
+  glyph_leaves(aggregates, glyph, bounds, leaf);
+  for (int a = 0; a < AGG_COUNT; ++a)
+    extrema_set(aggregates.trees[a], glyph, leaf[a]);
+}
+
+static void put16(vector<uint8_t> &font, size_t offset, int32_t value) {
+  font[offset] = (uint8_t)(value >> 8);
+  font[offset + 1] = (uint8_t)value;
+}
+
+void write_font_aggregates(const FontAggregates &aggregates, const vector<uint16_t> &edited,
+                           vector<uint8_t> &font, const TableDirectory &tables) {
+  const ExtremaTree *t = aggregates.trees;
+  // a font with no outlines at all keeps its old values
+  if (extrema_top(t[AGG_X_MAX]) == EXTREMA_NONE)
+    return;
+
+  const TableRecord *head = find_table(tables, TABLE_HEAD);
+  const TableRecord *maxp = find_table(tables, TABLE_MAXP);
+  if (!head || !maxp)
+    return;
+  put16(font, head->offset + 36, -extrema_top(t[AGG_X_MIN]));
+  put16(font, head->offset + 38, -extrema_top(t[AGG_Y_MIN]));
+  put16(font, head->offset + 40, extrema_top(t[AGG_X_MAX]));
+  put16(font, head->offset + 42, extrema_top(t[AGG_Y_MAX]));
+
+  // maxPoints/maxContours only exist in maxp version 1.0
+  if (maxp->length >= 32 && be32(&font[maxp->offset]) == 0x00010000) {
+    put16(font, maxp->offset + 6, max(extrema_top(t[AGG_POINTS]), 0));
+    put16(font, maxp->offset + 8, max(extrema_top(t[AGG_CONTOURS]), 0));
+  }
+
+  const TableRecord *hhea = find_table(tables, TABLE_HHEA);
+  const TableRecord *hmtx = find_table(tables, TABLE_HMTX);
+  if (aggregates.advances.empty() || !hhea || !hmtx)
+    return;
+  put16(font, hhea->offset + 12, -extrema_top(t[AGG_LSB]));
+  put16(font, hhea->offset + 14, -extrema_top(t[AGG_RSB]));
+  put16(font, hhea->offset + 16, extrema_top(t[AGG_EXTENT]));
+
+  if (!aggregates.lsbIsXMin)
+    return;
+  uint32_t numberOfHMetrics = be16(&font[hhea->offset + 34]);
+  for (uint16_t g : edited) {
+    size_t offset = g < numberOfHMetrics
+                        ? 4 * g + 2
+                        : 4 * numberOfHMetrics + 2 * (g - numberOfHMetrics);
+    put16(font, hmtx->offset + offset, aggregates.lsbs[g]);
+  }
+}
@@ -0,0 +1,62 @@
+#ifndef AGGREGATES_H
+#define AGGREGATES_H
+
+#include <cstdint>
+#include <vector>
+
+#include "font.h"
+
+// Tournament tree over one int32 per glyph: every internal node holds the
+// larger child, so changing a leaf rewrites one root path and the maximum
+// is nodes[1]. Minima are kept as negated values.
+struct ExtremaTree {
+  uint32_t leaves = 0; // power of two
+  std::vector<int32_t> nodes;
+};
+
+static const int32_t EXTREMA_NONE = INT32_MIN; // leaf of a glyph that does not count
+
+void extrema_init(ExtremaTree &tree, const std::vector<int32_t> &values);
+void extrema_set(ExtremaTree &tree, uint32_t index, int32_t value);
+int32_t extrema_top(const ExtremaTree &tree);
+
+// What a glyph contributes to head/maxp/hhea. Composite glyphs count for
+// the bounds but not for the simple-glyph point/contour maxima.
+struct GlyphBounds {
+  bool empty;
+  int16_t xMin, yMin, xMax, yMax;
+  uint16_t points, contours;
+};
+
+enum FontAggregate {
+  AGG_X_MIN,    // negated
+  AGG_Y_MIN,    // negated
+  AGG_X_MAX,
+  AGG_Y_MAX,
+  AGG_POINTS,
+  AGG_CONTOURS,
+  AGG_LSB,      // negated
+  AGG_RSB,      // negated
+  AGG_EXTENT,
+  AGG_COUNT,
+};
+
+// Per-glyph inputs of the head bbox, maxp maxPoints/maxContours and hhea
+// minLeftSideBearing/minRightSideBearing/xMaxExtent, built with one scan
+// of glyf and then updated glyph by glyph as edits are written.
+struct FontAggregates {
+  std::vector<uint16_t> advances;
+  std::vector<int16_t> lsbs;
+  bool lsbIsXMin = false; // head flags bit 1: edits move the hmtx lsb too
+  ExtremaTree trees[AGG_COUNT];
+};
+
+FontAggregates build_font_aggregates(const VerifiedFont &font);
+void set_glyph_bounds(FontAggregates &aggregates, uint16_t glyph, const GlyphBounds &bounds);
+
+// Patches head, maxp and hhea in the font bytes from the tree roots, and
+// the hmtx lsb of each glyph in edited when lsbIsXMin.
+void write_font_aggregates(const FontAggregates &aggregates, const std::vector<uint16_t> &edited,
+                           std::vector<uint8_t> &font, const TableDirectory &tables);
+
+#endif
@@ -0,0 +1,45 @@
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+#include "arena.h"
+
+using namespace std;
+
+void *arena_alloc(Arena &arena, size_t bytes, size_t align) {
+  while (arena.current < arena.blocks.size()) {
+    ArenaBlock &block = arena.blocks[arena.current];
+    size_t start = (arena.offset + align - 1) & ~(align - 1);
+    if (start + bytes <= block.size) {
+      arena.offset = start + bytes;
+      return block.data.get() + start;
+    }
+    // blocks kept from an earlier request are reused before growing
+    ++arena.current;
+    arena.offset = 0;
+  }
+
+  size_t size = max(arena.blockSize, bytes + align);
+  arena.blocks.push_back({unique_ptr<uint8_t[]>(new uint8_t[size]), size});
+  arena.current = arena.blocks.size() - 1;
+  arena.offset = 0;
+  return arena_alloc(arena, bytes, align);
+}
+
+void arena_reset(Arena &arena) {
+  arena.current = 0;
+  arena.offset = 0;
+}
+
+void arena_release(Arena &arena) {
+  arena.blocks.clear();
+  arena_reset(arena);
+}
+
+size_t arena_capacity(const Arena &arena) {
+  size_t total = 0;
+  for (const ArenaBlock &block : arena.blocks)
+    total += block.size;
+  return total;
+}
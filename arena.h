@@ -0,0 +1,33 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+struct ArenaBlock {
+  std::unique_ptr<uint8_t[]> data;
+  size_t size;
+};
+
+// Bump-pointer allocator. Everything allocated from it is released together
+// by arena_reset (which keeps the blocks for the next request) or
+// arena_release (which returns them to the heap).
+struct Arena {
+  std::vector<ArenaBlock> blocks;
+  size_t current = 0; // block being bumped
+  size_t offset = 0;  // next free byte in blocks[current]
+  size_t blockSize = 1 << 16;
+};
+
+void *arena_alloc(Arena &arena, size_t bytes, size_t align);
+void arena_reset(Arena &arena);
+void arena_release(Arena &arena);
+size_t arena_capacity(const Arena &arena);
+
+template <typename T> T *arena_array(Arena &arena, size_t count) {
+  return static_cast<T *>(arena_alloc(arena, count * sizeof(T), alignof(T)));
+}
+
+#endif
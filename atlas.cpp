@@ -0,0 +1,297 @@
+#include <algorithm>
+#include <climits>
+#include <cmath>
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "atlas.h"
+#include "cmap.h"
+#include "decode.h"
+#include "flatten.h"
+#include "outline.h"
+#include "parallel.h"
+
+using namespace std;
+
+static const int ATLAS_PADDING = 1;      // empty pixels between packed glyphs
+static const float FLATTEN_TOLERANCE = 0.2f; // pixels
+
+struct Line {
+  float ax, ay, bx, by;
+};
+
+// Signed Distance Field
+
+static void flatten(const vector<Segment> &segments, vector<Line> &lines) {
+  vector<float> coords;
+  for (const Segment &s : segments) {
+    coords.clear();
+    append_segment_points(s, segment_steps(s, FLATTEN_TOLERANCE), coords);
+    float px = s.x0, py = s.y0;
+    for (size_t i = 0; i < coords.size(); i += 2) {
+      lines.push_back({px, py, coords[i], coords[i + 1]});
+      px = coords[i];
+      py = coords[i + 1];
+    }
+  }
+}
+
+// False, leaving the entry empty, when the glyph's cell would be larger
+// than ATLAS_MAX_CELL
+static bool compute_sdf(const vector<vector<Point>> &glyph, float scale,
+                        int spread, SdfCacheEntry &entry) {
+  entry.width = entry.height = 0;
+  entry.left = entry.top = 0;
+  entry.pixels.clear();
+
+  int xMin = INT_MAX, yMin = INT_MAX, xMax = INT_MIN, yMax = INT_MIN;
+  for (const auto &contour : glyph) {
+    for (const Point &p : contour) {
+      xMin = min(xMin, p.x);
+      yMin = min(yMin, p.y);
+      xMax = max(xMax, p.x);
+      yMax = max(yMax, p.y);
+    }
+  }
+  if (xMin > xMax)
+    return true; // no outline
+
+  int w = (int)ceil((xMax - xMin) * scale) + 2 * spread;
+  int h = (int)ceil((yMax - yMin) * scale) + 2 * spread;
+  if (w > ATLAS_MAX_CELL || h > ATLAS_MAX_CELL)
+    return false;
+
+  // Work in bitmap space (y down) so pixel centres are at i + 0.5
+  vector<Segment> segments = glyph_to_segments(glyph);
+  for (Segment &s : segments) {
+    s.x0 = (s.x0 - xMin) * scale + spread;
+    s.cx = (s.cx - xMin) * scale + spread;
+    s.cx2 = (s.cx2 - xMin) * scale + spread;
+    s.x1 = (s.x1 - xMin) * scale + spread;
+    s.y0 = (yMax - s.y0) * scale + spread;
+    s.cy = (yMax - s.cy) * scale + spread;
+    s.cy2 = (yMax - s.cy2) * scale + spread;
+    s.y1 = (yMax - s.y1) * scale + spread;
+  }
+  vector<Line> lines;
+  flatten(segments, lines);
+
+  entry.width = w;
+  entry.height = h;
+  entry.left = xMin * scale - spread;
+  entry.top = yMax * scale + spread;
+  entry.pixels.resize((size_t)w * h);
+
+  float range = spread > 0 ? spread : 1;
+  for (int j = 0; j < h; ++j) {
+    float py = j + 0.5f;
+    for (int i = 0; i < w; ++i) {
+      float px = i + 0.5f;
+      float best = 1e30f;
+      int winding = 0;
+      for (const Line &l : lines) {
+        float ex = l.bx - l.ax, ey = l.by - l.ay;
+        float wx = px - l.ax, wy = py - l.ay;
+        float len2 = ex * ex + ey * ey;
+        float t = len2 > 0 ? (wx * ex + wy * ey) / len2 : 0;
+        t = max(0.0f, min(1.0f, t));
+        float dx = wx - ex * t, dy = wy - ey * t;
+        best = min(best, dx * dx + dy * dy);
+
+        // nonzero winding of a ray cast towards +x
+        float cross = ex * wy - ey * wx;
+        if (l.ay <= py) {
+          if (l.by > py && cross > 0)
+            ++winding;
+        } else if (l.by <= py && cross < 0) {
+          --winding;
+        }
+      }
+      float d = sqrt(best);
+      if (winding == 0)
+        d = -d;
+      int v = (int)lround(128 + d * 127 / range);
+      entry.pixels[(size_t)j * w + i] = (uint8_t)max(0, min(255, v));
+    }
+  }
+  return true;
+}
+
+// Skyline Packer
+
+struct SkylineNode {
+  int x, y, width;
+};
+
+// Lowest y at which a w-wide rectangle fits on the skyline starting at node i
+static int skyline_fit(const vector<SkylineNode> &nodes, size_t i, int w,
+                       int atlasWidth) {
+  if (nodes[i].x + w > atlasWidth)
+    return -1;
+  int y = 0;
+  int left = w;
+  while (left > 0 && i < nodes.size()) {
+    y = max(y, nodes[i].y);
+    left -= nodes[i].width;
+    ++i;
+  }
+  return y;
+}
+
+static void skyline_add(vector<SkylineNode> &nodes, size_t i, int x, int y,
+                        int w) {
+  nodes.insert(nodes.begin() + i, {x, y, w});
+  // trim nodes shadowed by the new one
+  for (size_t k = i + 1; k < nodes.size();) {
+    int end = nodes[k - 1].x + nodes[k - 1].width;
+    if (nodes[k].x >= end)
+      break;
+    int shrink = end - nodes[k].x;
+    nodes[k].x += shrink;
+    nodes[k].width -= shrink;
+    if (nodes[k].width > 0)
+      break;
+    nodes.erase(nodes.begin() + k);
+  }
+  for (size_t k = 0; k + 1 < nodes.size();) {
+    if (nodes[k].y == nodes[k + 1].y) {
+      nodes[k].width += nodes[k + 1].width;
+      nodes.erase(nodes.begin() + k + 1);
+    } else {
+      ++k;
+    }
+  }
+}
+
+// Places every non-empty glyph and returns the used height
+static int pack(vector<AtlasGlyph> &placed, int atlasWidth) {
+  vector<size_t> order;
+  for (size_t i = 0; i < placed.size(); ++i) {
+    if (placed[i].width > 0)
+      order.push_back(i);
+  }
+  sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+    if (placed[a].height != placed[b].height)
+      return placed[a].height > placed[b].height;
+    return placed[a].width > placed[b].width;
+  });
+
+  vector<SkylineNode> nodes = {{0, 0, atlasWidth}};
+  int used = 0;
+  for (size_t idx : order) {
+    int w = placed[idx].width + ATLAS_PADDING;
+    int h = placed[idx].height + ATLAS_PADDING;
+    int bestY = INT_MAX, bestWidth = INT_MAX;
+    size_t bestNode = 0;
+    for (size_t i = 0; i < nodes.size(); ++i) {
+      int y = skyline_fit(nodes, i, w, atlasWidth);
+      if (y < 0)
+        continue;
+      if (y + h < bestY || (y + h == bestY && nodes[i].width < bestWidth)) {
+        bestY = y + h;
+        bestWidth = nodes[i].width;
+        bestNode = i;
+      }
+    }
+    int x = nodes[bestNode].x;
+    int y = bestY - h;
+    skyline_add(nodes, bestNode, x, bestY, w);
+    placed[idx].x = x;
+    placed[idx].y = y;
+    used = max(used, bestY);
+  }
+  return used;
+}
+
+// Baking
+
+static SdfAtlas atlas_error(int glyph, const string &message) {
+  SdfAtlas atlas = {{false, FONT_BAD_ARGUMENT, "", glyph, message}, 0, 0, {}, {}, {}};
+  return atlas;
+}
+
+SdfAtlas bake_atlas(const VerifiedFont &font, float pxSize, int spread,
+                    int atlasWidth, AtlasCache &cache) {
+  // also false for NaN
+  if (!(pxSize > 0 && pxSize <= ATLAS_MAX_PX_SIZE))
+    return atlas_error(-1, "px_size must be in (0, " + to_string((int)ATLAS_MAX_PX_SIZE) + "]");
+  if (spread < 0 || spread > ATLAS_MAX_SPREAD)
+    return atlas_error(-1, "spread must be in [0, " + to_string(ATLAS_MAX_SPREAD) + "]");
+  if (atlasWidth <= 0)
+    return atlas_error(-1, "atlas_width must be positive");
+
+  size_t numGlyphs = font.numGlyphs;
+  if (cache.pxSize != pxSize || cache.spread != spread ||
+      cache.unitsPerEm != font.unitsPerEm) {
+    cache.entries.clear();
+    cache.pxSize = pxSize;
+    cache.spread = spread;
+    cache.unitsPerEm = font.unitsPerEm;
+  }
+  if (cache.entries.size() != numGlyphs) {
+    cache.entries.resize(numGlyphs, SdfCacheEntry{-1, -1, 0, 0, {}});
+    cache.codepoints.clear();
+    for (const auto &pair : char_map_forward(*font_char_map(font))) {
+      if (pair.first <= 0xFFFF && pair.second < numGlyphs)
+        cache.codepoints[pair.first] = pair.second;
+    }
+  }
+
+  // only glyphs never baked or dropped by an edit are decoded and rendered
+  vector<uint16_t> dirty;
+  for (size_t i = 0; i < numGlyphs; ++i) {
+    if (cache.entries[i].width < 0)
+      dirty.push_back(i);
+  }
+
+  float scale = pxSize / (font.unitsPerEm > 0 ? font.unitsPerEm : 1000);
+  parallel_for(dirty.size(), 1, [&](size_t k) {
+    SdfCacheEntry &entry = cache.entries[dirty[k]];
+    // a glyph too large to bake stays unbaked, so it is tried again
+    if (!compute_sdf(decode_glyph(font, dirty[k]), scale, spread, entry))
+      entry.width = -1;
+  });
+  cache.bytes = cache.entries.capacity() * sizeof(SdfCacheEntry);
+  for (const SdfCacheEntry &entry : cache.entries)
+    cache.bytes += entry.pixels.capacity();
+  for (const auto &pair : cache.codepoints)
+    cache.bytes += sizeof(pair) + 32; // map node overhead
+
+  SdfAtlas atlas;
+  atlas.status = {true, FONT_OK, "", -1, ""};
+  atlas.glyphs.resize(numGlyphs);
+  for (size_t i = 0; i < numGlyphs; ++i) {
+    const SdfCacheEntry &e = cache.entries[i];
+    if (e.width < 0)
+      return atlas_error(i, "glyph cell larger than " + to_string(ATLAS_MAX_CELL) + " pixels");
+    if (e.width + ATLAS_PADDING > atlasWidth)
+      return atlas_error(i, "atlas_width smaller than the glyph's cell");
+    atlas.glyphs[i] = {(uint16_t)i, 0, 0, e.width, e.height, e.left, e.top};
+  }
+
+  atlas.width = atlasWidth;
+  atlas.height = (pack(atlas.glyphs, atlasWidth) + 3) & ~3;
+  atlas.bitmap.assign((size_t)atlas.width * atlas.height, 0);
+  for (size_t i = 0; i < numGlyphs; ++i) {
+    const AtlasGlyph &g = atlas.glyphs[i];
+    const SdfCacheEntry &e = cache.entries[i];
+    for (int row = 0; row < g.height; ++row) {
+      copy(e.pixels.begin() + (size_t)row * e.width,
+           e.pixels.begin() + (size_t)(row + 1) * e.width,
+           atlas.bitmap.begin() + (size_t)(g.y + row) * atlas.width + g.x);
+    }
+  }
+  atlas.codepoints = cache.codepoints;
+
+  return atlas;
+}
+
+void drop_sdf(AtlasCache &cache, uint16_t glyph) {
+  if (glyph >= cache.entries.size())
+    return;
+  SdfCacheEntry &entry = cache.entries[glyph];
+  cache.bytes -= entry.pixels.capacity();
+  entry = SdfCacheEntry{-1, -1, 0, 0, {}};
+}
@@ -0,0 +1,60 @@
+#ifndef ATLAS_H
+#define ATLAS_H
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <vector>
+
+#include "font.h"
+#include "validate.h"
+
+struct AtlasGlyph {
+  uint16_t glyph;
+  int x, y;          // top-left corner in the atlas bitmap
+  int width, height; // 0 for empty glyphs
+  float left, top;   // bitmap origin in pixels relative to the glyph origin
+};
+
+// Largest pixel size baked, and the largest spread and glyph cell side at
+// any size. A distance field scales well past the size it was baked at, and
+// every pixel is measured against every edge, so bakes past these take
+// minutes or run out of memory.
+static const float ATLAS_MAX_PX_SIZE = 128;
+static const int ATLAS_MAX_SPREAD = 64;
+static const int ATLAS_MAX_CELL = 1024;
+
+struct SdfAtlas {
+  FontDiagnostic status; // FONT_BAD_ARGUMENT for a size the bake refuses
+  int width, height;
+  std::vector<uint8_t> bitmap; // one byte per pixel, 128 on the outline
+  std::vector<AtlasGlyph> glyphs; // indexed by glyph index
+  std::map<uint16_t, uint16_t> codepoints; // code point -> glyph index
+};
+
+// Keeps each glyph's last SDF so a re-bake only renders glyphs dropped by an
+// edit since the previous call. A width of -1 marks a glyph not baked yet.
+struct SdfCacheEntry {
+  int width, height;
+  float left, top;
+  std::vector<uint8_t> pixels;
+};
+
+struct AtlasCache {
+  float pxSize = 0;
+  int spread = 0;
+  int unitsPerEm = 0;
+  std::vector<SdfCacheEntry> entries;
+  std::map<uint16_t, uint16_t> codepoints; // BMP code point -> glyph index
+  size_t bytes = 0; // entries, their pixels and codepoints
+};
+
+// Fails without baking when pxSize is not in (0, ATLAS_MAX_PX_SIZE], spread
+// not in [0, ATLAS_MAX_SPREAD], a glyph's cell is larger than
+// ATLAS_MAX_CELL or atlasWidth cannot hold the widest cell.
+SdfAtlas bake_atlas(const VerifiedFont &font, float pxSize, int spread,
+                    int atlasWidth, AtlasCache &cache);
+// Marks an edited glyph for the next bake to render again
+void drop_sdf(AtlasCache &cache, uint16_t glyph);
+
+#endif
@@ -0,0 +1,357 @@
+// Native throughput harness for the parsing paths. Not part of the wasm
+// build: compile it with every module except main.cpp and openttf2.cpp.
+//
+//   bench <font-dir> <baseline.json>
+//       runs open, cmap, decode and writeback over every .ttf/.otf in the
+//       directory and writes per-font and aggregate results. Writeback runs
+//       on a copy reorganized into the editing layout, as the editor does.
+//   bench --compare <baseline.json> <font-dir> [threshold-percent]
+//       runs again and exits 1 if any metric regressed past the threshold
+//       (default 10%)
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <new>
+#include <string>
+#include <vector>
+
+#include <sys/resource.h>
+
+#include "arena.h"
+#include "bytes.h"
+#include "cmap.h"
+#include "decode.h"
+#include "reorganize.h"
+#include "validate.h"
+#include "writeback.h"
+
+using namespace std;
+
+// Allocation Counting
+
+static atomic<uint64_t> allocations(0);
+
+void *operator new(size_t size) {
+  allocations++;
+  if (void *p = malloc(size ? size : 1))
+    return p;
+#ifdef __cpp_exceptions
+  throw bad_alloc();
+#else
+  abort(); // the wasm flags build without exceptions
+#endif
+}
+
+void operator delete(void *p) noexcept { free(p); }
+void operator delete(void *p, size_t) noexcept { free(p); }
+
+// Linux lets the high-water mark be reset through clear_refs, so each phase
+// gets its own peak. Elsewhere the reset does nothing and every phase sees
+// the peak so far.
+static long run_peak_kb = 0; // the largest peak seen, since resets lose it
+
+static void reset_peak_rss() {
+  ofstream("/proc/self/clear_refs") << "5";
+}
+
+static long peak_rss_kb() {
+  long peak = 0;
+  ifstream status("/proc/self/status");
+  string line;
+  while (getline(status, line)) {
+    if (line.compare(0, 6, "VmHWM:") == 0)
+      peak = atol(line.c_str() + 6);
+  }
+  if (!peak) {
+    rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    peak = usage.ru_maxrss; // kilobytes on Linux
+  }
+  run_peak_kb = max(run_peak_kb, peak);
+  return peak;
+}
+
+// Metrics; names ending in _per_s are higher-is-better, the rest lower
+
+typedef map<string, double> Metrics;
+
+// Timing
+
+static const double MIN_PHASE_SECONDS = 0.2; // repeat short phases to this
+static const int MAX_REPEATS = 50;
+static const int WRITEBACK_GLYPHS = 64;
+
+struct PhaseResult {
+  double seconds = 0;      // fastest run
+  uint64_t allocations = 0; // in the fastest run
+  long peakRssKb = 0;       // over all runs
+};
+
+template <typename F> static PhaseResult time_phase(F run) {
+  PhaseResult best;
+  double total = 0;
+  reset_peak_rss();
+  for (int i = 0; i < MAX_REPEATS && (i == 0 || total < MIN_PHASE_SECONDS); ++i) {
+    uint64_t before = allocations;
+    auto start = chrono::steady_clock::now();
+    run();
+    double s = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    total += s;
+    if (i == 0 || s < best.seconds)
+      best = {s, allocations - before};
+  }
+  best.peakRssKb = peak_rss_kb();
+  return best;
+}
+
+static void add_phase(Metrics &m, const string &phase, const PhaseResult &result) {
+  m[phase + "_allocs"] = result.allocations;
+  m[phase + "_peak_rss_kb"] = result.peakRssKb;
+}
+
+
+static bool higher_is_better(const string &metric) {
+  return metric.size() > 6 && metric.compare(metric.size() - 6, 6, "_per_s") == 0;
+}
+
+static Metrics bench_font(const string &path, string &error) {
+  Metrics m;
+  vector<uint8_t> bytes;
+  if (!read_file_bytes(path, bytes)) {
+    error = "cannot read file";
+    return m;
+  }
+  double mb = bytes.size() / 1e6;
+
+  VerifiedFont font;
+  FontDiagnostic diag;
+  PhaseResult open = time_phase([&] { diag = validate_font(bytes, font); });
+  if (!diag.ok) {
+    error = diag.message;
+    return m;
+  }
+  m["open_mb_per_s"] = mb / open.seconds;
+  add_phase(m, "open", open);
+
+  // parse plus one lookup per BMP code point
+  uint64_t sink = 0;
+  TableBytes table = table_bytes(font, TABLE_CMAP);
+  PhaseResult cmap = time_phase([&] {
+    CharMap map = parse_char_map(table.data, table.size);
+    for (uint32_t c = 0; c < 0x10000; ++c)
+      sink += char_map_lookup(map, c);
+  });
+  m["cmap_lookups_per_s"] = 0x10000 / cmap.seconds;
+  m["cmap_mb_per_s"] = table.size / 1e6 / cmap.seconds;
+  add_phase(m, "cmap", cmap);
+
+  Arena arena;
+  uint64_t points = 0;
+  PhaseResult decode = time_phase([&] {
+    arena_reset(arena);
+    OutlineBatch batch = decode_outlines(font, 0, font.numGlyphs, arena);
+    for (uint32_t i = 0; i < batch.count; ++i)
+      points += batch.glyphs[i].numPoints;
+  });
+  m["decode_glyphs_per_s"] = font.numGlyphs / decode.seconds;
+  m["decode_mb_per_s"] = mb / decode.seconds;
+  add_phase(m, "decode", decode);
+
+  // rewrites the first simple glyphs with their own points
+  if (!font.cff) {
+    map<uint16_t, vector<WBPoint>> glyphs;
+    for (uint16_t g = 0; g < font.numGlyphs && glyphs.size() < WRITEBACK_GLYPHS; ++g) {
+      arena_reset(arena);
+      GlyphOutline outline = decode_outline(font, g, arena);
+      if (outline.numContours == 0)
+        continue;
+      vector<WBPoint> &wb = glyphs[g];
+      for (uint32_t i = 0; i < outline.numPoints; ++i)
+        wb.push_back({outline.points[i].x, outline.points[i].y, outline.points[i].onCurve, false});
+      for (int c = 0; c < outline.numContours; ++c)
+        wb[outline.contourEnds[c]].endPt = true;
+    }
+    string slack = path + ".bench-slack.ttf", scratch = path + ".bench.ttf";
+    diag = reorganize(path, slack);
+    PhaseResult write;
+    if (diag.ok)
+      write = time_phase([&] { diag = writeback(slack, scratch, glyphs); });
+    double slackMb = diag.ok ? filesystem::file_size(slack) / 1e6 : 0;
+    remove(slack.c_str());
+    remove(scratch.c_str());
+    if (!diag.ok) {
+      error = "writeback: " + diag.message;
+      return m;
+    }
+    m["writeback_glyphs_per_s"] = glyphs.size() / write.seconds;
+    m["writeback_mb_per_s"] = slackMb / write.seconds;
+    add_phase(m, "writeback", write);
+  }
+
+  m["glyphs"] = font.numGlyphs;
+  if (sink == 1 && points == 1)
+    printf("\n"); // keeps the loops from being optimized out
+  return m;
+}
+
+// Baseline Files
+
+// Font file names may hold quotes or backslashes
+static string json_escape(const string &s) {
+  string out;
+  for (char c : s) {
+    if (c == '"' || c == '\\') {
+      out += '\\';
+      out += c;
+    } else if ((unsigned char)c < 0x20) {
+      char code[8];
+      snprintf(code, sizeof(code), "\\u%04x", c);
+      out += code;
+    } else {
+      out += c;
+    }
+  }
+  return out;
+}
+
+// The string starting at s[at], just past its opening quote; at is left on
+// the closing quote. Only the escapes json_escape writes are undone.
+static string json_unescape(const string &s, size_t &at) {
+  string out;
+  for (; at < s.size() && s[at] != '"'; ++at) {
+    if (s[at] != '\\' || at + 1 >= s.size()) {
+      out += s[at];
+    } else if (s[++at] == 'u' && at + 4 < s.size()) {
+      out += (char)strtol(s.substr(at + 1, 4).c_str(), nullptr, 16);
+      at += 4;
+    } else {
+      out += s[at];
+    }
+  }
+  return out;
+}
+
+// One font per line so --compare can read it back without a JSON library
+static void write_baseline(const string &path, const vector<pair<string, Metrics>> &fonts,
+                           const Metrics &aggregate) {
+  ofstream out(path);
+  auto write_metrics = [&](const Metrics &m) {
+    for (const auto &entry : m)
+      out << ", \"" << entry.first << "\": " << entry.second;
+  };
+  out << "{\n  \"fonts\": [\n";
+  for (size_t i = 0; i < fonts.size(); ++i) {
+    out << "    {\"name\": \"" << json_escape(fonts[i].first) << "\"";
+    write_metrics(fonts[i].second);
+    out << "}" << (i + 1 < fonts.size() ? "," : "") << "\n";
+  }
+  out << "  ],\n  \"aggregate\": {\"name\": \"*\"";
+  write_metrics(aggregate);
+  out << "}\n}\n";
+}
+
+static map<string, Metrics> read_baseline(const string &path) {
+  map<string, Metrics> fonts;
+  ifstream in(path);
+  string line;
+  while (getline(in, line)) {
+    size_t name = line.find("\"name\": \"");
+    if (name == string::npos)
+      continue;
+    name += 9;
+    string font = json_unescape(line, name);
+    Metrics &m = fonts[font];
+    for (size_t key = line.find(", \"", name); key != string::npos;
+         key = line.find(", \"", key + 1)) {
+      size_t end = line.find('"', key + 3);
+      m[line.substr(key + 3, end - key - 3)] = atof(line.c_str() + end + 3);
+    }
+  }
+  return fonts;
+}
+
+// Harness
+
+int main(int argc, char **argv) {
+  bool compare = argc >= 4 && string(argv[1]) == "--compare";
+  if (!compare && argc != 3) {
+    fprintf(stderr, "usage: bench <font-dir> <baseline.json>\n"
+                    "       bench --compare <baseline.json> <font-dir> [threshold-percent]\n");
+    return 2;
+  }
+  string dir = compare ? argv[3] : argv[1];
+  double threshold = compare && argc >= 5 ? atof(argv[4]) / 100 : 0.10;
+
+  vector<string> paths;
+  for (const auto &entry : filesystem::directory_iterator(dir)) {
+    string ext = entry.path().extension().string();
+    if (entry.is_regular_file() && (ext == ".ttf" || ext == ".otf"))
+      paths.push_back(entry.path().string());
+  }
+  sort(paths.begin(), paths.end());
+
+  vector<pair<string, Metrics>> results;
+  double glyphs = 0, decodeSeconds = 0, megabytes = 0, openSeconds = 0;
+  for (const string &path : paths) {
+    string name = filesystem::path(path).filename().string();
+    string error;
+    Metrics m = bench_font(path, error);
+    if (!error.empty()) {
+      printf("%-32s skipped: %s\n", name.c_str(), error.c_str());
+      continue;
+    }
+    printf("%-32s %6.0f glyphs  open %8.1f MB/s  decode %10.0f glyphs/s\n", name.c_str(),
+           m["glyphs"], m["open_mb_per_s"], m["decode_glyphs_per_s"]);
+    double mb = filesystem::file_size(path) / 1e6;
+    glyphs += m["glyphs"];
+    decodeSeconds += m["glyphs"] / m["decode_glyphs_per_s"];
+    megabytes += mb;
+    openSeconds += mb / m["open_mb_per_s"];
+    results.push_back({name, m});
+  }
+
+  Metrics aggregate;
+  if (!results.empty()) {
+    aggregate["decode_glyphs_per_s"] = glyphs / decodeSeconds;
+    aggregate["open_mb_per_s"] = megabytes / openSeconds;
+  }
+  peak_rss_kb();
+  aggregate["peak_rss_kb"] = run_peak_kb;
+  aggregate["fonts"] = results.size();
+
+  if (!compare) {
+    write_baseline(argv[2], results, aggregate);
+    return 0;
+  }
+
+  map<string, Metrics> baseline = read_baseline(argv[2]);
+  results.push_back({"*", aggregate});
+  int regressions = 0;
+  for (const auto &font : results) {
+    auto old = baseline.find(font.first);
+    if (old == baseline.end())
+      continue;
+    for (const auto &entry : font.second) {
+      auto before = old->second.find(entry.first);
+      if (before == old->second.end() || before->second <= 0 || entry.first == "glyphs" ||
+          entry.first == "fonts")
+        continue;
+      double change = entry.second / before->second - 1;
+      bool worse = higher_is_better(entry.first) ? change < -threshold : change > threshold;
+      if (worse) {
+        printf("REGRESSION %s %s: %g -> %g (%+.1f%%)\n", font.first.c_str(),
+               entry.first.c_str(), before->second, entry.second, change * 100);
+        regressions++;
+      }
+    }
+  }
+  printf("%d regression(s) past %.0f%%\n", regressions, threshold * 100);
+  return regressions ? 1 : 0;
+}
@@ -0,0 +1,200 @@
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+
+#include "bytes.h"
+
+#if defined(__AVX2__) || defined(__SSSE3__)
+#include <immintrin.h>
+#elif defined(__wasm_simd128__)
+#include <wasm_simd128.h>
+#endif
+
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+#define BYTES_BIG_ENDIAN_HOST 1
+#endif
+
+// Each kernel swaps full vectors and leaves the tail to the scalar loop.
+// Shuffle indices >= 0x80 (SSE) or >= 16 (wasm swizzle) produce zero bytes,
+// which is how the widening kernel fills the high half of each u32.
+
+void decode_be16(const uint8_t *src, size_t count, uint16_t *dst) {
+#ifdef BYTES_BIG_ENDIAN_HOST
+  memcpy(dst, src, count * 2);
+#else
+  size_t i = 0;
+#if defined(__AVX2__)
+  const __m256i swap = _mm256_setr_epi8(1, 0, 3, 2, 5, 4, 7, 6, 9, 8, 11, 10, 13, 12, 15, 14,
+                                        1, 0, 3, 2, 5, 4, 7, 6, 9, 8, 11, 10, 13, 12, 15, 14);
+  for (; i + 16 <= count; i += 16) {
+    __m256i v = _mm256_loadu_si256((const __m256i *)(src + 2 * i));
+    _mm256_storeu_si256((__m256i *)(dst + i), _mm256_shuffle_epi8(v, swap));
+  }
+#elif defined(__SSSE3__)
+  const __m128i swap = _mm_setr_epi8(1, 0, 3, 2, 5, 4, 7, 6, 9, 8, 11, 10, 13, 12, 15, 14);
+  for (; i + 8 <= count; i += 8) {
+    __m128i v = _mm_loadu_si128((const __m128i *)(src + 2 * i));
+    _mm_storeu_si128((__m128i *)(dst + i), _mm_shuffle_epi8(v, swap));
+  }
+#elif defined(__wasm_simd128__)
+  for (; i + 8 <= count; i += 8) {
+    v128_t v = wasm_v128_load(src + 2 * i);
+    wasm_v128_store(dst + i, wasm_i8x16_shuffle(v, v, 1, 0, 3, 2, 5, 4, 7, 6,
+                                                9, 8, 11, 10, 13, 12, 15, 14));
+  }
+#endif
+  for (; i < count; ++i)
+    dst[i] = be16(src + 2 * i);
+#endif
+}
+
+void decode_be32(const uint8_t *src, size_t count, uint32_t *dst) {
+#ifdef BYTES_BIG_ENDIAN_HOST
+  memcpy(dst, src, count * 4);
+#else
+  size_t i = 0;
+#if defined(__AVX2__)
+  const __m256i swap = _mm256_setr_epi8(3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12,
+                                        3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12);
+  for (; i + 8 <= count; i += 8) {
+    __m256i v = _mm256_loadu_si256((const __m256i *)(src + 4 * i));
+    _mm256_storeu_si256((__m256i *)(dst + i), _mm256_shuffle_epi8(v, swap));
+  }
+#elif defined(__SSSE3__)
+  const __m128i swap = _mm_setr_epi8(3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12);
+  for (; i + 4 <= count; i += 4) {
+    __m128i v = _mm_loadu_si128((const __m128i *)(src + 4 * i));
+    _mm_storeu_si128((__m128i *)(dst + i), _mm_shuffle_epi8(v, swap));
+  }
+#elif defined(__wasm_simd128__)
+  for (; i + 4 <= count; i += 4) {
+    v128_t v = wasm_v128_load(src + 4 * i);
+    wasm_v128_store(dst + i, wasm_i8x16_shuffle(v, v, 3, 2, 1, 0, 7, 6, 5, 4,
+                                                11, 10, 9, 8, 15, 14, 13, 12));
+  }
+#endif
+  for (; i < count; ++i)
+    dst[i] = be32(src + 4 * i);
+#endif
+}
+
+void decode_be16_wide(const uint8_t *src, size_t count, uint32_t *dst, int shift) {
+  size_t i = 0;
+#if defined(__AVX2__)
+  const __m128i swap = _mm_setr_epi8(1, 0, 3, 2, 5, 4, 7, 6, 9, 8, 11, 10, 13, 12, 15, 14);
+  const __m128i amount = _mm_cvtsi32_si128(shift);
+  for (; i + 8 <= count; i += 8) {
+    __m128i v = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)(src + 2 * i)), swap);
+    __m256i wide = _mm256_sll_epi32(_mm256_cvtepu16_epi32(v), amount);
+    _mm256_storeu_si256((__m256i *)(dst + i), wide);
+  }
+#elif defined(__SSSE3__)
+  // four u16 in the low 8 bytes become four zero-extended u32 lanes
+  const __m128i widen = _mm_setr_epi8(1, 0, -1, -1, 3, 2, -1, -1, 5, 4, -1, -1, 7, 6, -1, -1);
+  const __m128i amount = _mm_cvtsi32_si128(shift);
+  for (; i + 4 <= count; i += 4) {
+    __m128i v = _mm_loadl_epi64((const __m128i *)(src + 2 * i));
+    _mm_storeu_si128((__m128i *)(dst + i), _mm_sll_epi32(_mm_shuffle_epi8(v, widen), amount));
+  }
+#elif defined(__wasm_simd128__)
+  for (; i + 4 <= count; i += 4) {
+    v128_t v = wasm_v128_load64_zero(src + 2 * i);
+    v128_t wide = wasm_i8x16_shuffle(v, wasm_i64x2_const(0, 0), 1, 0, 16, 16, 3, 2, 16, 16,
+                                     5, 4, 16, 16, 7, 6, 16, 16);
+    wasm_v128_store(dst + i, wasm_i32x4_shl(wide, shift));
+  }
+#endif
+  for (; i < count; ++i)
+    dst[i] = (uint32_t)be16(src + 2 * i) << shift;
+}
+
+// Files
+
+bool read_file_bytes(const std::string &filename, std::vector<uint8_t> &data) {
+  std::ifstream in(filename, std::ios::binary | std::ios::ate);
+  if (!in)
+    return false;
+  data.resize((size_t)in.tellg());
+  in.seekg(0);
+  return (bool)in.read(reinterpret_cast<char *>(data.data()), data.size());
+}
+
+// Content Hash
+
+// XXH64 with seed 0. Reads little-endian words so the hash of a file is the
+// same on every host.
+
+static const uint64_t PRIME64_1 = 0x9E3779B185EBCA87ULL;
+static const uint64_t PRIME64_2 = 0xC2B2AE3D27D4EB4FULL;
+static const uint64_t PRIME64_3 = 0x165667B19E3779F9ULL;
+static const uint64_t PRIME64_4 = 0x85EBCA77C2B2AE63ULL;
+static const uint64_t PRIME64_5 = 0x27D4EB2F165667C5ULL;
+
+static inline uint64_t rotl64(uint64_t v, int r) { return (v << r) | (v >> (64 - r)); }
+
+static inline uint64_t le64(const uint8_t *p) {
+  uint64_t v;
+  memcpy(&v, p, 8);
+#ifdef BYTES_BIG_ENDIAN_HOST
+  v = __builtin_bswap64(v);
+#endif
+  return v;
+}
+
+static inline uint32_t le32(const uint8_t *p) {
+  uint32_t v;
+  memcpy(&v, p, 4);
+#ifdef BYTES_BIG_ENDIAN_HOST
+  v = __builtin_bswap32(v);
+#endif
+  return v;
+}
+
+static inline uint64_t xxh64_round(uint64_t acc, uint64_t input) {
+  acc += input * PRIME64_2;
+  return rotl64(acc, 31) * PRIME64_1;
+}
+
+static inline uint64_t xxh64_merge(uint64_t acc, uint64_t lane) {
+  acc ^= xxh64_round(0, lane);
+  return acc * PRIME64_1 + PRIME64_4;
+}
+
+uint64_t content_hash(const uint8_t *data, size_t size) {
+  const uint8_t *p = data, *end = data + size;
+  uint64_t h;
+  if (size >= 32) {
+    uint64_t v1 = PRIME64_1 + PRIME64_2, v2 = PRIME64_2, v3 = 0, v4 = 0 - PRIME64_1;
+    for (; p + 32 <= end; p += 32) {
+      v1 = xxh64_round(v1, le64(p));
+      v2 = xxh64_round(v2, le64(p + 8));
+      v3 = xxh64_round(v3, le64(p + 16));
+      v4 = xxh64_round(v4, le64(p + 24));
+    }
+    h = rotl64(v1, 1) + rotl64(v2, 7) + rotl64(v3, 12) + rotl64(v4, 18);
+    h = xxh64_merge(h, v1);
+    h = xxh64_merge(h, v2);
+    h = xxh64_merge(h, v3);
+    h = xxh64_merge(h, v4);
+  } else {
+    h = PRIME64_5;
+  }
+  h += size;
+
+  for (; p + 8 <= end; p += 8)
+    h = rotl64(h ^ xxh64_round(0, le64(p)), 27) * PRIME64_1 + PRIME64_4;
+  if (p + 4 <= end) {
+    h = rotl64(h ^ (le32(p) * PRIME64_1), 23) * PRIME64_2 + PRIME64_3;
+    p += 4;
+  }
+  for (; p < end; ++p)
+    h = rotl64(h ^ (*p * PRIME64_5), 11) * PRIME64_1;
+
+  h ^= h >> 33;
+  h *= PRIME64_2;
+  h ^= h >> 29;
+  h *= PRIME64_3;
+  h ^= h >> 32;
+  return h;
+}
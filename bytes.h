@@ -0,0 +1,67 @@
+#ifndef BYTES_H
+#define BYTES_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Big-endian reads from font bytes
+
+inline uint16_t be16(const uint8_t *p) { return (uint16_t)(p[0] << 8 | p[1]); }
+
+inline uint32_t be32(const uint8_t *p) {
+  return (uint32_t)p[0] << 24 | (uint32_t)p[1] << 16 | (uint32_t)p[2] << 8 | p[3];
+}
+
+// Bulk decoders for big-endian arrays (loca, cmap segments, hmtx, ...).
+// src needs no particular alignment and must not overlap dst. On a
+// big-endian host these are a plain memcpy.
+
+void decode_be16(const uint8_t *src, size_t count, uint16_t *dst);
+void decode_be32(const uint8_t *src, size_t count, uint32_t *dst);
+
+// Widens each u16 to u32 and shifts it left, for short loca (offset / 2)
+void decode_be16_wide(const uint8_t *src, size_t count, uint32_t *dst, int shift);
+
+inline void decode_be16(const uint8_t *src, size_t count, int16_t *dst) {
+  decode_be16(src, count, reinterpret_cast<uint16_t *>(dst));
+}
+
+// 64-bit hash of a whole file (XXH64), used to key caches by content
+uint64_t content_hash(const uint8_t *data, size_t size);
+
+// Reads a whole file with one sized read; false if it cannot be opened
+bool read_file_bytes(const std::string &filename, std::vector<uint8_t> &data);
+
+// A table viewed in place inside the font buffer. Tables that validate_font
+// does not walk (GPOS, kern, gvar, ...) are read through these, so offsets
+// taken from the file that point past the end yield 0 instead of faulting.
+struct TableBytes {
+  const uint8_t *data;
+  size_t size;
+};
+
+inline uint8_t get_u8(const TableBytes &d, size_t o) {
+  return o < d.size ? d.data[o] : 0;
+}
+
+inline uint16_t get_u16(const TableBytes &d, size_t o) {
+  if (o + 2 > d.size)
+    return 0;
+  return be16(d.data + o);
+}
+
+inline uint32_t get_u32(const TableBytes &d, size_t o) {
+  return ((uint32_t)get_u16(d, o) << 16) | get_u16(d, o + 2);
+}
+
+// Bulk form of get_u16: the whole array must fit or nothing is read
+inline bool get_u16_array(const TableBytes &d, size_t o, size_t count, uint16_t *dst) {
+  if (o > d.size || count * 2 > d.size - o)
+    return false;
+  decode_be16(d.data + o, count, dst);
+  return true;
+}
+
+#endif
@@ -0,0 +1,721 @@
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "bytes.h"
+#include "cff.h"
+
+using namespace std;
+
+typedef map<int, vector<double>> CffDict;
+
+static uint32_t index_count(const CffIndex &index) {
+  return index.offsets.empty() ? 0 : index.offsets.size() - 1;
+}
+
+static double dict_value(const CffDict &dict, int op, size_t i, double fallback) {
+  auto it = dict.find(op);
+  if (it == dict.end() || it->second.size() <= i)
+    return fallback;
+  return it->second[i];
+}
+
+// INDEX
+
+// Reads the INDEX at p and moves p past it. Offsets are stored relative to
+// base, which is the table's position in the font (0 for table-relative).
+static bool read_index(const TableBytes &t, size_t &p, bool cff2, uint32_t base,
+                       CffIndex &index) {
+  index.offsets.clear();
+  uint32_t count;
+  if (cff2) {
+    count = get_u32(t, p);
+    p += 4;
+  } else {
+    count = get_u16(t, p);
+    p += 2;
+  }
+  if (p > t.size)
+    return false;
+  if (count == 0)
+    return true;
+
+  int offSize = get_u8(t, p++);
+  if (offSize < 1 || offSize > 4)
+    return false;
+  uint64_t offsetsEnd = p + ((uint64_t)count + 1) * offSize;
+  if (offsetsEnd > t.size)
+    return false;
+
+  size_t dataStart = offsetsEnd - 1; // offsets count from 1
+  index.offsets.resize(count + 1);
+  uint32_t prev = 1;
+  for (uint32_t i = 0; i <= count; ++i) {
+    uint32_t off = 0;
+    for (int b = 0; b < offSize; ++b)
+      off = off << 8 | get_u8(t, p + (size_t)i * offSize + b);
+    if (off < prev || dataStart + off > t.size)
+      return false;
+    index.offsets[i] = base + dataStart + off;
+    prev = off;
+  }
+  p = dataStart + prev;
+  return true;
+}
+
+// DICT
+
+static double read_real(const TableBytes &t, size_t &p) {
+  string s;
+  while (p < t.size) {
+    uint8_t b = get_u8(t, p++);
+    for (int nibble : {b >> 4, b & 0x0F}) {
+      if (nibble <= 9)
+        s += char('0' + nibble);
+      else if (nibble == 0xA)
+        s += '.';
+      else if (nibble == 0xB)
+        s += 'E';
+      else if (nibble == 0xC)
+        s += "E-";
+      else if (nibble == 0xE)
+        s += '-';
+      else if (nibble == 0xF)
+        return strtod(s.c_str(), nullptr);
+    }
+  }
+  return 0;
+}
+
+// CFF2 DICTs may blend values; only the default-instance values are kept
+static bool read_dict(const TableBytes &t, size_t start, size_t end,
+                      const vector<uint16_t> &regionCounts, CffDict &dict) {
+  if (start > end || end > t.size)
+    return false;
+
+  vector<double> operands;
+  size_t vsindex = 0;
+  size_t p = start;
+  while (p < end) {
+    uint8_t b0 = get_u8(t, p++);
+    if (b0 <= 24) {
+      int op = b0 == 12 ? 1200 + get_u8(t, p++) : b0;
+      if (op == 23) {
+        if (operands.empty())
+          return false;
+        size_t n = operands.back();
+        size_t k = vsindex < regionCounts.size() ? regionCounts[vsindex] : 0;
+        if (n * (k + 1) + 1 > operands.size())
+          return false;
+        operands.pop_back();
+        operands.resize(operands.size() - n * k);
+        continue;
+      }
+      if (op == 22)
+        vsindex = operands.empty() ? 0 : operands.back();
+      dict[op] = operands;
+      operands.clear();
+    } else if (b0 == 28) {
+      operands.push_back((int16_t)get_u16(t, p));
+      p += 2;
+    } else if (b0 == 29) {
+      operands.push_back((int32_t)get_u32(t, p));
+      p += 4;
+    } else if (b0 == 30) {
+      operands.push_back(read_real(t, p));
+    } else if (b0 >= 32 && b0 <= 246) {
+      operands.push_back(b0 - 139);
+    } else if (b0 >= 247 && b0 <= 250) {
+      operands.push_back((b0 - 247) * 256 + get_u8(t, p++) + 108);
+    } else if (b0 >= 251 && b0 <= 254) {
+      operands.push_back(-(b0 - 251) * 256 - get_u8(t, p++) - 108);
+    } else {
+      return false;
+    }
+    if (operands.size() > 513)
+      return false;
+  }
+  return true;
+}
+
+static string read_private(const TableBytes &t, uint32_t base, bool cff2,
+                           const CffDict &fontDict, const vector<uint16_t> &regionCounts,
+                           CffPrivateDict &priv) {
+  double size = dict_value(fontDict, 18, 0, 0);
+  double offset = dict_value(fontDict, 18, 1, 0);
+  if (size <= 0)
+    return ""; // no Private DICT, so no local subroutines
+  if (offset < 0 || offset + size > t.size)
+    return "Private DICT out of bounds";
+
+  CffDict dict;
+  if (!read_dict(t, offset, offset + size, regionCounts, dict))
+    return "bad Private DICT";
+  priv.vsindex = dict_value(dict, 22, 0, 0);
+
+  double subrs = dict_value(dict, 19, 0, 0);
+  if (subrs > 0) {
+    size_t p = offset + subrs;
+    if (!read_index(t, p, cff2, base, priv.subrs))
+      return "bad local Subrs INDEX";
+  }
+  priv.cache.tokens.resize(index_count(priv.subrs));
+  return "";
+}
+
+static string read_fd_select(const TableBytes &t, size_t s, uint16_t numGlyphs,
+                             vector<uint16_t> &fdSelect) {
+  fdSelect.assign(numGlyphs, 0);
+  uint8_t format = get_u8(t, s);
+  if (format == 0) {
+    if (s + 1 + numGlyphs > t.size)
+      return "FDSelect out of bounds";
+    for (int g = 0; g < numGlyphs; ++g)
+      fdSelect[g] = get_u8(t, s + 1 + g);
+  } else if (format == 3 || format == 4) {
+    // ranges of (first glyph, fd) closed by a sentinel glyph id
+    bool wide = format == 4;
+    uint32_t nRanges = wide ? get_u32(t, s + 1) : get_u16(t, s + 1);
+    size_t record = wide ? 6 : 3;
+    size_t r0 = s + (wide ? 5 : 3);
+    if (r0 + (uint64_t)nRanges * record + (wide ? 4 : 2) > t.size)
+      return "FDSelect out of bounds";
+    for (uint32_t r = 0; r < nRanges; ++r) {
+      size_t at = r0 + r * record;
+      uint32_t first = wide ? get_u32(t, at) : get_u16(t, at);
+      uint16_t fd = wide ? get_u16(t, at + 4) : get_u8(t, at + 2);
+      uint32_t next = wide ? get_u32(t, at + record) : get_u16(t, at + record);
+      for (uint32_t g = first; g < next && g < numGlyphs; ++g)
+        fdSelect[g] = fd;
+    }
+  } else {
+    return "unknown FDSelect format";
+  }
+  return "";
+}
+
+// Table
+
+string parse_cff(const VerifiedFont &font, CffFont &cff) {
+  cff = CffFont();
+  TableId id = has_table(font.tables, TABLE_CFF) ? TABLE_CFF : TABLE_CFF2;
+  const TableRecord *record = find_table(font.tables, id);
+  if (!record)
+    return "no CFF or CFF2 table";
+  TableBytes t = table_bytes(font, id);
+  uint32_t base = record->offset;
+  cff.cff2 = id == TABLE_CFF2;
+
+  if (get_u8(t, 0) != (cff.cff2 ? 2 : 1))
+    return "unsupported CFF major version";
+  size_t p = get_u8(t, 2);
+
+  CffDict top;
+  if (cff.cff2) {
+    size_t topSize = get_u16(t, 3);
+    if (!read_dict(t, p, p + topSize, {}, top))
+      return "bad Top DICT";
+    p += topSize;
+  } else {
+    CffIndex names, tops, strings;
+    if (!read_index(t, p, false, 0, names) || !read_index(t, p, false, 0, tops) ||
+        index_count(tops) < 1)
+      return "bad Name or Top DICT INDEX";
+    if (!read_dict(t, tops.offsets[0], tops.offsets[1], {}, top))
+      return "bad Top DICT";
+    if (!read_index(t, p, false, 0, strings))
+      return "bad String INDEX";
+  }
+  if (!read_index(t, p, cff.cff2, base, cff.globalSubrs))
+    return "bad Global Subr INDEX";
+  cff.globalCache.tokens.resize(index_count(cff.globalSubrs));
+
+  if (dict_value(top, 1206, 0, 2) != 2)
+    return "unsupported CharstringType";
+
+  // CFF2 blends need the region count of each ItemVariationData
+  if (cff.cff2 && top.count(24)) {
+    size_t store = (size_t)dict_value(top, 24, 0, 0) + 2; // skip the length field
+    uint16_t dataCount = get_u16(t, store + 6);
+    for (int i = 0; i < dataCount; ++i) {
+      size_t data = store + get_u32(t, store + 8 + 4 * i);
+      cff.regionCounts.push_back(get_u16(t, data + 4));
+    }
+  }
+
+  double charStrings = dict_value(top, 17, 0, -1);
+  if (charStrings < 0)
+    return "missing CharStrings";
+  size_t cs = charStrings;
+  if (!read_index(t, cs, cff.cff2, base, cff.charStrings))
+    return "bad CharStrings INDEX";
+  if (index_count(cff.charStrings) < font.numGlyphs)
+    return "fewer CharStrings than glyphs";
+
+  if (top.count(1236)) {
+    // CID-keyed (or any CFF2) font: one Private DICT per Font DICT
+    size_t fa = dict_value(top, 1236, 0, 0);
+    CffIndex fdArray;
+    if (!read_index(t, fa, cff.cff2, 0, fdArray))
+      return "bad FDArray INDEX";
+    cff.privates.resize(index_count(fdArray));
+    for (uint32_t i = 0; i < index_count(fdArray); ++i) {
+      CffDict fontDict;
+      if (!read_dict(t, fdArray.offsets[i], fdArray.offsets[i + 1], {}, fontDict))
+        return "bad Font DICT";
+      string error = read_private(t, base, cff.cff2, fontDict, cff.regionCounts, cff.privates[i]);
+      if (!error.empty())
+        return error;
+    }
+    if (top.count(1237)) {
+      string error = read_fd_select(t, dict_value(top, 1237, 0, 0), font.numGlyphs, cff.fdSelect);
+      if (!error.empty())
+        return error;
+    }
+  } else {
+    cff.privates.resize(1);
+    string error = read_private(t, base, cff.cff2, top, cff.regionCounts, cff.privates[0]);
+    if (!error.empty())
+      return error;
+  }
+  if (cff.privates.empty())
+    return "no Font DICT";
+  for (uint16_t fd : cff.fdSelect) {
+    if (fd >= cff.privates.size())
+      return "FDSelect names a missing Font DICT";
+  }
+  return "";
+}
+
+// Charstring Interpreter
+
+static const int CFF_MAX_STACK = 513;
+static const int CFF_MAX_DEPTH = 10;
+
+enum RunStatus { RUN_CONTINUE, RUN_RETURN, RUN_END, RUN_ERROR };
+
+struct CharstringRun {
+  const VerifiedFont *font; // its cacheBytes counts recorded subroutines
+  const uint8_t *data;
+  const CffFont *cff;
+  const CffPrivateDict *priv;
+  float stack[CFF_MAX_STACK];
+  int sp;
+  int numStems;
+  bool widthSeen;
+  float x, y;
+  int depth;
+  uint16_t vsindex;
+  vector<Point> *points;
+  vector<uint16_t> *contourEnds;
+  size_t contourStart;
+};
+
+static uint32_t subr_bias(uint32_t count) {
+  return count < 1240 ? 107 : count < 33900 ? 1131 : 32768;
+}
+
+static void push_point(CharstringRun &run, bool onCurve) {
+  run.points->push_back({(int)floorf(run.x + 0.5f), (int)floorf(run.y + 0.5f), onCurve, !onCurve});
+}
+
+// An outline's closing segment is implied, so a final point that lands
+// back on the start is dropped, and a contour that never drew is removed.
+static void close_contour(CharstringRun &run) {
+  vector<Point> &points = *run.points;
+  if (points.size() - run.contourStart > 1) {
+    const Point &first = points[run.contourStart], &last = points.back();
+    if (last.onCurve && last.x == first.x && last.y == first.y)
+      points.pop_back();
+  }
+  if (points.size() - run.contourStart <= 1)
+    points.resize(run.contourStart);
+  else
+    run.contourEnds->push_back(points.size() - 1);
+  run.contourStart = points.size();
+}
+
+static void move_to(CharstringRun &run, float dx, float dy) {
+  close_contour(run);
+  run.x += dx;
+  run.y += dy;
+  push_point(run, true);
+}
+
+static void line_to(CharstringRun &run, float dx, float dy) {
+  if (run.points->size() == run.contourStart)
+    push_point(run, true); // drawing without a moveto starts at the current point
+  run.x += dx;
+  run.y += dy;
+  push_point(run, true);
+}
+
+static void curve_to(CharstringRun &run, float dx1, float dy1, float dx2, float dy2,
+                     float dx3, float dy3) {
+  if (run.points->size() == run.contourStart)
+    push_point(run, true);
+  run.x += dx1;
+  run.y += dy1;
+  push_point(run, false);
+  run.x += dx2;
+  run.y += dy2;
+  push_point(run, false);
+  run.x += dx3;
+  run.y += dy3;
+  push_point(run, true);
+}
+
+// CFF1 charstrings may lead with the advance width on the first
+// stack-clearing operator; it is skipped since hmtx has the same value.
+static int arg_base(CharstringRun &run, bool hasExtra) {
+  if (run.cff->cff2 || run.widthSeen)
+    return 0;
+  run.widthSeen = true;
+  return hasExtra ? 1 : 0;
+}
+
+// Declares the implicit vstems before a hintmask/cntrmask; returns the mask length
+static int begin_mask(CharstringRun &run) {
+  int base = arg_base(run, run.sp % 2 == 1);
+  run.numStems += (run.sp - base) / 2;
+  run.sp = 0;
+  return (run.numStems + 7) / 8;
+}
+
+static int run_charstring(CharstringRun &run, uint32_t begin, uint32_t end,
+                          CffSubrCache *cache, uint32_t index);
+
+static int call_subr(CharstringRun &run, bool global) {
+  const CffIndex &subrs = global ? run.cff->globalSubrs : run.priv->subrs;
+  CffSubrCache &cache = global ? run.cff->globalCache : run.priv->cache;
+  if (run.sp < 1 || run.depth >= CFF_MAX_DEPTH)
+    return RUN_ERROR;
+  uint32_t count = index_count(subrs);
+  int64_t i = (int64_t)run.stack[--run.sp] + subr_bias(count);
+  if (i < 0 || i >= count)
+    return RUN_ERROR;
+
+  ++run.depth;
+  int status = run_charstring(run, subrs.offsets[i], subrs.offsets[i + 1], &cache, i);
+  --run.depth;
+  return status == RUN_RETURN ? RUN_CONTINUE : status;
+}
+
+static int execute_op(CharstringRun &run, int op) {
+  float *a = run.stack;
+  int n = run.sp;
+  int i = 0;
+  switch (op) {
+  case 1:  // hstem
+  case 3:  // vstem
+  case 18: // hstemhm
+  case 23: // vstemhm
+    i = arg_base(run, n % 2 == 1);
+    run.numStems += (n - i) / 2;
+    break;
+  case 21: // rmoveto
+    i = arg_base(run, n > 2);
+    if (n - i < 2)
+      return RUN_ERROR;
+    move_to(run, a[i], a[i + 1]);
+    break;
+  case 22: // hmoveto
+  case 4:  // vmoveto
+    i = arg_base(run, n > 1);
+    if (n - i < 1)
+      return RUN_ERROR;
+    move_to(run, op == 22 ? a[i] : 0, op == 4 ? a[i] : 0);
+    break;
+  case 5: // rlineto
+    for (; i + 2 <= n; i += 2)
+      line_to(run, a[i], a[i + 1]);
+    break;
+  case 6: // hlineto
+  case 7: // vlineto
+    for (bool horizontal = op == 6; i < n; ++i, horizontal = !horizontal)
+      line_to(run, horizontal ? a[i] : 0, horizontal ? 0 : a[i]);
+    break;
+  case 8: // rrcurveto
+    for (; i + 6 <= n; i += 6)
+      curve_to(run, a[i], a[i + 1], a[i + 2], a[i + 3], a[i + 4], a[i + 5]);
+    break;
+  case 24: // rcurveline
+    for (; i + 6 <= n - 2; i += 6)
+      curve_to(run, a[i], a[i + 1], a[i + 2], a[i + 3], a[i + 4], a[i + 5]);
+    if (i + 2 <= n)
+      line_to(run, a[i], a[i + 1]);
+    break;
+  case 25: // rlinecurve
+    for (; i + 2 <= n - 6; i += 2)
+      line_to(run, a[i], a[i + 1]);
+    if (i + 6 <= n)
+      curve_to(run, a[i], a[i + 1], a[i + 2], a[i + 3], a[i + 4], a[i + 5]);
+    break;
+  case 26: { // vvcurveto
+    float dx1 = 0;
+    if (n % 2 == 1)
+      dx1 = a[i++];
+    for (; i + 4 <= n; i += 4, dx1 = 0)
+      curve_to(run, dx1, a[i], a[i + 1], a[i + 2], 0, a[i + 3]);
+    break;
+  }
+  case 27: { // hhcurveto
+    float dy1 = 0;
+    if (n % 2 == 1)
+      dy1 = a[i++];
+    for (; i + 4 <= n; i += 4, dy1 = 0)
+      curve_to(run, a[i], dy1, a[i + 1], a[i + 2], a[i + 3], 0);
+    break;
+  }
+  case 30: // vhcurveto
+  case 31: // hvcurveto
+    for (bool horizontal = op == 31; i + 4 <= n; horizontal = !horizontal) {
+      bool last = n - i == 5;
+      float extra = last ? a[i + 4] : 0;
+      if (horizontal)
+        curve_to(run, a[i], 0, a[i + 1], a[i + 2], extra, a[i + 3]);
+      else
+        curve_to(run, 0, a[i], a[i + 1], a[i + 2], a[i + 3], extra);
+      i += last ? 5 : 4;
+    }
+    break;
+  case 10: // callsubr
+  case 29: // callgsubr
+    return call_subr(run, op == 29);
+  case 11: // return
+    return RUN_RETURN;
+  case 14: // endchar (the deprecated seac accent form is not composed)
+    arg_base(run, n == 1 || n == 5);
+    close_contour(run);
+    run.sp = 0;
+    return RUN_END;
+  case 15: // vsindex
+    if (n < 1)
+      return RUN_ERROR;
+    run.vsindex = a[--run.sp];
+    return RUN_CONTINUE;
+  case 16: { // blend: keep the default values, drop the region deltas
+    if (n < 1)
+      return RUN_ERROR;
+    int count = a[n - 1];
+    int k = run.vsindex < run.cff->regionCounts.size() ? run.cff->regionCounts[run.vsindex] : 0;
+    if (count < 0 || count * (k + 1) + 1 > n)
+      return RUN_ERROR;
+    run.sp = n - 1 - count * k;
+    return RUN_CONTINUE;
+  }
+  case 1235: // flex
+    if (n < 12)
+      return RUN_ERROR;
+    curve_to(run, a[0], a[1], a[2], a[3], a[4], a[5]);
+    curve_to(run, a[6], a[7], a[8], a[9], a[10], a[11]);
+    break;
+  case 1234: // hflex
+    if (n < 7)
+      return RUN_ERROR;
+    curve_to(run, a[0], 0, a[1], a[2], a[3], 0);
+    curve_to(run, a[4], 0, a[5], -a[2], a[6], 0);
+    break;
+  case 1236: // hflex1
+    if (n < 9)
+      return RUN_ERROR;
+    curve_to(run, a[0], a[1], a[2], a[3], a[4], 0);
+    curve_to(run, a[5], 0, a[6], a[7], a[8], -(a[1] + a[3] + a[7]));
+    break;
+  case 1237: { // flex1
+    if (n < 11)
+      return RUN_ERROR;
+    float dx = a[0] + a[2] + a[4] + a[6] + a[8];
+    float dy = a[1] + a[3] + a[5] + a[7] + a[9];
+    bool horizontal = fabsf(dx) > fabsf(dy);
+    curve_to(run, a[0], a[1], a[2], a[3], a[4], a[5]);
+    curve_to(run, a[6], a[7], a[8], a[9], horizontal ? a[10] : -dx, horizontal ? -dy : a[10]);
+    break;
+  }
+  // arithmetic operators leave their result on the stack
+  case 1209: // abs
+  case 1214: // neg
+  case 1226: // sqrt
+    if (n < 1)
+      return RUN_ERROR;
+    a[n - 1] = op == 1209 ? fabsf(a[n - 1]) : op == 1214 ? -a[n - 1] : sqrtf(fabsf(a[n - 1]));
+    return RUN_CONTINUE;
+  case 1210: // add
+  case 1211: // sub
+  case 1212: // div
+  case 1224: // mul
+    if (n < 2)
+      return RUN_ERROR;
+    a[n - 2] = op == 1210 ? a[n - 2] + a[n - 1]
+             : op == 1211 ? a[n - 2] - a[n - 1]
+             : op == 1224 ? a[n - 2] * a[n - 1]
+             : a[n - 1] != 0 ? a[n - 2] / a[n - 1] : 0;
+    run.sp = n - 1;
+    return RUN_CONTINUE;
+  case 1218: // drop
+    run.sp = n > 0 ? n - 1 : 0;
+    return RUN_CONTINUE;
+  case 1227: // dup
+    if (n < 1 || n >= CFF_MAX_STACK)
+      return RUN_ERROR;
+    a[n] = a[n - 1];
+    run.sp = n + 1;
+    return RUN_CONTINUE;
+  case 1228: // exch
+    if (n < 2)
+      return RUN_ERROR;
+    swap(a[n - 2], a[n - 1]);
+    return RUN_CONTINUE;
+  default:
+    break; // unsupported operators just clear their operands
+  }
+  run.sp = 0;
+  return RUN_CONTINUE;
+}
+
+// Executes begin..end from the raw bytes, recording the tokens into cache
+// slot index when a cache is given.
+static int run_bytes(CharstringRun &run, uint32_t pos, uint32_t end, CffSubrCache *cache,
+                     uint32_t index) {
+  const uint8_t *d = run.data;
+  vector<CffToken> recorded;
+  int status = RUN_RETURN;
+  while (pos < end) {
+    uint8_t b0 = d[pos++];
+    float value = 0;
+    int op = CFF_OPERAND;
+    if (b0 >= 32 && b0 <= 246) {
+      value = b0 - 139;
+    } else if (b0 >= 247 && b0 <= 254) {
+      if (pos >= end)
+        return RUN_ERROR;
+      int b1 = d[pos++];
+      value = b0 <= 250 ? (b0 - 247) * 256 + b1 + 108 : -(b0 - 251) * 256 - b1 - 108;
+    } else if (b0 == 255) {
+      if (pos + 4 > end)
+        return RUN_ERROR;
+      value = (int32_t)be32(d + pos) / 65536.0f;
+      pos += 4;
+    } else if (b0 == 28) {
+      if (pos + 2 > end)
+        return RUN_ERROR;
+      value = (int16_t)be16(d + pos);
+      pos += 2;
+    } else if (b0 == 12) {
+      if (pos >= end)
+        return RUN_ERROR;
+      op = 1200 + d[pos++];
+    } else {
+      op = b0;
+    }
+
+    if (op == CFF_OPERAND) {
+      if (run.sp >= CFF_MAX_STACK)
+        return RUN_ERROR;
+      run.stack[run.sp++] = value;
+      if (cache)
+        recorded.push_back({value, CFF_OPERAND, pos});
+      continue;
+    }
+    if (op == 19 || op == 20) { // hintmask, cntrmask
+      int maskBytes = begin_mask(run);
+      if (cache)
+        recorded.push_back({(float)maskBytes, (int16_t)op, pos});
+      pos += maskBytes;
+      continue;
+    }
+    if (cache)
+      recorded.push_back({0, (int16_t)op, pos});
+    status = execute_op(run, op);
+    if (status != RUN_CONTINUE)
+      break;
+    status = RUN_RETURN;
+  }
+  if (status == RUN_ERROR)
+    return status;
+  if (cache) {
+    // another thread may have recorded the same subroutine meanwhile
+    shared_ptr<const vector<CffToken>> expected;
+    auto tokens = make_shared<const vector<CffToken>>(move(recorded));
+    if (atomic_compare_exchange_strong(&cache->tokens[index], &expected, tokens))
+      run.font->cacheBytes.bytes += sizeof(*tokens) + vector_bytes(*tokens);
+  }
+  return status;
+}
+
+static int run_charstring(CharstringRun &run, uint32_t begin, uint32_t end,
+                          CffSubrCache *cache, uint32_t index) {
+  shared_ptr<const vector<CffToken>> tokens;
+  if (cache)
+    tokens = atomic_load(&cache->tokens[index]);
+  if (!tokens)
+    return run_bytes(run, begin, end, cache, index);
+
+  for (const CffToken &token : *tokens) {
+    if (token.op == CFF_OPERAND) {
+      if (run.sp >= CFF_MAX_STACK)
+        return RUN_ERROR;
+      run.stack[run.sp++] = token.value;
+      continue;
+    }
+    if (token.op == 19 || token.op == 20) {
+      int maskBytes = begin_mask(run);
+      if (maskBytes != (int)token.value) // stems differ from the recorded call
+        return run_bytes(run, token.offset + maskBytes, end, nullptr, 0);
+      continue;
+    }
+    int status = execute_op(run, token.op);
+    if (status != RUN_CONTINUE)
+      return status;
+  }
+  return RUN_RETURN;
+}
+
+struct CffScratch {
+  vector<Point> points;
+  vector<uint16_t> contourEnds;
+};
+
+static thread_local CffScratch cff_scratch;
+
+GlyphOutline decode_cff_outline(const VerifiedFont &font, uint16_t glyph, Arena &arena) {
+  GlyphOutline outline = {nullptr, nullptr, 0, 0};
+  if (!font.cff || glyph >= font.numGlyphs)
+    return outline;
+  const CffFont &cff = *font.cff;
+
+  CharstringRun run;
+  run.font = &font;
+  run.data = font.data.data();
+  run.cff = &cff;
+  run.priv = &cff.privates[cff.fdSelect.empty() ? 0 : cff.fdSelect[glyph]];
+  run.sp = 0;
+  run.numStems = 0;
+  run.widthSeen = false;
+  run.x = run.y = 0;
+  run.depth = 0;
+  run.vsindex = run.priv->vsindex;
+  run.points = &cff_scratch.points;
+  run.contourEnds = &cff_scratch.contourEnds;
+  run.contourStart = 0;
+  cff_scratch.points.clear();
+  cff_scratch.contourEnds.clear();
+
+  if (run_charstring(run, cff.charStrings.offsets[glyph], cff.charStrings.offsets[glyph + 1],
+                     nullptr, 0) == RUN_ERROR)
+    return outline;
+  close_contour(run); // CFF2 charstrings have no endchar
+  if (cff_scratch.points.size() > 0xFFFF)
+    return outline;
+
+  outline.numPoints = cff_scratch.points.size();
+  outline.numContours = cff_scratch.contourEnds.size();
+  outline.points = arena_array<Point>(arena, outline.numPoints);
+  outline.contourEnds = arena_array<uint16_t>(arena, outline.numContours);
+  copy(cff_scratch.points.begin(), cff_scratch.points.end(), outline.points);
+  copy(cff_scratch.contourEnds.begin(), cff_scratch.contourEnds.end(), outline.contourEnds);
+  return outline;
+}
@@ -0,0 +1,66 @@
+#ifndef CFF_H
+#define CFF_H
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "arena.h"
+#include "decode.h"
+#include "font.h"
+
+// Object offsets of a CFF INDEX, made absolute into the font buffer.
+// Object i spans offsets[i] .. offsets[i + 1].
+struct CffIndex {
+  std::vector<uint32_t> offsets;
+};
+
+// One decoded charstring token. Operators with the 12 escape are stored as
+// 1200 + the second byte. offset is where the token's bytes end (for
+// hintmask/cntrmask: where the mask bytes start), so execution can drop
+// back to the raw bytes at any token.
+struct CffToken {
+  float value;
+  int16_t op; // CFF_OPERAND for numbers
+  uint32_t offset;
+};
+
+static const int16_t CFF_OPERAND = -1;
+
+// Subroutines tokenized on first call, one slot per subroutine. Slots are
+// stored and loaded atomically like lazy_cache(), so threads decoding at
+// once may each record a subroutine and the first stored is kept. A
+// subroutine that contains a hintmask is only replayed while the mask
+// length matches the one it was recorded with; otherwise it runs from its
+// bytes.
+struct CffSubrCache {
+  std::vector<std::shared_ptr<const std::vector<CffToken>>> tokens;
+};
+
+struct CffPrivateDict {
+  CffIndex subrs;
+  uint16_t vsindex = 0;
+  mutable CffSubrCache cache;
+};
+
+// Parsed once by validate_font for fonts with CFF or CFF2 outlines. The
+// subroutine caches fill in as glyphs are decoded.
+struct CffFont {
+  bool cff2 = false;
+  CffIndex charStrings;
+  CffIndex globalSubrs;
+  mutable CffSubrCache globalCache;
+  std::vector<CffPrivateDict> privates;  // one per Font DICT
+  std::vector<uint16_t> fdSelect;        // per glyph; empty with one Private DICT
+  std::vector<uint16_t> regionCounts;    // CFF2: regions per ItemVariationData
+};
+
+// Empty string on success, otherwise what was wrong with the table
+std::string parse_cff(const VerifiedFont &font, CffFont &cff);
+
+// Runs the glyph's Type 2 charstring. Curves come out as two off-curve
+// points flagged cubic followed by the on-curve end point.
+GlyphOutline decode_cff_outline(const VerifiedFont &font, uint16_t glyph, Arena &arena);
+
+#endif
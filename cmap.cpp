@@ -0,0 +1,181 @@
+#include <algorithm>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <vector>
+
+#include "bytes.h"
+#include "cmap.h"
+
+using namespace std;
+
+// Load Subtable
+
+// cmap has been through validate_font, so subtable arrays are in bounds
+CharMap parse_char_map(const uint8_t *cmap, uint32_t length) {
+  CharMap map;
+  if (length < 4)
+    return map;
+
+  uint16_t numSubtables = be16(cmap + 2);
+
+  // a full-repertoire format 12 table wins over a BMP-only format 4 one
+  const uint8_t *bmp = nullptr, *full = nullptr;
+  for (int i = 0; i < numSubtables; ++i) {
+    const uint8_t *rec = cmap + 4 + 8 * i;
+    uint16_t platformID = be16(rec);
+    uint16_t encodingID = be16(rec + 2);
+    const uint8_t *sub = cmap + be32(rec + 4);
+    uint16_t format = be16(sub);
+    bool unicode = platformID == 0 ||
+                   (platformID == 3 && (encodingID == 1 || encodingID == 10));
+    if (unicode && format == 4 && !bmp)
+      bmp = sub;
+    if (unicode && format == 12 && !full)
+      full = sub;
+  }
+
+  if (full) {
+    uint32_t numGroups = be32(full + 12);
+    map.format = 12;
+    map.groups.resize(numGroups);
+    static_assert(sizeof(CmapGroup) == 12, "CmapGroup mirrors the file record");
+    decode_be32(full + 16, 3 * numGroups, reinterpret_cast<uint32_t *>(map.groups.data()));
+    return map;
+  }
+
+  if (!bmp)
+    return map;
+
+  uint32_t available = length - (bmp - cmap);
+  uint16_t segCount = be16(bmp + 6) / 2;
+  const uint8_t *p = bmp + 14;
+
+  map.format = 4;
+  map.endCode.resize(segCount);
+  decode_be16(p, segCount, map.endCode.data());
+  p += 2 * segCount + 2; // reservedPad
+  map.startCode.resize(segCount);
+  decode_be16(p, segCount, map.startCode.data());
+  p += 2 * segCount;
+  map.idDelta.resize(segCount);
+  decode_be16(p, segCount, map.idDelta.data());
+  p += 2 * segCount;
+  map.idRangeOffset.resize(segCount);
+  decode_be16(p, segCount, map.idRangeOffset.data());
+  p += 2 * segCount;
+
+  // whatever remains of the subtable is the glyphIdArray
+  uint32_t subtableLength = min<uint32_t>(be16(bmp + 2), available);
+  uint32_t headerSize = 16 + 8 * segCount;
+  uint32_t glyphIds = subtableLength > headerSize ? (subtableLength - headerSize) / 2 : 0;
+  map.glyphIdArray.resize(glyphIds);
+  decode_be16(p, glyphIds, map.glyphIdArray.data());
+
+  return map;
+}
+
+shared_ptr<const CharMap> font_char_map(const VerifiedFont &font) {
+  return lazy_cache(font, font.charMap, [&] {
+    TableBytes cmap = table_bytes(font, TABLE_CMAP);
+    return parse_char_map(cmap.data, cmap.size);
+  }, char_map_bytes);
+}
+
+size_t char_map_bytes(const CharMap &map) {
+  return vector_bytes(map.endCode) + vector_bytes(map.startCode) + vector_bytes(map.idDelta) +
+         vector_bytes(map.idRangeOffset) + vector_bytes(map.glyphIdArray) +
+         vector_bytes(map.groups);
+}
+
+// Lookup
+
+uint16_t char_map_lookup(const CharMap &map, uint32_t codepoint) {
+  if (map.format == 12) {
+    auto it = upper_bound(map.groups.begin(), map.groups.end(), codepoint,
+                          [](uint32_t c, const CmapGroup &g) { return c < g.start; });
+    if (it == map.groups.begin())
+      return 0;
+    --it;
+    if (codepoint > it->end)
+      return 0;
+    uint32_t glyph = it->glyph + (codepoint - it->start);
+    return glyph <= 0xFFFF ? glyph : 0;
+  }
+
+  if (map.format != 4 || codepoint > 0xFFFF)
+    return 0;
+
+  // segments are sorted by endCode, so the first end >= c is the candidate
+  uint16_t charCode = codepoint;
+  size_t i = lower_bound(map.endCode.begin(), map.endCode.end(), charCode) -
+             map.endCode.begin();
+  if (i == map.endCode.size() || map.startCode[i] > charCode)
+    return 0;
+
+  if (map.idRangeOffset[i] == 0)
+    return (charCode + map.idDelta[i]) % 65536;
+
+  // idRangeOffset is relative to its own slot in the idRangeOffset array
+  size_t segCount = map.endCode.size();
+  size_t index = map.idRangeOffset[i] / 2 + (charCode - map.startCode[i]) -
+                 (segCount - i);
+  if (index >= map.glyphIdArray.size())
+    return 0;
+  uint16_t glyphId = map.glyphIdArray[index];
+  if (glyphId == 0)
+    return 0;
+  return (glyphId + map.idDelta[i]) % 65536;
+}
+
+// Forward Map
+
+// Straight from the subtable, so format 12 keeps its supplementary planes
+map<uint32_t, uint16_t> char_map_forward(const CharMap &map) {
+  std::map<uint32_t, uint16_t> forward;
+  if (map.format == 12) {
+    for (const CmapGroup &g : map.groups) {
+      for (uint64_t c = g.start; c <= g.end; ++c) {
+        uint64_t glyph = g.glyph + (c - g.start);
+        if (glyph > 0xFFFF)
+          break;
+        if (glyph != 0)
+          forward[c] = glyph;
+      }
+    }
+  } else {
+    for (size_t i = 0; i < map.endCode.size(); ++i) {
+      for (uint32_t c = map.startCode[i]; c <= map.endCode[i]; ++c) {
+        uint16_t glyph = char_map_lookup(map, c);
+        if (glyph != 0)
+          forward[c] = glyph;
+      }
+    }
+  }
+  return forward;
+}
+
+// Reverse Map
+
+// Code points (BMP only) per glyph; unmapped codes and .notdef are left out
+map<uint16_t, vector<uint16_t>> char_map_reverse(const CharMap &map) {
+  std::map<uint16_t, vector<uint16_t>> glyphToUnicode;
+  if (map.format == 12) {
+    for (const CmapGroup &g : map.groups) {
+      for (uint32_t c = g.start; c <= g.end && c <= 0xFFFF; ++c) {
+        if (g.glyph + (c - g.start) <= 0xFFFF)
+          glyphToUnicode[g.glyph + (c - g.start)].push_back(c);
+      }
+    }
+  } else {
+    for (size_t i = 0; i < map.endCode.size(); ++i) {
+      for (uint32_t c = map.startCode[i]; c <= map.endCode[i]; ++c) {
+        uint16_t glyph = char_map_lookup(map, c);
+        if (glyph != 0)
+          glyphToUnicode[glyph].push_back(c);
+      }
+    }
+  }
+  glyphToUnicode.erase(0);
+  return glyphToUnicode;
+}
@@ -0,0 +1,39 @@
+#ifndef CMAP_H
+#define CMAP_H
+
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <vector>
+
+#include "font.h"
+
+// Sequential map group (format 12): codes start..end map to glyph..
+struct CmapGroup {
+  uint32_t start, end;
+  uint32_t glyph;
+};
+
+// In-memory copy of the best Unicode cmap subtable so lookups no longer seek
+// through the file. Format 4 keeps its segment arrays; format 12 keeps groups.
+// A font without a Unicode format 4 or 12 subtable gets format 0 and no
+// entries, so every lookup finds glyph 0.
+struct CharMap {
+  uint16_t format = 0;
+  std::vector<uint16_t> endCode, startCode;
+  std::vector<int16_t> idDelta;
+  std::vector<uint16_t> idRangeOffset;
+  std::vector<uint16_t> glyphIdArray;
+  std::vector<CmapGroup> groups;
+};
+
+CharMap parse_char_map(const uint8_t *cmap, uint32_t length);
+std::shared_ptr<const CharMap> font_char_map(const VerifiedFont &font);
+size_t char_map_bytes(const CharMap &map);
+
+uint16_t char_map_lookup(const CharMap &map, uint32_t codepoint);
+// Every mapped code point, .notdef left out
+std::map<uint32_t, uint16_t> char_map_forward(const CharMap &map);
+std::map<uint16_t, std::vector<uint16_t>> char_map_reverse(const CharMap &map);
+
+#endif
@@ -0,0 +1,184 @@
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "coverage.h"
+
+using namespace std;
+
+// Building
+
+// The page's own block, copied out of a shared one the first time it is
+// written
+static uint64_t *page_words(CoverageSet &set, uint32_t page) {
+  uint16_t block = set.pages[page];
+  if (block != COVERAGE_EMPTY && block != COVERAGE_FULL)
+    return &set.bits[block * 4];
+  uint64_t fill = block == COVERAGE_FULL ? ~0ull : 0;
+  set.pages[page] = set.bits.size() / 4;
+  set.bits.insert(set.bits.end(), 4, fill);
+  return &set.bits[set.pages[page] * 4];
+}
+
+static void set_range(CoverageSet &set, uint32_t first, uint32_t last) {
+  for (uint32_t page = first >> 8; page <= last >> 8; ++page) {
+    uint32_t lo = max(first, page << 8), hi = min(last, page << 8 | 0xFF);
+    if (lo == page << 8 && hi == (page << 8 | 0xFF)) {
+      set.pages[page] = COVERAGE_FULL;
+      continue;
+    }
+    if (set.pages[page] == COVERAGE_FULL)
+      continue;
+    uint64_t *words = page_words(set, page);
+    for (uint32_t w = (lo >> 6) & 3; w <= ((hi >> 6) & 3); ++w) {
+      uint32_t base = page << 8 | w << 6;
+      uint32_t from = max(lo, base) - base, to = min(hi, base + 63) - base;
+      uint64_t bits = to - from == 63 ? ~0ull : ((1ull << (to - from + 1)) - 1);
+      words[w] |= bits << from;
+    }
+  }
+}
+
+static void clear_bit(CoverageSet &set, uint32_t codepoint) {
+  if (set.pages[codepoint >> 8] == COVERAGE_EMPTY)
+    return;
+  uint64_t *words = page_words(set, codepoint >> 8);
+  words[(codepoint >> 6) & 3] &= ~(1ull << (codepoint & 63));
+}
+
+// Mirrors char_map_lookup: a code point counts when the lookup would
+// return a glyph other than 0, including the ids that wrap to 0
+CoverageSet build_coverage(const CharMap &map) {
+  CoverageSet set;
+  set.pages.assign(COVERAGE_PAGES, COVERAGE_EMPTY);
+  set.bits.assign(8, 0);
+  fill(set.bits.begin() + 4, set.bits.end(), ~0ull);
+
+  if (map.format == 12) {
+    for (size_t i = 0; i < map.groups.size(); ++i) {
+      const CmapGroup &g = map.groups[i];
+      // the lookup takes the last group starting at or before the code
+      uint32_t last = min<uint32_t>(g.end, 0x10FFFF);
+      if (i + 1 < map.groups.size() && map.groups[i + 1].start > g.start)
+        last = min(last, map.groups[i + 1].start - 1);
+      if (g.start > last)
+        continue;
+      set_range(set, g.start, last);
+      uint64_t wrap = g.start + (65536 - g.glyph % 65536) % 65536;
+      for (; wrap <= last; wrap += 65536)
+        clear_bit(set, wrap);
+    }
+  } else if (map.format == 4) {
+    for (size_t i = 0; i < map.endCode.size(); ++i) {
+      // the lookup takes the first segment ending at or after the code
+      uint32_t first = map.startCode[i], last = map.endCode[i];
+      if (i > 0)
+        first = max<uint32_t>(first, map.endCode[i - 1] + 1);
+      if (first > last)
+        continue;
+      if (map.idRangeOffset[i] != 0) {
+        for (uint32_t c = first; c <= last; ++c) {
+          if (char_map_lookup(map, c) != 0)
+            set_range(set, c, c);
+        }
+        continue;
+      }
+      set_range(set, first, last);
+      uint32_t wrap = (65536 - map.idDelta[i]) % 65536;
+      if (wrap >= first && wrap <= last)
+        clear_bit(set, wrap);
+    }
+  }
+  return set;
+}
+
+shared_ptr<const CoverageSet> font_coverage(const VerifiedFont &font) {
+  return lazy_cache(font, font.coverage, [&] { return build_coverage(*font_char_map(font)); },
+                    coverage_bytes);
+}
+
+size_t coverage_bytes(const CoverageSet &set) {
+  return vector_bytes(set.pages) + vector_bytes(set.bits);
+}
+
+// Queries
+
+CoverageQuery coverage_query(const vector<uint32_t> &codepoints) {
+  vector<uint32_t> sorted(codepoints);
+  sort(sorted.begin(), sorted.end());
+  sorted.erase(unique(sorted.begin(), sorted.end()), sorted.end());
+
+  CoverageQuery query;
+  for (uint32_t c : sorted) {
+    if (c > 0x10FFFF) {
+      query.outside.push_back(c);
+      continue;
+    }
+    if (query.pages.empty() || query.pages.back() != c >> 8) {
+      query.pages.push_back(c >> 8);
+      query.masks.insert(query.masks.end(), 4, 0);
+    }
+    query.masks[query.masks.size() - 4 + ((c >> 6) & 3)] |= 1ull << (c & 63);
+  }
+  return query;
+}
+
+bool coverage_covers(const CoverageSet &set, const CoverageQuery &query) {
+  if (!query.outside.empty())
+    return false;
+  for (size_t i = 0; i < query.pages.size(); ++i) {
+    const uint64_t *words = &set.bits[set.pages[query.pages[i]] * 4];
+    const uint64_t *mask = &query.masks[i * 4];
+    if ((mask[0] & ~words[0]) | (mask[1] & ~words[1]) | (mask[2] & ~words[2]) |
+        (mask[3] & ~words[3]))
+      return false;
+  }
+  return true;
+}
+
+vector<uint32_t> coverage_missing(const CoverageSet &set, const CoverageQuery &query) {
+  vector<uint32_t> missing;
+  for (size_t i = 0; i < query.pages.size(); ++i) {
+    const uint64_t *words = &set.bits[set.pages[query.pages[i]] * 4];
+    for (uint32_t w = 0; w < 4; ++w) {
+      uint64_t bits = query.masks[i * 4 + w] & ~words[w];
+      for (; bits; bits &= bits - 1)
+        missing.push_back((uint32_t)query.pages[i] << 8 | w << 6 | __builtin_ctzll(bits));
+    }
+  }
+  missing.insert(missing.end(), query.outside.begin(), query.outside.end());
+  return missing;
+}
+
+vector<uint32_t> coverage_ranges(const CoverageSet &set) {
+  vector<uint32_t> ranges;
+  bool inside = false;
+  // called at every point the coverage may change state
+  auto at = [&](uint32_t c, bool covered) {
+    if (covered == inside)
+      return;
+    ranges.push_back(covered ? c : c - 1);
+    inside = covered;
+  };
+  for (uint32_t page = 0; page < COVERAGE_PAGES; ++page) {
+    uint16_t block = set.pages[page];
+    if (block == COVERAGE_EMPTY || block == COVERAGE_FULL) {
+      at(page << 8, block == COVERAGE_FULL);
+      continue;
+    }
+    for (uint32_t w = 0; w < 4; ++w) {
+      uint64_t bits = set.bits[block * 4 + w];
+      uint32_t base = page << 8 | w << 6;
+      if (bits == 0 || bits == ~0ull) {
+        at(base, bits != 0);
+        continue;
+      }
+      for (uint32_t b = 0; b < 64; ++b)
+        at(base + b, (bits >> b) & 1);
+    }
+  }
+  if (inside)
+    ranges.push_back(0x10FFFF);
+  return ranges;
+}
@@ -0,0 +1,44 @@
+#ifndef COVERAGE_H
+#define COVERAGE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "cmap.h"
+#include "font.h"
+
+static const uint32_t COVERAGE_PAGES = 0x1100; // of 256 code points, through U+10FFFF
+static const uint16_t COVERAGE_EMPTY = 0;      // shared all-clear block
+static const uint16_t COVERAGE_FULL = 1;       // shared all-set block
+
+// Code points the cmap maps to a glyph other than .notdef, as a two-level
+// bitset: each 256-code-point page names a 4-word block of bits. Pages that
+// are entirely clear or entirely set share the first two blocks, so a font
+// only pays for the pages its cmap partly covers.
+struct CoverageSet {
+  std::vector<uint16_t> pages; // block per page
+  std::vector<uint64_t> bits;  // 4 words per block
+};
+
+// A string's code points grouped the same way, so it can be tested against
+// many fonts with one pass over its pages each
+struct CoverageQuery {
+  std::vector<uint16_t> pages; // ascending
+  std::vector<uint64_t> masks; // 4 words per page
+  std::vector<uint32_t> outside; // above U+10FFFF, never covered
+};
+
+CoverageSet build_coverage(const CharMap &map);
+std::shared_ptr<const CoverageSet> font_coverage(const VerifiedFont &font);
+size_t coverage_bytes(const CoverageSet &set);
+
+CoverageQuery coverage_query(const std::vector<uint32_t> &codepoints);
+bool coverage_covers(const CoverageSet &set, const CoverageQuery &query);
+// Ascending and without repeats
+std::vector<uint32_t> coverage_missing(const CoverageSet &set, const CoverageQuery &query);
+// Covered code points as inclusive first, last pairs
+std::vector<uint32_t> coverage_ranges(const CoverageSet &set);
+
+#endif
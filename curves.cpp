@@ -0,0 +1,250 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+#include "curves.h"
+#include "outline.h"
+#include "parallel.h"
+
+using namespace std;
+
+static const float CUBIC_TOLERANCE = 0.25f; // font units
+static const int MAX_CUBIC_PIECES = 16;
+static const int MAX_BANDS = 256;
+static const size_t COPY_CHUNK = 64; // glyphs per work item when gathering
+
+// One glyph's curves and bands with glyph-local texel indices
+struct GlyphCurves {
+  vector<float> curves;
+  vector<uint32_t> bandStarts; // 2 * bandCount + 1 offsets into entries
+  vector<uint32_t> entries;
+  float bounds[4] = {0, 0, 0, 0};
+};
+
+// Conversion
+
+static void push_texel(vector<float> &curves, float x, float y, float cx, float cy) {
+  curves.push_back(x);
+  curves.push_back(y);
+  curves.push_back(cx);
+  curves.push_back(cy);
+}
+
+// Splits a cubic into quadratics whose control point is the mid-point
+// approximation (3 (c1 + c2) - (p0 + p3)) / 4 of each piece. The error of
+// that is at most sqrt(3) / 36 |p3 - 3 c2 + 3 c1 - p0| and falls with the
+// cube of the piece length, which sets the number of pieces.
+static void push_cubic(vector<float> &curves, const Segment &s) {
+  float dx = s.x1 - 3 * s.cx2 + 3 * s.cx - s.x0;
+  float dy = s.y1 - 3 * s.cy2 + 3 * s.cy - s.y0;
+  float error = sqrt(3.0f) / 36 * sqrt(dx * dx + dy * dy);
+  int n = (int)ceil(cbrt(error / CUBIC_TOLERANCE));
+  n = max(1, min(n, MAX_CUBIC_PIECES));
+
+  auto at = [&](float t, float &x, float &y, float &tx, float &ty) {
+    float u = 1 - t;
+    x = u * u * u * s.x0 + 3 * u * u * t * s.cx + 3 * u * t * t * s.cx2 + t * t * t * s.x1;
+    y = u * u * u * s.y0 + 3 * u * u * t * s.cy + 3 * u * t * t * s.cy2 + t * t * t * s.y1;
+    tx = 3 * (u * u * (s.cx - s.x0) + 2 * u * t * (s.cx2 - s.cx) + t * t * (s.x1 - s.cx2));
+    ty = 3 * (u * u * (s.cy - s.y0) + 2 * u * t * (s.cy2 - s.cy) + t * t * (s.y1 - s.cy2));
+  };
+  float x0 = s.x0, y0 = s.y0, tx0, ty0, unused;
+  at(0, unused, unused, tx0, ty0);
+  for (int i = 1; i <= n; ++i) {
+    float h = 1.0f / n;
+    float x3, y3, tx3, ty3;
+    at((float)i / n, x3, y3, tx3, ty3);
+    if (i == n) {
+      x3 = s.x1; // land exactly on the next segment's start
+      y3 = s.y1;
+    }
+    float c1x = x0 + tx0 * h / 3, c1y = y0 + ty0 * h / 3;
+    float c2x = x3 - tx3 * h / 3, c2y = y3 - ty3 * h / 3;
+    push_texel(curves, x0, y0, (3 * (c1x + c2x) - (x0 + x3)) / 4,
+               (3 * (c1y + c2y) - (y0 + y3)) / 4);
+    x0 = x3;
+    y0 = y3;
+    tx0 = tx3;
+    ty0 = ty3;
+  }
+}
+
+static void convert_glyph(const GlyphOutline &outline, int bandCount, GlyphCurves &out) {
+  vector<Segment> segments;
+  vector<uint32_t> starts; // texels that begin a curve
+  int first = 0;
+  for (int c = 0; c < outline.numContours; ++c) {
+    int end = outline.contourEnds[c];
+    segments.clear();
+    contour_to_segments(outline.points + first, end - first + 1, segments);
+    first = end + 1;
+    if (segments.empty())
+      continue;
+    for (const Segment &s : segments) {
+      size_t before = out.curves.size() / 4;
+      if (s.cubic)
+        push_cubic(out.curves, s);
+      else if (s.quad)
+        push_texel(out.curves, s.x0, s.y0, s.cx, s.cy);
+      else
+        push_texel(out.curves, s.x0, s.y0, (s.x0 + s.x1) / 2, (s.y0 + s.y1) / 2);
+      for (size_t t = before; t < out.curves.size() / 4; ++t)
+        starts.push_back(t);
+    }
+    push_texel(out.curves, segments.back().x1, segments.back().y1, 0, 0);
+  }
+
+  out.bandStarts.assign(2 * bandCount + 1, 0);
+  if (starts.empty())
+    return;
+
+  // control points bound a quadratic, so their box bounds the glyph
+  float xMin = INFINITY, yMin = INFINITY, xMax = -INFINITY, yMax = -INFINITY;
+  vector<float> lo[2], hi[2]; // per curve extent in y (0) and x (1)
+  for (int axis = 0; axis < 2; ++axis) {
+    lo[axis].resize(starts.size());
+    hi[axis].resize(starts.size());
+  }
+  for (size_t i = 0; i < starts.size(); ++i) {
+    const float *t = &out.curves[4 * starts[i]];
+    float xs[3] = {t[0], t[2], t[4]}, ys[3] = {t[1], t[3], t[5]};
+    lo[0][i] = min({ys[0], ys[1], ys[2]});
+    hi[0][i] = max({ys[0], ys[1], ys[2]});
+    lo[1][i] = min({xs[0], xs[1], xs[2]});
+    hi[1][i] = max({xs[0], xs[1], xs[2]});
+    xMin = min(xMin, lo[1][i]);
+    xMax = max(xMax, hi[1][i]);
+    yMin = min(yMin, lo[0][i]);
+    yMax = max(yMax, hi[0][i]);
+  }
+  out.bounds[0] = xMin;
+  out.bounds[1] = yMin;
+  out.bounds[2] = xMax;
+  out.bounds[3] = yMax;
+
+  // axis 0 is the horizontal bands (sliced along y, sorted by max x) and
+  // axis 1 the vertical ones
+  vector<vector<uint32_t>> bands(2 * bandCount);
+  for (int axis = 0; axis < 2; ++axis) {
+    float origin = axis == 0 ? yMin : xMin;
+    float size = ((axis == 0 ? yMax : xMax) - origin) / bandCount;
+    for (size_t i = 0; i < starts.size(); ++i) {
+      if (lo[axis][i] == hi[axis][i])
+        continue; // parallel to the band's rays
+      int b0 = size > 0 ? (int)((lo[axis][i] - origin) / size) : 0;
+      int b1 = size > 0 ? (int)((hi[axis][i] - origin) / size) : 0;
+      for (int b = max(b0, 0); b <= min(b1, bandCount - 1); ++b)
+        bands[axis * bandCount + b].push_back(i);
+    }
+    const vector<float> &across = hi[1 - axis];
+    for (int b = 0; b < bandCount; ++b) {
+      vector<uint32_t> &band = bands[axis * bandCount + b];
+      stable_sort(band.begin(), band.end(),
+                  [&](uint32_t a, uint32_t c) { return across[a] > across[c]; });
+    }
+  }
+  for (size_t b = 0; b < bands.size(); ++b) {
+    out.bandStarts[b] = out.entries.size();
+    for (uint32_t i : bands[b])
+      out.entries.push_back(starts[i]);
+  }
+  out.bandStarts[bands.size()] = out.entries.size();
+}
+
+CurveBuffers build_curve_buffers(const OutlineBatch &batch, int bandCount) {
+  CurveBuffers buffers;
+  buffers.bandCount = max(1, min(bandCount, MAX_BANDS));
+  int bands = 2 * buffers.bandCount;
+
+  vector<GlyphCurves> glyphs(batch.count);
+  parallel_for(batch.count, 1, [&](size_t i) {
+    convert_glyph(batch.glyphs[i], buffers.bandCount, glyphs[i]);
+  });
+
+  vector<uint32_t> texelStarts(batch.count + 1, 0), entryStarts(batch.count + 1, 0);
+  for (uint32_t i = 0; i < batch.count; ++i) {
+    texelStarts[i + 1] = texelStarts[i] + glyphs[i].curves.size() / 4;
+    entryStarts[i + 1] = entryStarts[i] + glyphs[i].entries.size();
+  }
+  buffers.curves.resize((size_t)texelStarts[batch.count] * 4);
+  buffers.bounds.resize((size_t)batch.count * 4);
+  buffers.bands.resize((size_t)batch.count * bands * 2);
+  buffers.bandCurves.resize(entryStarts[batch.count]);
+
+  parallel_for(batch.count, COPY_CHUNK, [&](size_t i) {
+    const GlyphCurves &g = glyphs[i];
+    copy(g.curves.begin(), g.curves.end(), buffers.curves.begin() + (size_t)texelStarts[i] * 4);
+    copy(g.bounds, g.bounds + 4, buffers.bounds.begin() + i * 4);
+    for (int b = 0; b < bands; ++b) {
+      buffers.bands[(i * bands + b) * 2] = entryStarts[i] + g.bandStarts[b];
+      buffers.bands[(i * bands + b) * 2 + 1] = g.bandStarts[b + 1] - g.bandStarts[b];
+    }
+    for (size_t k = 0; k < g.entries.size(); ++k)
+      buffers.bandCurves[entryStarts[i] + k] = texelStarts[i] + g.entries[k];
+  });
+  return buffers;
+}
+
+// Reference Evaluation
+
+// Crossings of the horizontal line at y with the quadratic, each piece
+// between y extrema counted half-open at its top so shared end points are
+// counted once
+static int quad_winding(const float *t, float x, float y) {
+  float y0 = t[1], cy = t[3], y2 = t[5];
+  float a = y0 - 2 * cy + y2, b = 2 * (cy - y0), c = y0 - y;
+  float split[3] = {0, 1, 1};
+  int pieces = 1;
+  if (a != 0) {
+    float turn = (y0 - cy) / a;
+    if (turn > 0 && turn < 1) {
+      split[1] = turn;
+      pieces = 2;
+    }
+  }
+
+  int winding = 0;
+  for (int p = 0; p < pieces; ++p) {
+    float ta = split[p], tb = split[p + 1];
+    float ya = (a * ta + b) * ta + y0, yb = (a * tb + b) * tb + y0;
+    if (ya == yb || y < min(ya, yb) || y >= max(ya, yb))
+      continue;
+    float root;
+    if (fabs(a) < 1e-6f * (fabs(b) + 1)) {
+      root = -c / b;
+    } else {
+      float d = sqrt(max(b * b - 4 * a * c, 0.0f));
+      float r0 = (-b - d) / (2 * a), r1 = (-b + d) / (2 * a);
+      float mid = (ta + tb) / 2;
+      root = fabs(r0 - mid) < fabs(r1 - mid) ? r0 : r1;
+    }
+    root = max(ta, min(tb, root));
+    float u = 1 - root;
+    float rx = u * u * t[0] + 2 * u * root * t[2] + root * root * t[4];
+    if (rx > x)
+      winding += yb > ya ? 1 : -1;
+  }
+  return winding;
+}
+
+int curve_winding(const CurveBuffers &buffers, uint32_t glyph, float x, float y) {
+  if (glyph >= buffers.bounds.size() / 4)
+    return 0;
+  const float *bounds = &buffers.bounds[(size_t)glyph * 4];
+  if (y < bounds[1] || y > bounds[3])
+    return 0;
+  float size = (bounds[3] - bounds[1]) / buffers.bandCount;
+  int band = size > 0 ? (int)((y - bounds[1]) / size) : 0;
+  band = max(0, min(band, buffers.bandCount - 1));
+
+  const uint32_t *entry = &buffers.bands[((size_t)glyph * 2 * buffers.bandCount + band) * 2];
+  int winding = 0;
+  for (uint32_t k = 0; k < entry[1]; ++k) {
+    const float *t = &buffers.curves[(size_t)buffers.bandCurves[entry[0] + k] * 4];
+    if (max({t[0], t[2], t[4]}) <= x)
+      break; // the rest of the band is behind the ray too
+    winding += quad_winding(t, x, y);
+  }
+  return winding;
+}
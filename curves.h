@@ -0,0 +1,43 @@
+#ifndef CURVES_H
+#define CURVES_H
+
+#include <cstdint>
+#include <vector>
+
+#include "decode.h"
+
+// Outlines as explicit quadratic curves, banded for a fragment shader that
+// casts one ray per pixel and only visits the curves of the band it is in.
+//
+// curves holds RGBA texels of 4 floats. A contour of n curves takes n + 1
+// consecutive texels: texel t is (x0, y0, cx, cy) of a curve, and its end
+// point is the x, y of texel t + 1; the last texel holds the closing point
+// and zeros. Lines get their midpoint as control point and cubics are split
+// into quadratics, so every curve has the same form.
+//
+// Each glyph has bandCount horizontal bands (equal slices of its bounds,
+// bottom to top) followed by bandCount vertical ones (left to right). Band
+// b of glyph g is bands[2 * (2 * bandCount * g + b)] (first entry in
+// bandCurves) and the word after it (entry count). Entries are texel
+// indices of the curves crossing the band, horizontal bands sorted by
+// decreasing max x and vertical ones by decreasing max y, so a ray can stop
+// at the first curve that is entirely behind it. Curves that are flat along
+// a band's direction are left out of it.
+struct CurveBuffers {
+  int bandCount = 0;
+  std::vector<float> curves;
+  std::vector<float> bounds; // per glyph: xMin, yMin, xMax, yMax
+  std::vector<uint32_t> bands;
+  std::vector<uint32_t> bandCurves;
+};
+
+// Glyph i of the batch becomes glyph i of the buffers. Glyphs are converted
+// in parallel.
+CurveBuffers build_curve_buffers(const OutlineBatch &batch, int bandCount);
+
+// Nonzero winding of (x, y) in the glyph, counted along a ray towards +x
+// through the glyph's horizontal band the way the shader does; 0 is outside,
+// and for a glyph the buffers do not hold
+int curve_winding(const CurveBuffers &buffers, uint32_t glyph, float x, float y);
+
+#endif
@@ -0,0 +1,120 @@
+#include <cstdint>
+#include <vector>
+
+#include "bytes.h"
+#include "cff.h"
+#include "decode.h"
+
+using namespace std;
+
+// Per-thread scratch that only ever grows, so steady-state decoding does no
+// heap allocation: flags live here, points and endPts go to the arena.
+struct DecodeScratch {
+  vector<uint8_t> flags;
+  Arena arena; // backs decode_glyph's temporary outline
+};
+
+static thread_local DecodeScratch scratch;
+
+// Unchecked Decode
+
+// Reads straight from the verified bytes; validate_font has already proven
+// every offset, count and repeat below stays within the glyph.
+GlyphOutline decode_outline(const VerifiedFont &font, uint16_t glyph, Arena &arena) {
+  if (font.cff)
+    return decode_cff_outline(font, glyph, arena);
+
+  GlyphOutline outline = {nullptr, nullptr, 0, 0};
+  if (glyph >= font.numGlyphs || font.loca[glyph] == font.loca[glyph + 1])
+    return outline;
+
+  const uint8_t *g = &font.data[font.glyfOffset + font.loca[glyph]];
+  int16_t numContours = (int16_t)be16(g);
+  if (numContours <= 0)
+    return outline; // skip composite
+
+  const uint8_t *p = g + 10;
+  uint16_t *endPts = arena_array<uint16_t>(arena, numContours);
+  decode_be16(p, numContours, endPts);
+  p += 2 * numContours;
+  p += 2 + be16(p); // instructions
+
+  uint32_t numPoints = endPts[numContours - 1] + 1;
+  if (scratch.flags.size() < numPoints)
+    scratch.flags.resize(numPoints);
+  uint8_t *flags = scratch.flags.data();
+  for (uint32_t i = 0; i < numPoints;) {
+    uint8_t flag = *p++;
+    flags[i++] = flag;
+    if (flag & 0x08) {
+      for (int r = *p++; r > 0; --r)
+        flags[i++] = flag;
+    }
+  }
+
+  Point *points = arena_array<Point>(arena, numPoints);
+  int x = 0;
+  for (uint32_t i = 0; i < numPoints; ++i) {
+    uint8_t flag = flags[i];
+    if (flag & 0x02) {
+      uint8_t val = *p++;
+      x += (flag & 0x10) ? val : -val;
+    } else if (!(flag & 0x10)) {
+      x += (int16_t)be16(p);
+      p += 2;
+    }
+    points[i].x = x;
+    points[i].onCurve = flag & 0x01;
+    points[i].cubic = false;
+  }
+
+  int y = 0;
+  for (uint32_t i = 0; i < numPoints; ++i) {
+    uint8_t flag = flags[i];
+    if (flag & 0x04) {
+      uint8_t val = *p++;
+      y += (flag & 0x20) ? val : -val;
+    } else if (!(flag & 0x20)) {
+      y += (int16_t)be16(p);
+      p += 2;
+    }
+    points[i].y = y;
+  }
+
+  outline.points = points;
+  outline.contourEnds = endPts;
+  outline.numPoints = numPoints;
+  outline.numContours = numContours;
+  return outline;
+}
+
+OutlineBatch decode_outlines(const VerifiedFont &font, uint16_t first,
+                             uint32_t count, Arena &arena) {
+  if (first >= font.numGlyphs)
+    count = 0;
+  else if (first + count > font.numGlyphs)
+    count = font.numGlyphs - first;
+
+  OutlineBatch batch = {first, count, arena_array<GlyphOutline>(arena, count)};
+  for (uint32_t i = 0; i < count; ++i)
+    batch.glyphs[i] = decode_outline(font, first + i, arena);
+  return batch;
+}
+
+// Nested Vectors
+
+vector<vector<Point>> outline_contours(const GlyphOutline &outline) {
+  vector<vector<Point>> contours(outline.numContours);
+  uint32_t start = 0;
+  for (int c = 0; c < outline.numContours; ++c) {
+    uint32_t end = outline.contourEnds[c] + 1;
+    contours[c].assign(outline.points + start, outline.points + end);
+    start = end;
+  }
+  return contours;
+}
+
+vector<vector<Point>> decode_glyph(const VerifiedFont &font, uint16_t glyph) {
+  arena_reset(scratch.arena);
+  return outline_contours(decode_outline(font, glyph, scratch.arena));
+}
@@ -0,0 +1,35 @@
+#ifndef DECODE_H
+#define DECODE_H
+
+#include <cstdint>
+#include <vector>
+
+#include "arena.h"
+#include "font.h"
+#include "validate.h"
+
+// One glyph's points in arena memory. Contour c ends at point
+// contourEnds[c] (inclusive), as in the glyf endPtsOfContours array.
+struct GlyphOutline {
+  Point *points;
+  uint16_t *contourEnds;
+  uint32_t numPoints;
+  uint16_t numContours;
+};
+
+// Decoded outlines for a glyph range; valid until the arena is reset.
+struct OutlineBatch {
+  uint16_t first;
+  uint32_t count;
+  GlyphOutline *glyphs;
+};
+
+GlyphOutline decode_outline(const VerifiedFont &font, uint16_t glyph, Arena &arena);
+OutlineBatch decode_outlines(const VerifiedFont &font, uint16_t first,
+                             uint32_t count, Arena &arena);
+
+// Nested-vector form used by the embind API
+std::vector<std::vector<Point>> decode_glyph(const VerifiedFont &font, uint16_t glyph);
+std::vector<std::vector<Point>> outline_contours(const GlyphOutline &outline);
+
+#endif
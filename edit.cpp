@@ -0,0 +1,153 @@
+#include <cstdint>
+#include <vector>
+
+#include "arena.h"
+#include "decode.h"
+#include "edit.h"
+
+using namespace std;
+
+static Arena edit_arena; // holds the outline while it is copied into WBPoints
+
+static FontDiagnostic edit_error(int glyph, const string &message) {
+  return {false, FONT_BAD_EDIT, "glyf", glyph, message};
+}
+
+// glyf stores coordinates as int16
+static bool fits_int16(int64_t v) {
+  return v >= INT16_MIN && v <= INT16_MAX;
+}
+
+static vector<WBPoint> &pending_outline(const VerifiedFont &font, uint16_t glyph,
+                                        PendingEdits &pending) {
+  auto it = pending.find(glyph);
+  if (it != pending.end())
+    return it->second;
+
+  arena_reset(edit_arena);
+  GlyphOutline outline = decode_outline(font, glyph, edit_arena);
+  vector<WBPoint> &points = pending[glyph];
+  points.resize(outline.numPoints);
+  for (uint32_t i = 0; i < outline.numPoints; ++i)
+    points[i] = {outline.points[i].x, outline.points[i].y, outline.points[i].onCurve, false};
+  for (int c = 0; c < outline.numContours; ++c)
+    points[outline.contourEnds[c]].endPt = true;
+  return points;
+}
+
+// Checks one record against the glyph it edits and applies it only if the
+// glyph stays writable: some points left, the last one ending a contour and
+// every coordinate within int16.
+static FontDiagnostic apply_record(const int32_t *words, size_t count, size_t &pos,
+                                   int32_t glyph, vector<WBPoint> &points,
+                                   GlyphGrids *grids) {
+  int32_t op = words[pos];
+  int64_t size = points.size();
+  int64_t at = words[pos + 2];
+
+  switch (op) {
+  case EDIT_MOVE: {
+    if (count - pos < 5)
+      return edit_error(glyph, "truncated edit record");
+    if (at < 0 || at >= size)
+      return edit_error(glyph, "point index out of range");
+    int64_t x = (int64_t)points[at].x + words[pos + 3];
+    int64_t y = (int64_t)points[at].y + words[pos + 4];
+    if (!fits_int16(x) || !fits_int16(y))
+      return edit_error(glyph, "coordinate outside int16");
+    points[at].x = x;
+    points[at].y = y;
+    if (grids) {
+      auto grid = grids->byGlyph.find(glyph);
+      if (grid != grids->byGlyph.end())
+        grid_move_point(grid->second, at, x, y);
+    }
+    pos += 5;
+    break;
+  }
+
+  case EDIT_FLAGS:
+    if (at < 0 || at >= size)
+      return edit_error(glyph, "point index out of range");
+    if (at == size - 1 && !(words[pos + 3] & EDIT_END_CONTOUR))
+      return edit_error(glyph, "last point must end a contour");
+    points[at].onCurve = words[pos + 3] & EDIT_ON_CURVE;
+    points[at].endPt = words[pos + 3] & EDIT_END_CONTOUR;
+    pos += 4;
+    break;
+
+  case EDIT_INSERT: {
+    int64_t n = words[pos + 3];
+    if (at < 0 || at > size || n < 0)
+      return edit_error(glyph, "insert range out of range");
+    if ((uint64_t)n * 3 > count - pos - 4)
+      return edit_error(glyph, "truncated edit record");
+    const int32_t *src = words + pos + 4;
+    for (int64_t i = 0; i < n; ++i) {
+      if (!fits_int16(src[3 * i]) || !fits_int16(src[3 * i + 1]))
+        return edit_error(glyph, "coordinate outside int16");
+    }
+    if (at == size && (n > 0 ? !(src[3 * (n - 1) + 2] & EDIT_END_CONTOUR) : size == 0))
+      return edit_error(glyph, "last point must end a contour");
+    points.insert(points.begin() + at, n, WBPoint());
+    for (int64_t i = 0; i < n; ++i, src += 3)
+      points[at + i] = {src[0], src[1], (src[2] & EDIT_ON_CURVE) != 0,
+                        (src[2] & EDIT_END_CONTOUR) != 0};
+    if (grids)
+      drop_point_grid(*grids, glyph);
+    pos += 4 + n * 3;
+    break;
+  }
+
+  case EDIT_REMOVE: {
+    int64_t n = words[pos + 3];
+    if (at < 0 || n < 0 || at + n > size)
+      return edit_error(glyph, "remove range out of range");
+    if (n == size)
+      return edit_error(glyph, "cannot remove every point");
+    // a removed contour end moves to the point before the range so the
+    // remaining points keep their contour
+    bool endsContour = false;
+    for (int64_t i = at; i < at + n; ++i)
+      endsContour |= points[i].endPt;
+    points.erase(points.begin() + at, points.begin() + at + n);
+    if (endsContour && at > 0)
+      points[at - 1].endPt = true;
+    if (grids)
+      drop_point_grid(*grids, glyph);
+    pos += 4;
+    break;
+  }
+  }
+  return {true, FONT_OK, "", -1, ""};
+}
+
+FontDiagnostic apply_glyph_edits(const VerifiedFont &font, const int32_t *words,
+                                 size_t count, PendingEdits &pending,
+                                 GlyphGrids *grids) {
+  if (font.cff)
+    return {false, FONT_BAD_EDIT, "CFF ", -1, "CFF outlines cannot be written back"};
+
+  size_t pos = 0;
+  while (pos < count) {
+    if (count - pos < 4)
+      return edit_error(-1, "truncated edit record");
+    int32_t op = words[pos];
+    int32_t glyph = words[pos + 1];
+    if (op < EDIT_MOVE || op > EDIT_REMOVE)
+      return edit_error(glyph, "unknown edit opcode");
+    if (glyph < 0 || glyph >= font.numGlyphs)
+      return edit_error(glyph, "glyph index out of range");
+
+    // a glyph first touched by a rejected record is not left pending
+    bool touched = pending.count(glyph) != 0;
+    FontDiagnostic diag = apply_record(words, count, pos, glyph,
+                                       pending_outline(font, glyph, pending), grids);
+    if (!diag.ok) {
+      if (!touched)
+        pending.erase(glyph);
+      return diag;
+    }
+  }
+  return {true, FONT_OK, "", -1, ""};
+}
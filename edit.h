@@ -0,0 +1,49 @@
+#ifndef EDIT_H
+#define EDIT_H
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <vector>
+
+#include "font.h"
+#include "spatial.h"
+#include "validate.h"
+#include "writeback.h"
+
+// Opcodes of the edit stream sent by the editor as an Int32Array. Each
+// record is the opcode followed by its operands:
+//   EDIT_MOVE   glyph point dx dy
+//   EDIT_FLAGS  glyph point flags
+//   EDIT_INSERT glyph at count, then count (x y flags) triples
+//   EDIT_REMOVE glyph first count
+// Point indices are into the glyph's flat point list as it stands after
+// the records before it.
+enum GlyphEditOp {
+  EDIT_MOVE = 0,
+  EDIT_FLAGS = 1,
+  EDIT_INSERT = 2,
+  EDIT_REMOVE = 3,
+};
+
+enum GlyphEditFlag {
+  EDIT_ON_CURVE = 1,
+  EDIT_END_CONTOUR = 2,
+};
+
+// Outlines of the glyphs touched since the last commit. A glyph is
+// decoded from the font on its first edit; later edits only touch the
+// points they name.
+typedef std::map<uint16_t, std::vector<WBPoint>> PendingEdits;
+
+// Applies the records in order. A record that is malformed or would leave
+// its glyph unwritable (no points, a last point not ending a contour, a
+// coordinate outside int16) is rejected before it touches the glyph; the
+// diagnostic names it and the records before it stay applied. Moves are
+// mirrored into grids; an insert or remove drops the glyph's grid for a
+// lazy rebuild.
+FontDiagnostic apply_glyph_edits(const VerifiedFont &font, const int32_t *words,
+                                 size_t count, PendingEdits &pending,
+                                 GlyphGrids *grids = nullptr);
+
+#endif
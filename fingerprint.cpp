@@ -0,0 +1,192 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "arena.h"
+#include "decode.h"
+#include "fingerprint.h"
+#include "parallel.h"
+
+using namespace std;
+
+static const int SKETCH_ROWS = SKETCH_SIZE / SKETCH_BANDS;
+
+static uint64_t mix(uint64_t x) {
+  x += 0x9E3779B97F4A7C15ull;
+  x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ull;
+  x = (x ^ (x >> 27)) * 0x94D049BB133111EBull;
+  return x ^ (x >> 31);
+}
+
+// Fingerprints
+
+static int quantize(int v, uint16_t unitsPerEm) {
+  return (int)lround((double)v * FINGERPRINT_GRID / unitsPerEm);
+}
+
+uint64_t glyph_fingerprint(const GlyphOutline &outline, uint16_t unitsPerEm) {
+  if (outline.numPoints == 0 || unitsPerEm == 0)
+    return 0;
+
+  int votes[64] = {0};
+  auto add = [&](uint64_t feature) {
+    uint64_t h = mix(feature);
+    for (int b = 0; b < 64; ++b)
+      votes[b] += (h >> b) & 1 ? 1 : -1;
+  };
+
+  uint32_t start = 0;
+  for (uint16_t c = 0; c < outline.numContours; ++c) {
+    uint32_t end = outline.contourEnds[c];
+    for (uint32_t i = start; i <= end; ++i) {
+      const Point &p = outline.points[i];
+      const Point &n = outline.points[i == end ? start : i + 1];
+      uint64_t px = quantize(p.x, unitsPerEm) & 0xFFFF;
+      uint64_t py = quantize(p.y, unitsPerEm) & 0xFFFF;
+      uint64_t nx = quantize(n.x, unitsPerEm) & 0xFFFF;
+      uint64_t ny = quantize(n.y, unitsPerEm) & 0xFFFF;
+      add(px | py << 16 | (uint64_t)p.onCurve << 32 | 1ull << 40);
+      add(px | py << 16 | nx << 32 | ny << 48);
+    }
+    start = end + 1;
+  }
+
+  uint64_t fingerprint = 0;
+  for (int b = 0; b < 64; ++b) {
+    if (votes[b] > 0)
+      fingerprint |= 1ull << b;
+  }
+  return fingerprint ? fingerprint : 1; // 0 is kept for glyphs without one
+}
+
+FontSketch font_sketch(const VerifiedFont &font, Arena &arena) {
+  FontSketch sketch;
+  sketch.glyphs.resize(font.numGlyphs);
+  fill(begin(sketch.minhash), end(sketch.minhash), UINT64_MAX);
+  for (uint32_t g = 0; g < font.numGlyphs; ++g) {
+    arena_reset(arena);
+    uint64_t fingerprint = glyph_fingerprint(decode_outline(font, g, arena), font.unitsPerEm);
+    sketch.glyphs[g] = fingerprint;
+    if (!fingerprint)
+      continue;
+    for (int i = 0; i < SKETCH_SIZE; ++i)
+      sketch.minhash[i] = min(sketch.minhash[i], mix(fingerprint ^ mix(i)));
+  }
+  return sketch;
+}
+
+vector<FontSketch> font_sketch_files(const vector<string> &paths,
+                                     vector<FontDiagnostic> &diagnostics) {
+  vector<FontSketch> sketches(paths.size());
+  diagnostics.assign(paths.size(), FontDiagnostic{true, FONT_OK, "", -1, ""});
+  for (auto &sketch : sketches)
+    fill(begin(sketch.minhash), end(sketch.minhash), UINT64_MAX);
+
+  // each font is loaded and decoded by one worker, so its CFF subroutine
+  // caches are never shared
+  parallel_for<Arena>(paths.size(), 1, [&](Arena &arena, size_t i) {
+    VerifiedFont font;
+    diagnostics[i] = load_verified_font(paths[i], font);
+    if (diagnostics[i].ok)
+      sketches[i] = font_sketch(font, arena);
+  });
+  return sketches;
+}
+
+// Index
+
+static bool empty_sketch(const FontSketch &sketch) {
+  return sketch.minhash[0] == UINT64_MAX;
+}
+
+static uint64_t band_key(const FontSketch &sketch, int band) {
+  uint64_t key = mix(band);
+  for (int r = 0; r < SKETCH_ROWS; ++r)
+    key = mix(key ^ sketch.minhash[band * SKETCH_ROWS + r]);
+  return key;
+}
+
+static uint32_t block_key(uint64_t fingerprint, int block) {
+  return (uint32_t)block << 16 | (uint32_t)(fingerprint >> (16 * block) & 0xFFFF);
+}
+
+uint32_t index_add(FingerprintIndex &index, FontSketch sketch) {
+  uint32_t id = index.fonts.size();
+  if (!empty_sketch(sketch)) {
+    for (int band = 0; band < SKETCH_BANDS; ++band)
+      index.bands[band_key(sketch, band)].push_back(id);
+  }
+  for (uint32_t g = 0; g < sketch.glyphs.size(); ++g) {
+    if (!sketch.glyphs[g])
+      continue;
+    for (int block = 0; block < 4; ++block)
+      index.blocks[block_key(sketch.glyphs[g], block)].push_back({id, (uint16_t)g});
+  }
+  index.fonts.push_back(move(sketch));
+  return id;
+}
+
+vector<FontMatch> index_similar_fonts(const FingerprintIndex &index,
+                                      const FontSketch &sketch, float minSimilarity) {
+  vector<FontMatch> matches;
+  if (empty_sketch(sketch))
+    return matches;
+
+  vector<uint32_t> candidates;
+  for (int band = 0; band < SKETCH_BANDS; ++band) {
+    auto bucket = index.bands.find(band_key(sketch, band));
+    if (bucket != index.bands.end())
+      candidates.insert(candidates.end(), bucket->second.begin(), bucket->second.end());
+  }
+  sort(candidates.begin(), candidates.end());
+  candidates.erase(unique(candidates.begin(), candidates.end()), candidates.end());
+
+  for (uint32_t id : candidates) {
+    const FontSketch &other = index.fonts[id];
+    int same = 0;
+    for (int i = 0; i < SKETCH_SIZE; ++i)
+      same += sketch.minhash[i] == other.minhash[i];
+    float similarity = (float)same / SKETCH_SIZE;
+    if (similarity >= minSimilarity)
+      matches.push_back({id, similarity});
+  }
+  sort(matches.begin(), matches.end(), [](const FontMatch &a, const FontMatch &b) {
+    return a.similarity != b.similarity ? a.similarity > b.similarity : a.font < b.font;
+  });
+  return matches;
+}
+
+vector<GlyphMatch> index_similar_glyphs(const FingerprintIndex &index,
+                                        uint64_t fingerprint, int maxDistance) {
+  vector<GlyphMatch> matches;
+  if (!fingerprint)
+    return matches;
+
+  // a glyph agreeing on several blocks sits in several buckets
+  vector<GlyphRef> candidates;
+  for (int block = 0; block < 4; ++block) {
+    auto bucket = index.blocks.find(block_key(fingerprint, block));
+    if (bucket != index.blocks.end())
+      candidates.insert(candidates.end(), bucket->second.begin(), bucket->second.end());
+  }
+  sort(candidates.begin(), candidates.end(), [](const GlyphRef &a, const GlyphRef &b) {
+    return a.font != b.font ? a.font < b.font : a.glyph < b.glyph;
+  });
+  candidates.erase(unique(candidates.begin(), candidates.end(),
+                          [](const GlyphRef &a, const GlyphRef &b) {
+                            return a.font == b.font && a.glyph == b.glyph;
+                          }),
+                   candidates.end());
+
+  for (const GlyphRef &ref : candidates) {
+    int distance = __builtin_popcountll(fingerprint ^ index.fonts[ref.font].glyphs[ref.glyph]);
+    if (distance <= maxDistance)
+      matches.push_back({ref.font, ref.glyph, (uint8_t)distance});
+  }
+  stable_sort(matches.begin(), matches.end(), [](const GlyphMatch &a, const GlyphMatch &b) {
+    return a.distance < b.distance;
+  });
+  return matches;
+}
@@ -0,0 +1,81 @@
+#ifndef FINGERPRINT_H
+#define FINGERPRINT_H
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "arena.h"
+#include "decode.h"
+#include "font.h"
+#include "validate.h"
+
+// Outline fingerprints for finding renamed copies and light derivatives in
+// a font library without comparing outlines pairwise.
+//
+// A glyph's fingerprint is a 64-bit SimHash of its outline scaled to the em
+// and quantized to FINGERPRINT_GRID cells per em: its points and edges are
+// the features, so outlines that differ in a few points land a few bits
+// apart. A font's sketch is a MinHash over its glyph fingerprints, whose
+// agreement estimates the share of glyphs two fonts have in common.
+
+static const int FINGERPRINT_GRID = 128;
+static const int SKETCH_SIZE = 64;
+static const int SKETCH_BANDS = 16; // of SKETCH_SIZE / SKETCH_BANDS rows
+
+struct FontSketch {
+  std::vector<uint64_t> glyphs; // by glyph id; 0 for composite and empty glyphs
+  uint64_t minhash[SKETCH_SIZE];
+};
+
+// 0 for a glyph without an outline of its own (composites, like
+// decode_outline)
+uint64_t glyph_fingerprint(const GlyphOutline &outline, uint16_t unitsPerEm);
+FontSketch font_sketch(const VerifiedFont &font, Arena &arena);
+
+// Sketches the fonts at paths in parallel, one font per worker. A font that
+// fails to load gets an empty sketch and its diagnostic.
+std::vector<FontSketch> font_sketch_files(const std::vector<std::string> &paths,
+                                          std::vector<FontDiagnostic> &diagnostics);
+
+// Index
+
+struct GlyphRef {
+  uint32_t font;
+  uint16_t glyph;
+};
+
+// Fonts are bucketed by each band of their sketch, so a query only visits
+// fonts that agree on a whole band; glyphs by each 16-bit block of their
+// fingerprint, so two fingerprints up to 3 bits apart always share one.
+struct FingerprintIndex {
+  std::vector<FontSketch> fonts; // by the id index_add returned
+  std::unordered_map<uint64_t, std::vector<uint32_t>> bands;
+  std::unordered_map<uint32_t, std::vector<GlyphRef>> blocks; // block << 16 | bits
+};
+
+struct FontMatch {
+  uint32_t font;
+  float similarity; // estimated share of identical glyph outlines
+};
+
+struct GlyphMatch {
+  uint32_t font;
+  uint16_t glyph;
+  uint8_t distance; // differing fingerprint bits
+};
+
+uint32_t index_add(FingerprintIndex &index, FontSketch sketch);
+
+// Most similar first. Fonts sharing about half their glyphs or more are
+// found reliably; below that only some are.
+std::vector<FontMatch> index_similar_fonts(const FingerprintIndex &index,
+                                           const FontSketch &sketch, float minSimilarity);
+
+// Nearest first. Every match up to 3 bits away is found; farther ones only
+// when one block of the fingerprint still agrees.
+std::vector<GlyphMatch> index_similar_glyphs(const FingerprintIndex &index,
+                                             uint64_t fingerprint, int maxDistance);
+
+#endif
@@ -0,0 +1,122 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+#include "flatten.h"
+
+using namespace std;
+
+static const float MIN_TOLERANCE = 1.0f / 64; // font units
+static const float MAX_TOLERANCE = 4096;
+
+// Chord Counts
+
+// n equal-t chords stray from a curve by at most max|B''| / (8 n^2). For a
+// quadratic B'' is 2 (p0 - 2c + p1); for a cubic it is 6 times a blend of
+// its two second differences, so the larger bounds it.
+int segment_steps(const Segment &s, float tolerance) {
+  float bound;
+  if (s.cubic) {
+    float ddx = max(fabs(s.x0 - 2 * s.cx + s.cx2), fabs(s.cx - 2 * s.cx2 + s.x1));
+    float ddy = max(fabs(s.y0 - 2 * s.cy + s.cy2), fabs(s.cy - 2 * s.cy2 + s.y1));
+    bound = 6 * sqrt(ddx * ddx + ddy * ddy);
+  } else if (s.quad) {
+    float ddx = s.x0 - 2 * s.cx + s.x1;
+    float ddy = s.y0 - 2 * s.cy + s.y1;
+    bound = 2 * sqrt(ddx * ddx + ddy * ddy);
+  } else {
+    return 1;
+  }
+  int n = (int)ceil(sqrt(bound / (8 * tolerance)));
+  return max(1, min(n, FLATTEN_MAX_STEPS));
+}
+
+void append_segment_points(const Segment &s, int steps, vector<float> &coords) {
+  if (!s.quad && !s.cubic) {
+    coords.push_back(s.x1);
+    coords.push_back(s.y1);
+    return;
+  }
+  for (int i = 1; i < steps; ++i) {
+    float t = (float)i / steps, u = 1 - t;
+    if (s.cubic) {
+      coords.push_back(u * u * u * s.x0 + 3 * u * u * t * s.cx + 3 * u * t * t * s.cx2 + t * t * t * s.x1);
+      coords.push_back(u * u * u * s.y0 + 3 * u * u * t * s.cy + 3 * u * t * t * s.cy2 + t * t * t * s.y1);
+    } else {
+      coords.push_back(u * u * s.x0 + 2 * u * t * s.cx + t * t * s.x1);
+      coords.push_back(u * u * s.y0 + 2 * u * t * s.cy + t * t * s.y1);
+    }
+  }
+  // the exact end, so consecutive segments meet
+  coords.push_back(s.x1);
+  coords.push_back(s.y1);
+}
+
+// Polylines
+
+void flatten_outline(const GlyphOutline &outline, float tolerance, Polyline &out) {
+  out.coords.clear();
+  out.contourEnds.clear();
+  vector<Segment> segments;
+  uint32_t first = 0;
+  for (int c = 0; c < outline.numContours; ++c) {
+    uint32_t end = outline.contourEnds[c];
+    segments.clear();
+    contour_to_segments(outline.points + first, end - first + 1, segments);
+    first = end + 1;
+    if (segments.empty())
+      continue;
+    size_t start = out.coords.size();
+    out.coords.push_back(segments[0].x0);
+    out.coords.push_back(segments[0].y0);
+    for (const Segment &s : segments)
+      append_segment_points(s, segment_steps(s, tolerance), out.coords);
+    // the last segment ends where the contour started, which stays implied
+    out.coords.pop_back();
+    out.coords.pop_back();
+    if (out.coords.size() - start < 4) {
+      out.coords.resize(start); // collapsed to a point
+      continue;
+    }
+    out.contourEnds.push_back(out.coords.size() / 2 - 1);
+  }
+}
+
+int tolerance_bucket(float tolerance) {
+  tolerance = max(MIN_TOLERANCE, min(tolerance, MAX_TOLERANCE));
+  return (int)floor(2 * log2(tolerance));
+}
+
+float bucket_tolerance(int bucket) {
+  return exp2(bucket / 2.0f);
+}
+
+static size_t polyline_bytes(const Polyline &polyline) {
+  return sizeof(polyline) + polyline.coords.capacity() * sizeof(float) +
+         polyline.contourEnds.capacity() * sizeof(uint32_t);
+}
+
+const Polyline &cached_polyline(PolylineCache &cache, const VerifiedFont &font,
+                                uint16_t glyph, float tolerance, Arena &arena) {
+  int bucket = tolerance_bucket(tolerance);
+  map<int, Polyline> &sizes = cache.byGlyph[glyph];
+  auto it = sizes.find(bucket);
+  if (it != sizes.end())
+    return it->second;
+
+  Polyline &polyline = sizes[bucket];
+  arena_reset(arena);
+  flatten_outline(decode_outline(font, glyph, arena), bucket_tolerance(bucket), polyline);
+  cache.bytes += polyline_bytes(polyline);
+  return polyline;
+}
+
+void drop_polylines(PolylineCache &cache, uint16_t glyph) {
+  auto it = cache.byGlyph.find(glyph);
+  if (it == cache.byGlyph.end())
+    return;
+  for (const auto &pair : it->second)
+    cache.bytes -= polyline_bytes(pair.second);
+  cache.byGlyph.erase(it);
+}
@@ -0,0 +1,55 @@
+#ifndef FLATTEN_H
+#define FLATTEN_H
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <vector>
+
+#include "arena.h"
+#include "decode.h"
+#include "font.h"
+#include "outline.h"
+
+// Outlines as closed polylines. Each curve is cut into as many equal-t
+// chords as its second differences say keep it within the tolerance, so
+// nearly straight curves get one chord and tight ones more, at any scale.
+
+static const int FLATTEN_MAX_STEPS = 256; // chords per curve
+
+// Chords that keep s within tolerance (in s's units) of its curve; 1 for a
+// line
+int segment_steps(const Segment &s, float tolerance);
+
+// Appends the ends of s's steps chords as x, y pairs; s's start is left to
+// the previous segment
+void append_segment_points(const Segment &s, int steps, std::vector<float> &coords);
+
+// One glyph. Contours are closed: the last point joins back to the first,
+// which is not repeated.
+struct Polyline {
+  std::vector<float> coords;         // x, y pairs
+  std::vector<uint32_t> contourEnds; // last point of each contour, inclusive
+};
+
+void flatten_outline(const GlyphOutline &outline, float tolerance, Polyline &out);
+
+// Tolerances are cached in half-octave buckets. A bucket is flattened at
+// the smallest tolerance it holds, so a cached polyline is never coarser
+// than asked for and at most about 1.4 times finer.
+int tolerance_bucket(float tolerance);
+float bucket_tolerance(int bucket);
+
+// Polylines of the published font, by glyph and then tolerance bucket, and
+// the bytes they hold
+struct PolylineCache {
+  std::map<uint16_t, std::map<int, Polyline>> byGlyph;
+  size_t bytes = 0;
+};
+
+// tolerance is in font units
+const Polyline &cached_polyline(PolylineCache &cache, const VerifiedFont &font,
+                                uint16_t glyph, float tolerance, Arena &arena);
+void drop_polylines(PolylineCache &cache, uint16_t glyph);
+
+#endif
@@ -0,0 +1,104 @@
+#ifndef FONT_H
+#define FONT_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "bytes.h"
+#include "tables.h"
+
+// cubic marks the off-curve points of a CFF curve, which come in pairs;
+// TrueType quadratic off-curve points leave it false.
+struct Point {
+  int x, y;
+  bool onCurve;
+  bool cubic = false;
+};
+
+struct CharMap;
+struct HorizontalMetrics;
+struct KernTable;
+struct FontVariations;
+struct CffFont;
+struct CoverageSet;
+struct FontHinting;
+
+// An atomic byte count that is copied along with the caches it counts
+struct CacheBytes {
+  std::atomic<size_t> bytes{0};
+  CacheBytes() {}
+  CacheBytes(const CacheBytes &other) : bytes(other.bytes.load()) {}
+  CacheBytes &operator=(const CacheBytes &other) {
+    bytes = other.bytes.load();
+    return *this;
+  }
+};
+
+// A font held in memory after validate_font has checked it. The parsed
+// tables are built on first use through font_char_map(),
+// font_horizontal_metrics(), font_kerning(), font_variations(),
+// font_coverage() and font_hinting(), and are dropped with the font. Once
+// validated the font itself is never changed, so any number of threads can
+// read it; the caches are filled through lazy_cache(), which counts what
+// each holds in cacheBytes. release_font_caches() drops them all to stay
+// inside the memory budget; a reader holding one keeps it alive.
+struct VerifiedFont {
+  std::vector<uint8_t> data;
+  TableDirectory tables;
+  uint16_t numGlyphs;
+  uint16_t unitsPerEm;
+  uint32_t glyfOffset;
+  bool shortLoca;
+  std::vector<uint32_t> loca;
+  std::shared_ptr<const CffFont> cff; // set instead of loca for CFF/CFF2 outlines
+
+  mutable std::shared_ptr<const CharMap> charMap;
+  mutable std::shared_ptr<const HorizontalMetrics> horizontalMetrics;
+  mutable std::shared_ptr<const KernTable> kerning;
+  mutable std::shared_ptr<const FontVariations> variations;
+  mutable std::shared_ptr<const CoverageSet> coverage;
+  mutable std::shared_ptr<const FontHinting> hinting;
+  mutable CacheBytes cacheBytes; // estimated, including CFF subroutine tokens
+};
+
+template <typename T> size_t vector_bytes(const std::vector<T> &v) {
+  return v.capacity() * sizeof(T);
+}
+
+// The cache in slot, built on first use. Threads that race to build it each
+// build one and all return the first that was stored, whose bytes(cache)
+// is added to font's cacheBytes. Hold the pointer for as long as the cache
+// is read.
+template <typename T, typename Build, typename Bytes>
+std::shared_ptr<const T> lazy_cache(const VerifiedFont &font, std::shared_ptr<const T> &slot,
+                                    Build build, Bytes bytes) {
+  std::shared_ptr<const T> cached = std::atomic_load(&slot);
+  if (!cached) {
+    std::shared_ptr<const T> built = std::make_shared<const T>(build());
+    if (std::atomic_compare_exchange_strong(&slot, &cached, built)) {
+      cached = built;
+      font.cacheBytes.bytes += sizeof(T) + bytes(*built);
+    }
+  }
+  return cached;
+}
+
+// Null for a table the font does not have
+inline const uint8_t *table_data(const VerifiedFont &font, TableId id) {
+  const TableRecord *record = find_table(font.tables, id);
+  return record ? font.data.data() + record->offset : nullptr;
+}
+
+// Empty for a table the font does not have
+inline TableBytes table_bytes(const VerifiedFont &font, TableId id) {
+  const TableRecord *record = find_table(font.tables, id);
+  if (!record)
+    return {nullptr, 0};
+  return {font.data.data() + record->offset, record->length};
+}
+
+#endif
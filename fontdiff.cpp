@@ -0,0 +1,216 @@
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "arena.h"
+#include "bytes.h"
+#include "cmap.h"
+#include "decode.h"
+#include "fontdiff.h"
+#include "parallel.h"
+#include "reorganize.h"
+
+using namespace std;
+
+static const uint32_t DIFF_CHUNK = 256; // glyphs per work item
+
+enum GlyphState : uint8_t {
+  GLYPH_SAME,
+  GLYPH_CHANGED,
+  GLYPH_REENCODED,
+};
+
+// Tables
+
+static void diff_tables(const VerifiedFont &a, const VerifiedFont &b, FontDiff &diff) {
+  for (const TableRecord &ra : a.tables.records) {
+    auto rb = find_if(b.tables.records.begin(), b.tables.records.end(),
+                      [&](const TableRecord &r) { return r.tag == ra.tag; });
+    if (rb == b.tables.records.end())
+      diff.tablesRemoved.push_back(tag_name(ra.tag));
+    else if (rb->checksum != ra.checksum || rb->length != ra.length)
+      diff.tablesChanged.push_back(tag_name(ra.tag));
+  }
+  for (const TableRecord &rb : b.tables.records) {
+    auto ra = find_if(a.tables.records.begin(), a.tables.records.end(),
+                      [&](const TableRecord &r) { return r.tag == rb.tag; });
+    if (ra == a.tables.records.end())
+      diff.tablesAdded.push_back(tag_name(rb.tag));
+  }
+}
+
+static bool table_changed(const FontDiff &diff, TableId id) {
+  const vector<string> &changed = diff.tablesChanged;
+  return find(changed.begin(), changed.end(), tag_name(TABLE_TAGS[id])) != changed.end();
+}
+
+// Glyphs
+
+static bool same_outline(const GlyphOutline &a, const GlyphOutline &b) {
+  if (a.numPoints != b.numPoints || a.numContours != b.numContours)
+    return false;
+  if (a.numContours && memcmp(a.contourEnds, b.contourEnds, a.numContours * sizeof(uint16_t)))
+    return false;
+  for (uint32_t i = 0; i < a.numPoints; ++i) {
+    const Point &p = a.points[i], &q = b.points[i];
+    if (p.x != q.x || p.y != q.y || p.onCurve != q.onCurve || p.cubic != q.cubic)
+      return false;
+  }
+  return true;
+}
+
+// Over the glyph's data only, so the headroom of the editing layout does
+// not make a glyph look re-encoded
+static uint64_t glyph_hash(const VerifiedFont &font, uint16_t glyph) {
+  uint32_t start = font.loca[glyph], end = font.loca[glyph + 1];
+  const uint8_t *g = font.data.data() + font.glyfOffset + start;
+  return content_hash(g, glyph_data_length(g, end - start));
+}
+
+// Composite component records reduced to what places the component:
+// glyph, offset or anchor points, the offset flags and a full 2x2 transform.
+// validate_font does not walk composites, so reads are bounds-checked.
+static bool composite_components(const VerifiedFont &font, uint16_t glyph,
+                                 vector<int32_t> &out) {
+  uint32_t start = font.loca[glyph], end = font.loca[glyph + 1];
+  if (end - start < 10)
+    return false;
+  TableBytes g = {font.data.data() + font.glyfOffset + start, end - start};
+  if ((int16_t)get_u16(g, 0) >= 0)
+    return false;
+
+  out.clear();
+  size_t o = 10;
+  uint16_t flags;
+  do {
+    flags = get_u16(g, o);
+    out.push_back(get_u16(g, o + 2));
+    o += 4;
+    if (flags & 0x0001) { // ARG_1_AND_2_ARE_WORDS
+      out.push_back((int16_t)get_u16(g, o));
+      out.push_back((int16_t)get_u16(g, o + 2));
+      o += 4;
+    } else {
+      bool xy = flags & 0x0002; // offsets are signed, anchor points are not
+      out.push_back(xy ? (int8_t)get_u8(g, o) : get_u8(g, o));
+      out.push_back(xy ? (int8_t)get_u8(g, o + 1) : get_u8(g, o + 1));
+      o += 2;
+    }
+    out.push_back(flags & 0x1802); // ARGS_ARE_XY_VALUES, SCALED/UNSCALED_COMPONENT_OFFSET
+    int32_t xx = 0x4000, xy = 0, yx = 0, yy = 0x4000;
+    if (flags & 0x0008) { // WE_HAVE_A_SCALE
+      xx = yy = (int16_t)get_u16(g, o);
+      o += 2;
+    } else if (flags & 0x0040) { // WE_HAVE_AN_X_AND_Y_SCALE
+      xx = (int16_t)get_u16(g, o);
+      yy = (int16_t)get_u16(g, o + 2);
+      o += 4;
+    } else if (flags & 0x0080) { // WE_HAVE_A_TWO_BY_TWO
+      xx = (int16_t)get_u16(g, o);
+      xy = (int16_t)get_u16(g, o + 2);
+      yx = (int16_t)get_u16(g, o + 4);
+      yy = (int16_t)get_u16(g, o + 6);
+      o += 8;
+    }
+    out.insert(out.end(), {xx, xy, yx, yy});
+  } while ((flags & 0x0020) && o < g.size); // MORE_COMPONENTS
+  return true;
+}
+
+static GlyphState compare_glyph(const VerifiedFont &a, const VerifiedFont &b,
+                                uint16_t glyph, Arena &arena) {
+  // decode_outline skips composites, so compare their component records
+  vector<int32_t> ca, cb;
+  bool compositeA = composite_components(a, glyph, ca);
+  bool compositeB = composite_components(b, glyph, cb);
+  if (compositeA || compositeB)
+    return compositeA && compositeB && ca == cb ? GLYPH_REENCODED : GLYPH_CHANGED;
+
+  arena_reset(arena);
+  GlyphOutline oa = decode_outline(a, glyph, arena);
+  GlyphOutline ob = decode_outline(b, glyph, arena);
+  return same_outline(oa, ob) ? GLYPH_REENCODED : GLYPH_CHANGED;
+}
+
+static void diff_glyphs(const VerifiedFont &a, const VerifiedFont &b, FontDiff &diff) {
+  uint32_t common = min(a.numGlyphs, b.numGlyphs);
+  for (uint32_t g = common; g < b.numGlyphs; ++g)
+    diff.added.push_back(g);
+  for (uint32_t g = common; g < a.numGlyphs; ++g)
+    diff.removed.push_back(g);
+
+  bool cff = a.cff || b.cff;
+  if (!cff && a.numGlyphs == b.numGlyphs && !table_changed(diff, TABLE_GLYF) &&
+      !table_changed(diff, TABLE_LOCA))
+    return;
+
+  vector<uint8_t> state(common, GLYPH_SAME);
+  parallel_for<Arena>(common, DIFF_CHUNK, [&](Arena &arena, size_t g) {
+    if (cff) {
+      // charstring bytes say little once subroutines differ, so decode
+      // every glyph
+      arena_reset(arena);
+      GlyphOutline oa = decode_outline(a, g, arena);
+      GlyphOutline ob = decode_outline(b, g, arena);
+      if (!same_outline(oa, ob))
+        state[g] = GLYPH_CHANGED;
+    } else if (glyph_hash(a, g) != glyph_hash(b, g)) {
+      state[g] = compare_glyph(a, b, g, arena);
+    }
+  });
+
+  for (uint32_t g = 0; g < common; ++g) {
+    if (state[g] == GLYPH_CHANGED)
+      diff.changed.push_back(g);
+    else if (state[g] == GLYPH_REENCODED)
+      diff.reencoded.push_back(g);
+  }
+}
+
+// Character Map
+
+static void diff_cmap(const VerifiedFont &a, const VerifiedFont &b, FontDiff &diff) {
+  if (!table_changed(diff, TABLE_CMAP))
+    return;
+  map<uint32_t, uint16_t> fa = char_map_forward(*font_char_map(a));
+  map<uint32_t, uint16_t> fb = char_map_forward(*font_char_map(b));
+  auto ia = fa.begin(), ib = fb.begin();
+  while (ia != fa.end() || ib != fb.end()) {
+    if (ib == fb.end() || (ia != fa.end() && ia->first < ib->first)) {
+      diff.cmap.push_back({ia->first, ia->second, 0});
+      ++ia;
+    } else if (ia == fa.end() || ib->first < ia->first) {
+      diff.cmap.push_back({ib->first, 0, ib->second});
+      ++ib;
+    } else {
+      if (ia->second != ib->second)
+        diff.cmap.push_back({ia->first, ia->second, ib->second});
+      ++ia;
+      ++ib;
+    }
+  }
+}
+
+FontDiff diff_fonts(const VerifiedFont &a, const VerifiedFont &b) {
+  FontDiff diff;
+  diff.status = {true, FONT_OK, "", -1, ""};
+  diff_tables(a, b, diff);
+  diff_glyphs(a, b, diff);
+  diff_cmap(a, b, diff);
+  return diff;
+}
+
+FontDiff diff_font_files(const string &a, const string &b) {
+  VerifiedFont fa, fb;
+  FontDiff diff;
+  diff.status = load_verified_font(a, fa);
+  if (!diff.status.ok)
+    return diff;
+  diff.status = load_verified_font(b, fb);
+  if (!diff.status.ok)
+    return diff;
+  return diff_fonts(fa, fb);
+}
@@ -0,0 +1,32 @@
+#ifndef FONTDIFF_H
+#define FONTDIFF_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "font.h"
+#include "validate.h"
+
+// A code point whose glyph differs; 0 means unmapped on that side
+struct CmapChange {
+  uint32_t codepoint;
+  uint16_t before, after;
+};
+
+struct FontDiff {
+  FontDiagnostic status; // first font that failed to load, if any
+  std::vector<std::string> tablesAdded, tablesRemoved, tablesChanged;
+  std::vector<uint16_t> changed;   // outlines differ
+  std::vector<uint16_t> reencoded; // glyph bytes differ, outline does not
+  std::vector<uint16_t> added;     // glyph ids only in b
+  std::vector<uint16_t> removed;   // glyph ids only in a
+  std::vector<CmapChange> cmap;    // ascending
+};
+
+// Compares table checksums, then glyph byte ranges (hashed in parallel),
+// and decodes only the glyphs whose bytes differ.
+FontDiff diff_fonts(const VerifiedFont &a, const VerifiedFont &b);
+FontDiff diff_font_files(const std::string &a, const std::string &b);
+
+#endif
@@ -0,0 +1,1441 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <memory>
+#include <vector>
+
+#include "bytes.h"
+#include "hinting.h"
+#include "metrics.h"
+
+using namespace std;
+
+static const uint32_t MAX_INSTRUCTIONS = 1000000; // per program, stops runaway loops
+static const int MAX_CALL_DEPTH = 64;
+static const size_t STACK_SLACK = 32; // fonts often understate maxStackElements
+
+enum : uint8_t {
+  POINT_ON_CURVE = 1,
+  POINT_TOUCHED_X = 2,
+  POINT_TOUCHED_Y = 4,
+};
+
+// ux, uy are font units (glyph zone only), ox, oy the scaled original
+// position and x, y the current one
+struct HintPoint {
+  int32_t ux, uy;
+  int32_t ox, oy;
+  int32_t x, y;
+  uint8_t flags;
+};
+
+struct HintZone {
+  vector<HintPoint> points;
+  vector<uint16_t> ends; // contour ends; the twilight zone has none
+};
+
+enum HintProgram { PROGRAM_FPGM, PROGRAM_PREP, PROGRAM_GLYPH };
+
+struct HintContext {
+  HintProgram program;
+  HintGraphicsState gs;
+  vector<int32_t> stack;
+  size_t maxStack;
+  vector<int32_t> cvt, storage;
+  vector<HintFunction> functions, instructions;
+  HintZone zones[2];
+  uint16_t ppem;
+  int64_t scale; // 16.16, font units to 26.6
+  uint32_t budget;
+  int depth;
+};
+
+// Fixed-Point Arithmetic
+
+// a * b / c rounded half away from zero
+static int64_t mul_div(int64_t a, int64_t b, int64_t c) {
+  if (c == 0)
+    return 0;
+  int64_t sign = 1;
+  if (a < 0) { a = -a; sign = -sign; }
+  if (b < 0) { b = -b; sign = -sign; }
+  if (c < 0) { c = -c; sign = -sign; }
+  return sign * ((a * b + c / 2) / c);
+}
+
+static int32_t mul_fix(int64_t a, int64_t b) { return (int32_t)mul_div(a, b, 0x10000); }
+
+static int32_t mul_14(int64_t a, int32_t b) { return (int32_t)mul_div(a, b, 0x4000); }
+
+static int32_t scale_units(const HintContext &c, int32_t v) { return mul_fix(v, c.scale); }
+
+// Rounds halves away from zero, like the rest of the fixed-point helpers
+static int32_t dot(int32_t dx, int32_t dy, HintVector v) {
+  int64_t d = (int64_t)dx * v.x + (int64_t)dy * v.y;
+  return (int32_t)((d + 0x2000 + (d >> 63)) >> 14);
+}
+
+// A 2.14 unit vector along (x, y), computed with the integer Newton
+// iteration FreeType uses so that diagonal vectors agree to the last bit
+static HintVector normalize(int32_t x, int32_t y, HintVector unchanged) {
+  if (x == 0 && y == 0)
+    return unchanged;
+  int sx = x < 0 ? -1 : 1, sy = y < 0 ? -1 : 1;
+  uint32_t ux = x < 0 ? -(uint32_t)x : x, uy = y < 0 ? -(uint32_t)y : y;
+  if (ux == 0)
+    return {0, sy * 0x4000};
+  if (uy == 0)
+    return {sx * 0x4000, 0};
+
+  // prenormalize so the estimated length is between 2/3 and 4/3
+  uint32_t l = ux > uy ? ux + (uy >> 1) : uy + (ux >> 1);
+  int shift = __builtin_clz(l);
+  shift -= 15 + (l >= (0xAAAAAAAAu >> shift));
+  if (shift > 0) {
+    ux <<= shift;
+    uy <<= shift;
+    l = ux > uy ? ux + (uy >> 1) : uy + (ux >> 1);
+  } else {
+    ux >>= -shift;
+    uy >>= -shift;
+    l >>= -shift;
+  }
+
+  int32_t b = 0x10000 - (int32_t)l;
+  int32_t x_ = ux, y_ = uy, z;
+  uint32_t u, v;
+  do {
+    u = (uint32_t)(x_ + ((int64_t)x_ * b >> 16));
+    v = (uint32_t)(y_ + ((int64_t)y_ * b >> 16));
+    z = -(int32_t)(u * u + v * v) / 0x200;
+    z = z * ((0x10000 + b) >> 8) / 0x10000;
+    b += z;
+  } while (z > 0);
+  return {sx * (int32_t)(u / 4), sy * (int32_t)(v / 4)};
+}
+
+// Rounding
+
+static int32_t round_value(const HintGraphicsState &gs, int32_t d) {
+  int32_t v;
+  switch (gs.roundState) {
+  case HINT_ROUND_HALF_GRID:
+    v = d >= 0 ? (d & ~63) + 32 : -((-d & ~63) + 32);
+    break;
+  case HINT_ROUND_GRID:
+    v = d >= 0 ? (d + 32) & ~63 : -((-d + 32) & ~63);
+    break;
+  case HINT_ROUND_DOUBLE_GRID:
+    v = d >= 0 ? (d + 16) & ~31 : -((-d + 16) & ~31);
+    break;
+  case HINT_ROUND_DOWN:
+    v = d >= 0 ? d & ~63 : -(-d & ~63);
+    break;
+  case HINT_ROUND_UP:
+    v = d >= 0 ? (d + 63) & ~63 : -((-d + 63) & ~63);
+    break;
+  case HINT_ROUND_SUPER:
+    if (d >= 0) {
+      v = ((d - gs.phase + gs.threshold) & -gs.period) + gs.phase;
+      if (v < 0)
+        v = gs.phase;
+    } else {
+      v = -((gs.threshold - gs.phase - d) & -gs.period) - gs.phase;
+      if (v > 0)
+        v = -gs.phase;
+    }
+    return v;
+  case HINT_ROUND_SUPER_45:
+    if (d >= 0) {
+      v = (d - gs.phase + gs.threshold) / gs.period * gs.period + gs.phase;
+      if (v < 0)
+        v = gs.phase;
+    } else {
+      v = -((gs.threshold - gs.phase - d) / gs.period * gs.period) - gs.phase;
+      if (v > 0)
+        v = -gs.phase;
+    }
+    return v;
+  default:
+    return d;
+  }
+  // rounding never flips the sign
+  if (d >= 0 && v < 0)
+    return 0;
+  if (d < 0 && v > 0)
+    return 0;
+  return v;
+}
+
+// gridPeriod is 1 pixel (SROUND) or 1 / sqrt(2) pixel (S45ROUND) in 2.14
+static void set_super_round(HintGraphicsState &gs, int32_t gridPeriod, int32_t selector) {
+  switch (selector & 0xC0) {
+  case 0x00: gs.period = gridPeriod / 2; break;
+  case 0x80: gs.period = gridPeriod * 2; break;
+  default: gs.period = gridPeriod; break;
+  }
+  switch (selector & 0x30) {
+  case 0x00: gs.phase = 0; break;
+  case 0x10: gs.phase = gs.period / 4; break;
+  case 0x20: gs.phase = gs.period / 2; break;
+  default: gs.phase = gs.period * 3 / 4; break;
+  }
+  if ((selector & 0x0F) == 0)
+    gs.threshold = gs.period - 1;
+  else
+    gs.threshold = ((selector & 0x0F) - 4) * gs.period / 8;
+  gs.period >>= 8;
+  gs.phase >>= 8;
+  gs.threshold >>= 8;
+  if (gs.period == 0)
+    gs.period = 1;
+}
+
+// Points
+
+static HintPoint *zone_point(HintContext &c, int zp, int32_t index) {
+  vector<HintPoint> &points = c.zones[c.gs.zp[zp]].points;
+  if (index < 0 || (size_t)index >= points.size())
+    return nullptr;
+  return &points[index];
+}
+
+static int32_t project(const HintContext &c, const HintPoint &a, const HintPoint &b) {
+  return dot(a.x - b.x, a.y - b.y, c.gs.projection);
+}
+
+static int32_t dual_project(const HintContext &c, const HintPoint &a, const HintPoint &b) {
+  return dot(a.ox - b.ox, a.oy - b.oy, c.gs.dual);
+}
+
+// Distance between original positions, measured in font units and scaled
+// where both points have them, as FreeType does for MD and MDRP
+static int32_t original_distance(const HintContext &c, bool twilight, const HintPoint &a,
+                                 const HintPoint &b) {
+  if (twilight)
+    return dual_project(c, a, b);
+  return scale_units(c, dot(a.ux - b.ux, a.uy - b.uy, c.gs.dual));
+}
+
+static int64_t freedom_dot_projection(const HintContext &c) {
+  int64_t fdotp = ((int64_t)c.gs.freedom.x * c.gs.projection.x +
+                   (int64_t)c.gs.freedom.y * c.gs.projection.y) >> 14;
+  // vectors close to perpendicular would move points without bound
+  return llabs(fdotp) < 0x400 ? 0x4000 : fdotp;
+}
+
+// Moves the point along the freedom vector until its projection changed by
+// distance
+static void move_point(const HintContext &c, HintPoint &p, int32_t distance, bool touch = true) {
+  int64_t fdotp = freedom_dot_projection(c);
+  if (c.gs.freedom.x != 0) {
+    p.x += (int32_t)mul_div(distance, c.gs.freedom.x, fdotp);
+    if (touch)
+      p.flags |= POINT_TOUCHED_X;
+  }
+  if (c.gs.freedom.y != 0) {
+    p.y += (int32_t)mul_div(distance, c.gs.freedom.y, fdotp);
+    if (touch)
+      p.flags |= POINT_TOUCHED_Y;
+  }
+}
+
+static void move_original(const HintContext &c, HintPoint &p, int32_t distance) {
+  int64_t fdotp = freedom_dot_projection(c);
+  p.ox += (int32_t)mul_div(distance, c.gs.freedom.x, fdotp);
+  p.oy += (int32_t)mul_div(distance, c.gs.freedom.y, fdotp);
+}
+
+// Interpolates points [first, last] of one axis between touched points
+// ref1 and ref2, or shifts them with the nearer one outside their span
+static void interpolate_run(vector<HintPoint> &points, bool xAxis, uint32_t first,
+                            uint32_t last, uint32_t ref1, uint32_t ref2) {
+  auto u = [&](const HintPoint &p) { return xAxis ? p.ux : p.uy; };
+  auto o = [&](const HintPoint &p) { return xAxis ? p.ox : p.oy; };
+  auto cur = [&](HintPoint &p) -> int32_t & { return xAxis ? p.x : p.y; };
+
+  if (u(points[ref1]) > u(points[ref2]))
+    swap(ref1, ref2);
+  int32_t u1 = u(points[ref1]), u2 = u(points[ref2]);
+  int32_t o1 = o(points[ref1]), o2 = o(points[ref2]);
+  int32_t c1 = cur(points[ref1]), c2 = cur(points[ref2]);
+  bool flat = c1 == c2 || u1 == u2;
+  int64_t scale = flat ? 0 : mul_div(c2 - c1, 0x10000, u2 - u1);
+  for (uint32_t i = first; i <= last; ++i) {
+    HintPoint &p = points[i];
+    int32_t x = o(p);
+    if (x <= o1)
+      x += c1 - o1;
+    else if (x >= o2)
+      x += c2 - o2;
+    else if (flat)
+      x = c1;
+    else
+      x = c1 + mul_fix(u(p) - u1, scale);
+    cur(p) = x;
+  }
+}
+
+// IUP over one contour [first, last]
+static void interpolate_contour(vector<HintPoint> &points, bool xAxis, uint32_t first,
+                                uint32_t last) {
+  uint8_t touched = xAxis ? POINT_TOUCHED_X : POINT_TOUCHED_Y;
+  uint32_t firstTouched = first;
+  while (firstTouched <= last && !(points[firstTouched].flags & touched))
+    firstTouched++;
+  if (firstTouched > last)
+    return;
+
+  uint32_t lastTouched = firstTouched;
+  for (uint32_t i = firstTouched + 1; i <= last; ++i) {
+    if (!(points[i].flags & touched))
+      continue;
+    if (i > lastTouched + 1)
+      interpolate_run(points, xAxis, lastTouched + 1, i - 1, lastTouched, i);
+    lastTouched = i;
+  }
+
+  if (lastTouched == firstTouched) {
+    // a single touched point shifts the whole contour
+    HintPoint &ref = points[firstTouched];
+    int32_t shift = xAxis ? ref.x - ref.ox : ref.y - ref.oy;
+    for (uint32_t i = first; i <= last; ++i) {
+      if (i == firstTouched)
+        continue;
+      if (xAxis)
+        points[i].x = points[i].ox + shift;
+      else
+        points[i].y = points[i].oy + shift;
+    }
+    return;
+  }
+  // the run that wraps around the contour's start
+  if (lastTouched < last)
+    interpolate_run(points, xAxis, lastTouched + 1, last, lastTouched, firstTouched);
+  if (firstTouched > first)
+    interpolate_run(points, xAxis, first, firstTouched - 1, lastTouched, firstTouched);
+}
+
+// Control Flow
+
+static uint32_t instruction_length(const uint8_t *code, uint32_t pc, uint32_t end) {
+  uint8_t op = code[pc];
+  if (op == 0x40)
+    return pc + 1 < end ? 2 + code[pc + 1] : 2;
+  if (op == 0x41)
+    return pc + 1 < end ? 2 + 2 * code[pc + 1] : 2;
+  if (op >= 0xB0 && op <= 0xB7)
+    return 1 + (op - 0xAF);
+  if (op >= 0xB8 && op <= 0xBF)
+    return 1 + 2 * (op - 0xB7);
+  return 1;
+}
+
+// Moves pc (just past an IF or ELSE) past the matching EIF, or past the
+// matching ELSE when stopAtElse
+static bool skip_branch(const uint8_t *code, uint32_t &pc, uint32_t end, bool stopAtElse) {
+  int nesting = 0;
+  while (pc < end) {
+    uint8_t op = code[pc];
+    pc += instruction_length(code, pc, end);
+    if (op == 0x58) {
+      nesting++;
+    } else if (op == 0x59) {
+      if (nesting == 0)
+        return pc <= end;
+      nesting--;
+    } else if (op == 0x1B && nesting == 0 && stopAtElse) {
+      return pc <= end;
+    }
+  }
+  return false;
+}
+
+// Records the body after FDEF or IDEF at pc and moves pc past its ENDF
+static bool define(const uint8_t *code, uint32_t &pc, uint32_t end, HintFunction &function) {
+  function.code = code;
+  function.start = pc;
+  while (pc < end) {
+    uint8_t op = code[pc];
+    if (op == 0x2C || op == 0x89)
+      return false; // definitions do not nest
+    if (op == 0x2D) {
+      function.end = pc++;
+      return true;
+    }
+    pc += instruction_length(code, pc, end);
+  }
+  return false;
+}
+
+// Interpreter
+
+static bool run(HintContext &c, const uint8_t *code, uint32_t start, uint32_t end);
+
+static bool call(HintContext &c, const HintFunction &function) {
+  if (!function.code || c.depth >= MAX_CALL_DEPTH)
+    return false;
+  c.depth++;
+  bool ok = run(c, function.code, function.start, function.end);
+  c.depth--;
+  return ok;
+}
+
+// SPVTL, SFVTL and SDPVTL: the line from zp2[b] to zp1[a], rotated a quarter
+// turn for the odd opcodes
+static bool line_vector(HintContext &c, int32_t a, int32_t b, bool perpendicular,
+                        bool original, HintVector &out) {
+  HintPoint *p1 = zone_point(c, 1, a), *p2 = zone_point(c, 2, b);
+  if (!p1 || !p2)
+    return false;
+  int32_t dx = original ? p1->ox - p2->ox : p1->x - p2->x;
+  int32_t dy = original ? p1->oy - p2->oy : p1->y - p2->y;
+  if (dx == 0 && dy == 0) {
+    dx = 0x4000;
+    perpendicular = false;
+  }
+  if (perpendicular) {
+    int32_t t = dy;
+    dy = dx;
+    dx = -t;
+  }
+  out = normalize(dx, dy, out);
+  return true;
+}
+
+// The DELTAP / DELTAC adjustment for arg, or 0 when it is for another ppem
+static int32_t delta_amount(const HintContext &c, uint8_t op, int32_t arg) {
+  int32_t ppem = ((arg & 0xF0) >> 4) + c.gs.deltaBase;
+  if (op == 0x71 || op == 0x74)
+    ppem += 16;
+  else if (op == 0x72 || op == 0x75)
+    ppem += 32;
+  if (ppem != c.ppem)
+    return 0;
+  int32_t steps = (arg & 0xF) - 8;
+  if (steps >= 0)
+    steps++;
+  return steps * (1 << (6 - c.gs.deltaShift));
+}
+
+static bool run(HintContext &c, const uint8_t *code, uint32_t start, uint32_t end) {
+  vector<int32_t> &stack = c.stack;
+  HintGraphicsState &gs = c.gs;
+  auto need = [&](size_t n) { return stack.size() >= n; };
+  auto pop = [&]() {
+    int32_t v = stack.back();
+    stack.pop_back();
+    return v;
+  };
+  auto push = [&](int32_t v) {
+    if (stack.size() >= c.maxStack)
+      return false;
+    stack.push_back(v);
+    return true;
+  };
+  // the loop counter applies to the next looping instruction only
+  auto take_loop = [&]() {
+    int32_t n = gs.loop;
+    gs.loop = 1;
+    return n;
+  };
+
+  uint32_t pc = start;
+  while (pc < end) {
+    if (c.budget == 0)
+      return false;
+    c.budget--;
+    uint32_t at = pc;
+    uint8_t op = code[pc];
+    uint32_t length = instruction_length(code, pc, end);
+    if (pc + length > end)
+      return false;
+    pc += length;
+
+    switch (op) {
+    // Vectors
+    case 0x00: case 0x01: case 0x02: case 0x03: case 0x04: case 0x05: {
+      HintVector axis = op & 1 ? HintVector{0x4000, 0} : HintVector{0, 0x4000};
+      if (op < 0x04) {
+        gs.projection = axis;
+        gs.dual = axis;
+      }
+      if (op < 0x02 || op >= 0x04)
+        gs.freedom = axis;
+      break;
+    }
+    case 0x06: case 0x07: case 0x08: case 0x09: {
+      if (!need(2))
+        return false;
+      int32_t b = pop(), a = pop();
+      HintVector v = op < 0x08 ? gs.projection : gs.freedom;
+      if (!line_vector(c, a, b, op & 1, false, v))
+        return false;
+      if (op < 0x08) {
+        gs.projection = v;
+        gs.dual = v;
+      } else {
+        gs.freedom = v;
+      }
+      break;
+    }
+    case 0x0A: case 0x0B: {
+      if (!need(2))
+        return false;
+      int32_t y = (int16_t)pop(), x = (int16_t)pop();
+      if (op == 0x0A) {
+        gs.projection = normalize(x, y, gs.projection);
+        gs.dual = gs.projection;
+      } else {
+        gs.freedom = normalize(x, y, gs.freedom);
+      }
+      break;
+    }
+    case 0x0C: case 0x0D: {
+      HintVector v = op == 0x0C ? gs.projection : gs.freedom;
+      if (!push(v.x) || !push(v.y))
+        return false;
+      break;
+    }
+    case 0x0E:
+      gs.freedom = gs.projection;
+      break;
+    case 0x0F: { // ISECT
+      if (!need(5))
+        return false;
+      int32_t b1 = pop(), b0 = pop(), a1 = pop(), a0 = pop(), target = pop();
+      HintPoint *pb1 = zone_point(c, 0, b1), *pb0 = zone_point(c, 0, b0);
+      HintPoint *pa1 = zone_point(c, 1, a1), *pa0 = zone_point(c, 1, a0);
+      HintPoint *p = zone_point(c, 2, target);
+      if (!pb1 || !pb0 || !pa1 || !pa0 || !p)
+        return false;
+      double dbx = pb1->x - pb0->x, dby = pb1->y - pb0->y;
+      double dax = pa1->x - pa0->x, day = pa1->y - pa0->y;
+      double dx = pb0->x - pa0->x, dy = pb0->y - pa0->y;
+      double discriminant = dax * -dby + day * dbx;
+      double dotProduct = dax * dbx + day * dby;
+      if (19 * fabs(discriminant) > fabs(dotProduct)) {
+        double t = (dx * -dby + dy * dbx) / discriminant;
+        p->x = pa0->x + (int32_t)lround(t * dax);
+        p->y = pa0->y + (int32_t)lround(t * day);
+      } else {
+        // parallel lines meet halfway between their middles
+        p->x = (pa0->x + pa1->x + pb0->x + pb1->x) / 4;
+        p->y = (pa0->y + pa1->y + pb0->y + pb1->y) / 4;
+      }
+      p->flags |= POINT_TOUCHED_X | POINT_TOUCHED_Y;
+      break;
+    }
+
+    // Graphics State
+    case 0x10: case 0x11: case 0x12:
+      if (!need(1))
+        return false;
+      gs.rp[op - 0x10] = pop();
+      break;
+    case 0x13: case 0x14: case 0x15: case 0x16: {
+      if (!need(1))
+        return false;
+      int32_t zone = pop();
+      if (zone != 0 && zone != 1)
+        return false;
+      if (op == 0x16)
+        gs.zp[0] = gs.zp[1] = gs.zp[2] = zone;
+      else
+        gs.zp[op - 0x13] = zone;
+      break;
+    }
+    case 0x17: {
+      if (!need(1))
+        return false;
+      int32_t n = pop();
+      if (n < 0)
+        return false;
+      gs.loop = min(n, 0xFFFF);
+      break;
+    }
+    case 0x18: gs.roundState = HINT_ROUND_GRID; break;
+    case 0x19: gs.roundState = HINT_ROUND_HALF_GRID; break;
+    case 0x3D: gs.roundState = HINT_ROUND_DOUBLE_GRID; break;
+    case 0x7A: gs.roundState = HINT_ROUND_OFF; break;
+    case 0x7C: gs.roundState = HINT_ROUND_UP; break;
+    case 0x7D: gs.roundState = HINT_ROUND_DOWN; break;
+    case 0x76: case 0x77:
+      if (!need(1))
+        return false;
+      set_super_round(gs, op == 0x76 ? 0x4000 : 0x2D41, pop());
+      gs.roundState = op == 0x76 ? HINT_ROUND_SUPER : HINT_ROUND_SUPER_45;
+      break;
+    case 0x1A:
+      if (!need(1))
+        return false;
+      gs.minimumDistance = pop();
+      break;
+    case 0x1D:
+      if (!need(1))
+        return false;
+      gs.controlValueCutIn = pop();
+      break;
+    case 0x1E:
+      if (!need(1))
+        return false;
+      gs.singleWidthCutIn = pop();
+      break;
+    case 0x1F:
+      if (!need(1))
+        return false;
+      gs.singleWidthValue = scale_units(c, pop());
+      break;
+    case 0x4D: gs.autoFlip = true; break;
+    case 0x4E: gs.autoFlip = false; break;
+    case 0x5E:
+      if (!need(1))
+        return false;
+      gs.deltaBase = pop();
+      break;
+    case 0x5F: {
+      if (!need(1))
+        return false;
+      int32_t shift = pop();
+      if (shift < 0 || shift > 6)
+        return false;
+      gs.deltaShift = shift;
+      break;
+    }
+    case 0x8E: { // INSTCTRL
+      if (!need(2))
+        return false;
+      int32_t selector = pop(), value = pop();
+      if (selector < 1 || selector > 3)
+        return false;
+      if (c.program == PROGRAM_PREP && selector < 3) {
+        uint8_t bit = 1 << (selector - 1);
+        gs.instructControl = value ? gs.instructControl | bit : gs.instructControl & ~bit;
+      }
+      break;
+    }
+    // scan conversion and anti-aliasing controls have no effect on outlines
+    case 0x4F: case 0x7E: case 0x7F: case 0x85: case 0x8D:
+      if (!need(1))
+        return false;
+      pop();
+      break;
+
+    // Stack
+    case 0x20:
+      if (!need(1) || !push(stack.back()))
+        return false;
+      break;
+    case 0x21:
+      if (!need(1))
+        return false;
+      pop();
+      break;
+    case 0x22:
+      stack.clear();
+      break;
+    case 0x23:
+      if (!need(2))
+        return false;
+      swap(stack[stack.size() - 1], stack[stack.size() - 2]);
+      break;
+    case 0x24:
+      if (!push((int32_t)stack.size()))
+        return false;
+      break;
+    case 0x25: case 0x26: {
+      if (!need(1))
+        return false;
+      int32_t k = pop();
+      if (k <= 0 || (size_t)k > stack.size())
+        return false;
+      int32_t v = stack[stack.size() - k];
+      if (op == 0x26)
+        stack.erase(stack.end() - k);
+      stack.push_back(v);
+      break;
+    }
+    case 0x8A:
+      if (!need(3))
+        return false;
+      rotate(stack.end() - 3, stack.end() - 2, stack.end());
+      break;
+    case 0x40: case 0x41: case 0xB0: case 0xB1: case 0xB2: case 0xB3: case 0xB4:
+    case 0xB5: case 0xB6: case 0xB7: case 0xB8: case 0xB9: case 0xBA: case 0xBB:
+    case 0xBC: case 0xBD: case 0xBE: case 0xBF: {
+      bool words = op == 0x41 || op >= 0xB8;
+      uint32_t p = op < 0xB0 ? at + 2 : at + 1;
+      for (; p < pc; p += words ? 2 : 1) {
+        if (!push(words ? (int16_t)be16(code + p) : code[p]))
+          return false;
+      }
+      break;
+    }
+
+    // Storage and CVT
+    case 0x42: {
+      if (!need(2))
+        return false;
+      int32_t value = pop(), index = pop();
+      if (index < 0 || (size_t)index >= c.storage.size())
+        return false;
+      c.storage[index] = value;
+      break;
+    }
+    case 0x43: {
+      if (!need(1))
+        return false;
+      int32_t index = pop();
+      if (index < 0 || (size_t)index >= c.storage.size())
+        return false;
+      push(c.storage[index]);
+      break;
+    }
+    case 0x44: case 0x70: {
+      if (!need(2))
+        return false;
+      int32_t value = pop(), index = pop();
+      if (index < 0 || (size_t)index >= c.cvt.size())
+        return false;
+      c.cvt[index] = op == 0x44 ? value : scale_units(c, value);
+      break;
+    }
+    case 0x45: {
+      if (!need(1))
+        return false;
+      int32_t index = pop();
+      if (index < 0 || (size_t)index >= c.cvt.size())
+        return false;
+      push(c.cvt[index]);
+      break;
+    }
+
+    // Measurement
+    case 0x46: case 0x47: {
+      if (!need(1))
+        return false;
+      HintPoint *p = zone_point(c, 2, pop());
+      if (!p)
+        return false;
+      HintPoint origin = {0, 0, 0, 0, 0, 0, 0};
+      push(op == 0x46 ? project(c, *p, origin) : dual_project(c, *p, origin));
+      break;
+    }
+    case 0x48: { // SCFS
+      if (!need(2))
+        return false;
+      int32_t value = pop();
+      HintPoint *p = zone_point(c, 2, pop());
+      if (!p)
+        return false;
+      HintPoint origin = {0, 0, 0, 0, 0, 0, 0};
+      move_point(c, *p, value - project(c, *p, origin));
+      if (gs.zp[2] == 0) {
+        p->ox = p->x;
+        p->oy = p->y;
+      }
+      break;
+    }
+    case 0x49: case 0x4A: { // MD
+      if (!need(2))
+        return false;
+      HintPoint *k = zone_point(c, 1, pop()), *l = zone_point(c, 0, pop());
+      if (!k || !l)
+        return false;
+      if (op == 0x49)
+        push(project(c, *l, *k));
+      else
+        push(original_distance(c, gs.zp[0] == 0 || gs.zp[1] == 0, *l, *k));
+      break;
+    }
+    case 0x4B: case 0x4C:
+      if (!push(c.ppem))
+        return false;
+      break;
+    case 0x88: { // GETINFO
+      if (!need(1))
+        return false;
+      int32_t selector = pop();
+      push(selector & 1 ? 35 : 0);
+      break;
+    }
+
+    // Arithmetic and Logic
+    case 0x50: case 0x51: case 0x52: case 0x53: case 0x54: case 0x55:
+    case 0x5A: case 0x5B: case 0x60: case 0x61: case 0x62: case 0x63:
+    case 0x8B: case 0x8C: {
+      if (!need(2))
+        return false;
+      int32_t b = pop(), a = pop(), r = 0;
+      switch (op) {
+      case 0x50: r = a < b; break;
+      case 0x51: r = a <= b; break;
+      case 0x52: r = a > b; break;
+      case 0x53: r = a >= b; break;
+      case 0x54: r = a == b; break;
+      case 0x55: r = a != b; break;
+      case 0x5A: r = a && b; break;
+      case 0x5B: r = a || b; break;
+      case 0x60: r = (int32_t)((int64_t)a + b); break;
+      case 0x61: r = (int32_t)((int64_t)a - b); break;
+      case 0x62:
+        if (b == 0)
+          return false;
+        r = (int32_t)((int64_t)a * 64 / b);
+        break;
+      case 0x63: r = (int32_t)mul_div(a, b, 64); break;
+      case 0x8B: r = max(a, b); break;
+      case 0x8C: r = min(a, b); break;
+      }
+      push(r);
+      break;
+    }
+    case 0x56: case 0x57: case 0x5C: case 0x64: case 0x65: case 0x66: case 0x67:
+    case 0x68: case 0x69: case 0x6A: case 0x6B: case 0x6C: case 0x6D: case 0x6E:
+    case 0x6F: {
+      if (!need(1))
+        return false;
+      int32_t &v = stack.back();
+      switch (op) {
+      case 0x56: v = (round_value(gs, v) & 127) == 64; break;
+      case 0x57: v = (round_value(gs, v) & 127) == 0; break;
+      case 0x5C: v = !v; break;
+      case 0x64: v = v < 0 ? -v : v; break;
+      case 0x65: v = -v; break;
+      case 0x66: v &= ~63; break;
+      case 0x67: v = (v + 63) & ~63; break;
+      default:
+        // ROUND; NROUND only compensates for engine characteristics, which
+        // are zero here
+        if (op < 0x6C)
+          v = round_value(gs, v);
+        break;
+      }
+      break;
+    }
+
+    // Control Flow
+    case 0x58: { // IF
+      if (!need(1))
+        return false;
+      if (!pop() && !skip_branch(code, pc, end, true))
+        return false;
+      break;
+    }
+    case 0x1B: // ELSE, reached at the end of a taken IF branch
+      if (!skip_branch(code, pc, end, false))
+        return false;
+      break;
+    case 0x59:
+      break;
+    case 0x1C: case 0x78: case 0x79: {
+      int32_t offset;
+      if (op == 0x1C) {
+        if (!need(1))
+          return false;
+        offset = pop();
+      } else {
+        if (!need(2))
+          return false;
+        int32_t condition = pop();
+        offset = pop();
+        if ((condition != 0) != (op == 0x78))
+          break;
+      }
+      int64_t target = (int64_t)at + offset;
+      if (offset == 0 || target < start || target > end)
+        return false;
+      pc = (uint32_t)target;
+      break;
+    }
+    case 0x2B: case 0x2A: { // CALL, LOOPCALL
+      if (!need(op == 0x2B ? 1 : 2))
+        return false;
+      int32_t index = pop();
+      int32_t count = op == 0x2B ? 1 : pop();
+      if (index < 0 || (size_t)index >= c.functions.size())
+        return false;
+      HintFunction function = c.functions[index];
+      for (int32_t i = 0; i < count; ++i) {
+        if (!call(c, function))
+          return false;
+      }
+      break;
+    }
+    case 0x2C: case 0x89: { // FDEF, IDEF
+      if (!need(1))
+        return false;
+      int32_t index = pop();
+      HintFunction function;
+      if (!define(code, pc, end, function))
+        return false;
+      vector<HintFunction> &table = op == 0x2C ? c.functions : c.instructions;
+      if (index < 0 || index >= (op == 0x2C ? 0x10000 : 0x100))
+        return false;
+      if ((size_t)index >= table.size())
+        table.resize(index + 1);
+      table[index] = function;
+      break;
+    }
+
+    // Outline Manipulation
+    case 0x29: { // UTP
+      if (!need(1))
+        return false;
+      HintPoint *p = zone_point(c, 0, pop());
+      if (!p)
+        return false;
+      if (gs.freedom.x != 0)
+        p->flags &= ~POINT_TOUCHED_X;
+      if (gs.freedom.y != 0)
+        p->flags &= ~POINT_TOUCHED_Y;
+      break;
+    }
+    case 0x80: case 0x81: case 0x82: { // FLIPPT, FLIPRGON, FLIPRGOFF
+      vector<HintPoint> &points = c.zones[1].points;
+      if (op == 0x80) {
+        for (int32_t n = take_loop(); n > 0; --n) {
+          if (!need(1))
+            return false;
+          int32_t i = pop();
+          if (i < 0 || (size_t)i >= points.size())
+            return false;
+          points[i].flags ^= POINT_ON_CURVE;
+        }
+        break;
+      }
+      if (!need(2))
+        return false;
+      int32_t hi = pop(), lo = pop();
+      if (lo < 0 || hi < lo || (size_t)hi >= points.size())
+        return false;
+      for (int32_t i = lo; i <= hi; ++i) {
+        if (op == 0x81)
+          points[i].flags |= POINT_ON_CURVE;
+        else
+          points[i].flags &= ~POINT_ON_CURVE;
+      }
+      break;
+    }
+    case 0x2E: case 0x2F: { // MDAP
+      if (!need(1))
+        return false;
+      int32_t i = pop();
+      HintPoint *p = zone_point(c, 0, i);
+      if (!p)
+        return false;
+      int32_t distance = 0;
+      if (op & 1) {
+        HintPoint origin = {0, 0, 0, 0, 0, 0, 0};
+        int32_t d = project(c, *p, origin);
+        distance = round_value(gs, d) - d;
+      }
+      move_point(c, *p, distance);
+      gs.rp[0] = gs.rp[1] = i;
+      break;
+    }
+    case 0x3E: case 0x3F: { // MIAP
+      if (!need(2))
+        return false;
+      int32_t index = pop(), i = pop();
+      HintPoint *p = zone_point(c, 0, i);
+      if (!p || index < 0 || (size_t)index >= c.cvt.size())
+        return false;
+      int32_t distance = c.cvt[index];
+      if (gs.zp[0] == 0) {
+        p->ox = mul_14(distance, gs.freedom.x);
+        p->oy = mul_14(distance, gs.freedom.y);
+        p->x = p->ox;
+        p->y = p->oy;
+      }
+      HintPoint origin = {0, 0, 0, 0, 0, 0, 0};
+      int32_t current = project(c, *p, origin);
+      if (op & 1) {
+        if (abs(distance - current) > gs.controlValueCutIn)
+          distance = current;
+        distance = round_value(gs, distance);
+      }
+      move_point(c, *p, distance - current);
+      gs.rp[0] = gs.rp[1] = i;
+      break;
+    }
+    case 0x30: case 0x31: { // IUP
+      HintZone &zone = c.zones[1];
+      uint32_t first = 0;
+      for (uint16_t last : zone.ends) {
+        if (last >= zone.points.size())
+          return false;
+        if (last >= first)
+          interpolate_contour(zone.points, op == 0x31, first, last);
+        first = last + 1;
+      }
+      break;
+    }
+    case 0x32: case 0x33: case 0x34: case 0x35: case 0x36: case 0x37: { // SHP, SHC, SHZ
+      int zp = op & 1 ? 0 : 1;
+      int32_t refIndex = op & 1 ? gs.rp[1] : gs.rp[2];
+      HintPoint *ref = zone_point(c, zp, refIndex);
+      if (!ref)
+        return false;
+      int32_t d = dot(ref->x - ref->ox, ref->y - ref->oy, gs.projection);
+      HintZone &zone = c.zones[gs.zp[2]];
+      bool sameZone = gs.zp[zp] == gs.zp[2];
+      if (op < 0x34) {
+        for (int32_t n = take_loop(); n > 0; --n) {
+          if (!need(1))
+            return false;
+          HintPoint *p = zone_point(c, 2, pop());
+          if (!p)
+            return false;
+          move_point(c, *p, d);
+        }
+        break;
+      }
+      if (!need(1))
+        return false;
+      int32_t arg = pop();
+      uint32_t first, limit;
+      if (op < 0x36) {
+        if (arg < 0 || (size_t)arg >= zone.ends.size())
+          return false;
+        first = arg == 0 ? 0 : zone.ends[arg - 1] + 1;
+        limit = zone.ends[arg] + 1;
+      } else {
+        if (arg != 0 && arg != 1)
+          return false;
+        // the phantom points stay where they are
+        first = 0;
+        limit = gs.zp[2] == 0 ? zone.points.size()
+                              : zone.ends.empty() ? 0 : zone.ends.back() + 1;
+      }
+      if (limit > zone.points.size())
+        return false;
+      for (uint32_t i = first; i < limit; ++i) {
+        if (sameZone && (int32_t)i == refIndex)
+          continue;
+        move_point(c, zone.points[i], d, op < 0x36);
+      }
+      break;
+    }
+    case 0x38: { // SHPIX
+      if (!need(1))
+        return false;
+      int32_t d = pop();
+      for (int32_t n = take_loop(); n > 0; --n) {
+        if (!need(1))
+          return false;
+        HintPoint *p = zone_point(c, 2, pop());
+        if (!p)
+          return false;
+        if (gs.freedom.x != 0) {
+          p->x += mul_14(d, gs.freedom.x);
+          p->flags |= POINT_TOUCHED_X;
+        }
+        if (gs.freedom.y != 0) {
+          p->y += mul_14(d, gs.freedom.y);
+          p->flags |= POINT_TOUCHED_Y;
+        }
+      }
+      break;
+    }
+    case 0x39: { // IP
+      HintPoint *rp1 = zone_point(c, 0, gs.rp[1]), *rp2 = zone_point(c, 1, gs.rp[2]);
+      if (!rp1 || !rp2)
+        return false;
+      // original distances stay in font units outside the twilight zone;
+      // only their ratio matters
+      bool twilight = gs.zp[0] == 0 || gs.zp[1] == 0 || gs.zp[2] == 0;
+      auto original = [&](const HintPoint &p) {
+        return twilight ? dual_project(c, p, *rp1)
+                        : dot(p.ux - rp1->ux, p.uy - rp1->uy, gs.dual);
+      };
+      int32_t originalRange = original(*rp2);
+      int32_t currentRange = project(c, *rp2, *rp1);
+      for (int32_t n = take_loop(); n > 0; --n) {
+        if (!need(1))
+          return false;
+        HintPoint *p = zone_point(c, 2, pop());
+        if (!p)
+          return false;
+        int32_t originalDistance = original(*p);
+        int32_t currentDistance = project(c, *p, *rp1);
+        int32_t distance = 0;
+        if (originalDistance != 0) {
+          distance = originalRange != 0
+                         ? (int32_t)mul_div(originalDistance, currentRange, originalRange)
+                         : originalDistance;
+        }
+        move_point(c, *p, distance - currentDistance);
+      }
+      break;
+    }
+    case 0x3A: case 0x3B: { // MSIRP
+      if (!need(2))
+        return false;
+      int32_t distance = pop(), i = pop();
+      HintPoint *p = zone_point(c, 1, i), *rp0 = zone_point(c, 0, gs.rp[0]);
+      if (!p || !rp0)
+        return false;
+      if (gs.zp[1] == 0) {
+        p->ox = rp0->ox;
+        p->oy = rp0->oy;
+        move_original(c, *p, distance);
+        p->x = p->ox;
+        p->y = p->oy;
+      }
+      move_point(c, *p, distance - project(c, *p, *rp0));
+      gs.rp[1] = gs.rp[0];
+      gs.rp[2] = i;
+      if (op & 1)
+        gs.rp[0] = i;
+      break;
+    }
+    case 0x3C: { // ALIGNRP
+      HintPoint *rp0 = zone_point(c, 0, gs.rp[0]);
+      if (!rp0)
+        return false;
+      for (int32_t n = take_loop(); n > 0; --n) {
+        if (!need(1))
+          return false;
+        HintPoint *p = zone_point(c, 1, pop());
+        if (!p)
+          return false;
+        move_point(c, *p, -project(c, *p, *rp0));
+      }
+      break;
+    }
+    case 0x27: { // ALIGNPTS
+      if (!need(2))
+        return false;
+      HintPoint *p2 = zone_point(c, 0, pop()), *p1 = zone_point(c, 1, pop());
+      if (!p1 || !p2)
+        return false;
+      int32_t distance = project(c, *p2, *p1) / 2;
+      move_point(c, *p1, distance);
+      move_point(c, *p2, -distance);
+      break;
+    }
+    case 0x86: case 0x87: { // SDPVTL
+      if (!need(2))
+        return false;
+      int32_t b = pop(), a = pop();
+      if (!line_vector(c, a, b, op & 1, true, gs.dual) ||
+          !line_vector(c, a, b, op & 1, false, gs.projection))
+        return false;
+      break;
+    }
+    case 0x5D: case 0x71: case 0x72: case 0x73: case 0x74: case 0x75: { // DELTAP, DELTAC
+      if (!need(1))
+        return false;
+      int32_t count = pop();
+      for (int32_t k = 0; k < count; ++k) {
+        if (!need(2))
+          return false;
+        int32_t target = pop(), delta = delta_amount(c, op, pop());
+        if (delta == 0)
+          continue;
+        // entries for points or cvt values that do not exist are skipped
+        if (op == 0x5D || op == 0x71 || op == 0x72) {
+          if (HintPoint *p = zone_point(c, 0, target))
+            move_point(c, *p, delta);
+        } else if (target >= 0 && (size_t)target < c.cvt.size()) {
+          c.cvt[target] += delta;
+        }
+      }
+      break;
+    }
+
+    default:
+      if (op >= 0xC0) { // MDRP, MIRP
+        bool indirect = op >= 0xE0;
+        int32_t index = 0;
+        if (!need(indirect ? 2 : 1))
+          return false;
+        if (indirect)
+          index = pop();
+        int32_t i = pop();
+        HintPoint *p = zone_point(c, 1, i), *rp0 = zone_point(c, 0, gs.rp[0]);
+        if (!p || !rp0)
+          return false;
+        bool twilight = gs.zp[0] == 0 || gs.zp[1] == 0;
+        int32_t originalDistance, distance;
+        if (indirect) {
+          if (index + 1 != 0 && (index < 0 || (size_t)index >= c.cvt.size()))
+            return false;
+          int32_t cvtDistance = index + 1 == 0 ? 0 : c.cvt[index];
+          if (abs(cvtDistance - gs.singleWidthValue) < gs.singleWidthCutIn)
+            cvtDistance = cvtDistance >= 0 ? gs.singleWidthValue : -gs.singleWidthValue;
+          if (gs.zp[1] == 0) {
+            p->ox = rp0->ox + mul_14(cvtDistance, gs.freedom.x);
+            p->oy = rp0->oy + mul_14(cvtDistance, gs.freedom.y);
+            p->x = p->ox;
+            p->y = p->oy;
+          }
+          originalDistance = dual_project(c, *p, *rp0);
+          if (gs.autoFlip && (originalDistance ^ cvtDistance) < 0)
+            cvtDistance = -cvtDistance;
+          if (op & 4) {
+            if (gs.zp[0] == gs.zp[1] &&
+                abs(cvtDistance - originalDistance) > gs.controlValueCutIn)
+              cvtDistance = originalDistance;
+            distance = round_value(gs, cvtDistance);
+          } else {
+            distance = cvtDistance;
+          }
+        } else {
+          originalDistance = original_distance(c, twilight, *p, *rp0);
+          if (gs.singleWidthCutIn > 0 &&
+              originalDistance < gs.singleWidthValue + gs.singleWidthCutIn &&
+              originalDistance > gs.singleWidthValue - gs.singleWidthCutIn)
+            originalDistance =
+                originalDistance >= 0 ? gs.singleWidthValue : -gs.singleWidthValue;
+          distance = op & 4 ? round_value(gs, originalDistance) : originalDistance;
+        }
+        if (op & 8) {
+          if (originalDistance >= 0)
+            distance = max(distance, gs.minimumDistance);
+          else
+            distance = min(distance, -gs.minimumDistance);
+        }
+        move_point(c, *p, distance - project(c, *p, *rp0));
+        gs.rp[1] = gs.rp[0];
+        gs.rp[2] = i;
+        if (op & 16)
+          gs.rp[0] = i;
+        break;
+      }
+      // anything else must have been given a meaning by IDEF
+      if (op >= c.instructions.size() || !call(c, c.instructions[op]))
+        return false;
+      break;
+    }
+  }
+  return true;
+}
+
+// Programs
+
+static void reset_context(HintContext &c, HintProgram program, uint16_t ppem,
+                          const VerifiedFont &font, const FontHinting &hinting) {
+  c.program = program;
+  c.gs = HintGraphicsState();
+  c.stack.clear();
+  c.maxStack = hinting.maxStackElements + STACK_SLACK;
+  c.stack.reserve(c.maxStack);
+  c.ppem = ppem;
+  c.scale = font.unitsPerEm ? mul_div(ppem * 64, 0x10000, font.unitsPerEm) : 0;
+  c.budget = MAX_INSTRUCTIONS;
+  c.depth = 0;
+  c.zones[0].points.assign(hinting.maxTwilightPoints, HintPoint{0, 0, 0, 0, 0, 0, 0});
+  c.zones[0].ends.clear();
+  c.zones[1].points.clear();
+  c.zones[1].ends.clear();
+}
+
+static FontHinting build_hinting(const VerifiedFont &font) {
+  FontHinting hinting;
+  if (font.cff)
+    return hinting;
+
+  TableBytes maxp = table_bytes(font, TABLE_MAXP);
+  uint16_t maxStorage = get_u16(maxp, 18);
+  uint16_t maxFunctionDefs = get_u16(maxp, 20);
+  hinting.maxTwilightPoints = get_u16(maxp, 16);
+  hinting.maxStackElements = get_u16(maxp, 24);
+  hinting.storage.assign(maxStorage, 0);
+  hinting.functions.resize(maxFunctionDefs);
+
+  TableBytes cvt = table_bytes(font, TABLE_CVT);
+  hinting.cvt.resize(cvt.size / 2);
+  decode_be16(cvt.data, hinting.cvt.size(), hinting.cvt.data());
+
+  HintContext c;
+  reset_context(c, PROGRAM_FPGM, 0, font, hinting);
+  c.storage = hinting.storage;
+  c.functions = hinting.functions;
+  TableBytes fpgm = table_bytes(font, TABLE_FPGM);
+  if (fpgm.size > 0 && !run(c, fpgm.data, 0, fpgm.size))
+    return hinting;
+  hinting.storage = move(c.storage);
+  hinting.functions = move(c.functions);
+  hinting.instructions = move(c.instructions);
+  hinting.ok = true;
+  return hinting;
+}
+
+shared_ptr<const FontHinting> font_hinting(const VerifiedFont &font) {
+  return lazy_cache(font, font.hinting, [&] { return build_hinting(font); },
+                    [](const FontHinting &hinting) {
+                      return vector_bytes(hinting.cvt) + vector_bytes(hinting.storage) +
+                             vector_bytes(hinting.functions) + vector_bytes(hinting.instructions);
+                    });
+}
+
+static HintSizeState build_size_state(const VerifiedFont &font, const FontHinting &hinting,
+                                      uint16_t ppem) {
+  HintSizeState size;
+  size.ppem = ppem;
+  if (!hinting.ok)
+    return size;
+  HintContext c;
+  reset_context(c, PROGRAM_PREP, ppem, font, hinting);
+  c.storage = hinting.storage;
+  c.functions = hinting.functions;
+  c.instructions = hinting.instructions;
+  // FreeType keeps the cvt in 26.6 and scales it with the scale's low six
+  // bits dropped; doing the same keeps cvt-driven stems on the same pixels
+  // when the em is not a power of two
+  c.cvt.resize(hinting.cvt.size());
+  for (size_t i = 0; i < hinting.cvt.size(); ++i)
+    c.cvt[i] = mul_fix(hinting.cvt[i] * 64, c.scale >> 6);
+
+  TableBytes prep = table_bytes(font, TABLE_PREP);
+  if (prep.size > 0 && !run(c, prep.data, 0, prep.size))
+    return size;
+  size.gs = c.gs;
+  if (c.gs.instructControl & 2) {
+    // the glyphs start from the default state, still honoring the flags
+    size.gs = HintGraphicsState();
+    size.gs.instructControl = c.gs.instructControl;
+  }
+  size.cvt = move(c.cvt);
+  size.storage = move(c.storage);
+  size.functions = move(c.functions);
+  size.instructions = move(c.instructions);
+  size.ok = true;
+  return size;
+}
+
+static size_t hint_size_bytes(const HintSizeState &size) {
+  return sizeof(size) + vector_bytes(size.cvt) + vector_bytes(size.storage) +
+         vector_bytes(size.functions) + vector_bytes(size.instructions);
+}
+
+shared_ptr<const HintSizeState> hint_size_state(const VerifiedFont &font, uint16_t ppem) {
+  shared_ptr<const FontHinting> hintingCache = font_hinting(font);
+  const FontHinting &hinting = *hintingCache;
+  HintSizeCache &cache = *hinting.sizes;
+  uint64_t now = ++cache.clock;
+  for (HintSizeSlot &slot : cache.slots) {
+    shared_ptr<const HintSizeState> size = atomic_load(&slot.state);
+    if (size && size->ppem == ppem) {
+      slot.lastUse = now;
+      return size;
+    }
+  }
+
+  auto size = make_shared<const HintSizeState>(build_size_state(font, hinting, ppem));
+  HintSizeSlot *oldest = &cache.slots[0];
+  for (HintSizeSlot &slot : cache.slots) {
+    if (slot.lastUse < oldest->lastUse)
+      oldest = &slot;
+  }
+  // a thread that replaced the same slot first keeps it, and this size is
+  // only returned
+  shared_ptr<const HintSizeState> replaced = atomic_load(&oldest->state);
+  if (atomic_compare_exchange_strong(&oldest->state, &replaced, size)) {
+    oldest->lastUse = now;
+    font.cacheBytes.bytes += hint_size_bytes(*size);
+    if (replaced)
+      font.cacheBytes.bytes -= hint_size_bytes(*replaced);
+  }
+  return size;
+}
+
+// Glyphs
+
+static int32_t round_pixel(int32_t v) { return (v + 32) & ~63; }
+
+// One context per thread, so hinting a font allocates only while the
+// vectors grow to its largest glyph
+static thread_local HintContext glyphContext;
+
+HintedGlyph hint_glyph(const VerifiedFont &font, uint16_t glyph, uint16_t ppem, Arena &arena) {
+  HintedGlyph result = {{nullptr, nullptr, 0, 0}, 0, false};
+  if (glyph >= font.numGlyphs)
+    return result;
+  shared_ptr<const FontHinting> hintingCache = font_hinting(font);
+  const FontHinting &hinting = *hintingCache;
+  HintContext &c = glyphContext;
+  reset_context(c, PROGRAM_GLYPH, ppem, font, hinting);
+
+  shared_ptr<const HorizontalMetrics> metricsCache = font_horizontal_metrics(font);
+  const HorizontalMetrics &metrics = *metricsCache;
+  GlyphMetrics gm = glyph_metrics(metrics, glyph);
+  GlyphOutline outline = decode_outline(font, glyph, arena);
+
+  // instructions follow the contour ends in a simple glyph
+  const uint8_t *code = nullptr;
+  uint16_t codeLength = 0;
+  int16_t xMin = 0;
+  if (!font.cff && font.loca[glyph] != font.loca[glyph + 1]) {
+    const uint8_t *g = &font.data[font.glyfOffset + font.loca[glyph]];
+    xMin = (int16_t)be16(g + 2);
+    int16_t numContours = (int16_t)be16(g);
+    if (numContours > 0) {
+      code = g + 12 + 2 * numContours;
+      codeLength = be16(code - 2);
+    }
+  } else if (font.cff && outline.numPoints > 0) {
+    xMin = outline.points[0].x;
+    for (uint32_t i = 1; i < outline.numPoints; ++i)
+      xMin = min<int32_t>(xMin, outline.points[i].x);
+  }
+
+  // the glyph zone: outline points, then the four phantom points
+  HintZone &zone = c.zones[1];
+  zone.points.resize(outline.numPoints + 4);
+  zone.ends.assign(outline.contourEnds, outline.contourEnds + outline.numContours);
+  HintPoint *phantom = &zone.points[outline.numPoints];
+  int32_t pp1 = xMin - gm.lsb;
+  auto load_points = [&]() {
+    for (uint32_t i = 0; i < outline.numPoints; ++i) {
+      const Point &p = outline.points[i];
+      zone.points[i] = {p.x, p.y, 0, 0, 0, 0, (uint8_t)(p.onCurve ? POINT_ON_CURVE : 0)};
+    }
+    phantom[0] = {pp1, 0, 0, 0, 0, 0, 0};
+    phantom[1] = {pp1 + gm.advance, 0, 0, 0, 0, 0, 0};
+    phantom[2] = {0, metrics.font.ascender, 0, 0, 0, 0, 0};
+    phantom[3] = {0, metrics.font.descender, 0, 0, 0, 0, 0};
+    for (HintPoint &p : zone.points) {
+      p.ox = p.x = scale_units(c, p.ux);
+      p.oy = p.y = scale_units(c, p.uy);
+    }
+    phantom[0].x = round_pixel(phantom[0].x);
+    phantom[1].x = round_pixel(phantom[1].x);
+    phantom[2].y = round_pixel(phantom[2].y);
+    phantom[3].y = round_pixel(phantom[3].y);
+  };
+  load_points();
+
+  shared_ptr<const HintSizeState> sizeCache = hint_size_state(font, ppem);
+  const HintSizeState &size = *sizeCache;
+  if (codeLength > 0 && size.ok && !(size.gs.instructControl & 1)) {
+    c.gs = size.gs;
+    c.gs.projection = c.gs.freedom = c.gs.dual = {0x4000, 0};
+    c.gs.zp[0] = c.gs.zp[1] = c.gs.zp[2] = 1;
+    c.gs.rp[0] = c.gs.rp[1] = c.gs.rp[2] = 0;
+    c.gs.roundState = HINT_ROUND_GRID;
+    c.gs.loop = 1;
+    c.cvt.assign(size.cvt.begin(), size.cvt.end());
+    c.storage.assign(size.storage.begin(), size.storage.end());
+    c.functions.assign(size.functions.begin(), size.functions.end());
+    c.instructions.assign(size.instructions.begin(), size.instructions.end());
+    result.hinted = run(c, code, 0, codeLength);
+    if (!result.hinted)
+      load_points(); // back to the scaled outline
+  }
+
+  // shift so the hinted left side bearing point is the origin
+  result.outline = outline;
+  if (outline.numPoints > 0)
+    result.outline.points = arena_array<Point>(arena, outline.numPoints);
+  for (uint32_t i = 0; i < outline.numPoints; ++i) {
+    const HintPoint &p = zone.points[i];
+    result.outline.points[i] = {p.x - phantom[0].x, p.y, (p.flags & POINT_ON_CURVE) != 0,
+                                outline.points[i].cubic};
+  }
+  result.advance = round_pixel(phantom[1].x - phantom[0].x);
+  return result;
+}
@@ -0,0 +1,114 @@
+#ifndef HINTING_H
+#define HINTING_H
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "arena.h"
+#include "decode.h"
+#include "font.h"
+
+// TrueType bytecode hinting, interpreted the way FreeType's v35 engine does
+// (full grid fitting in both directions). fpgm runs once per font and prep
+// once per ppem; every glyph program then starts from a copy of the state
+// prep left behind, so hinting a glyph costs only its own instructions.
+
+enum HintRound : uint8_t {
+  HINT_ROUND_HALF_GRID,
+  HINT_ROUND_GRID,
+  HINT_ROUND_DOUBLE_GRID,
+  HINT_ROUND_DOWN,
+  HINT_ROUND_UP,
+  HINT_ROUND_OFF,
+  HINT_ROUND_SUPER,
+  HINT_ROUND_SUPER_45,
+};
+
+struct HintVector {
+  int32_t x, y; // 2.14
+};
+
+// Distances are 26.6 pixels (64 per pixel)
+struct HintGraphicsState {
+  HintVector projection = {0x4000, 0};
+  HintVector freedom = {0x4000, 0};
+  HintVector dual = {0x4000, 0};
+  int32_t rp[3] = {0, 0, 0};
+  int32_t zp[3] = {1, 1, 1}; // 0 is the twilight zone, 1 the glyph
+  int32_t loop = 1;
+  int32_t minimumDistance = 64;
+  int32_t controlValueCutIn = 68;
+  int32_t singleWidthCutIn = 0;
+  int32_t singleWidthValue = 0;
+  int32_t deltaBase = 9;
+  int32_t deltaShift = 3;
+  bool autoFlip = true;
+  uint8_t instructControl = 0;
+  uint8_t roundState = HINT_ROUND_GRID;
+  int32_t period = 64, phase = 0, threshold = 32; // SROUND / S45ROUND
+};
+
+// A FDEF or IDEF body: code[start, end) of fpgm or prep, which stay in the
+// font buffer
+struct HintFunction {
+  const uint8_t *code = nullptr;
+  uint32_t start = 0, end = 0;
+};
+
+// What prep leaves behind at one ppem. ok is false when prep failed, and
+// glyphs are then left unhinted at that size.
+struct HintSizeState {
+  bool ok = false;
+  uint16_t ppem = 0;
+  HintGraphicsState gs;
+  std::vector<int32_t> cvt; // 26.6
+  std::vector<int32_t> storage;
+  std::vector<HintFunction> functions, instructions; // instructions by opcode
+};
+
+// The last few ppems prep ran at. A new ppem replaces the least recently
+// used slot; the slot's state is loaded and stored atomically, so a reader
+// keeps the state it loaded even once it is replaced.
+static const int HINT_SIZE_SLOTS = 8;
+
+struct HintSizeSlot {
+  std::shared_ptr<const HintSizeState> state;
+  std::atomic<uint64_t> lastUse{0};
+};
+
+struct HintSizeCache {
+  HintSizeSlot slots[HINT_SIZE_SLOTS];
+  std::atomic<uint64_t> clock{0};
+};
+
+// fpgm's result. ok is false for CFF outlines and when fpgm failed.
+struct FontHinting {
+  bool ok = false;
+  uint16_t maxTwilightPoints = 0;
+  uint16_t maxStackElements = 0;
+  std::vector<int16_t> cvt; // font units
+  std::vector<int32_t> storage;
+  std::vector<HintFunction> functions, instructions;
+  std::shared_ptr<HintSizeCache> sizes = std::make_shared<HintSizeCache>();
+};
+
+// A glyph grid-fitted at ppem, in 26.6 pixels with the hinted left side
+// bearing point at x = 0. hinted is false when the glyph had no program or
+// its program failed; the outline is then only scaled. Points live in the
+// arena.
+struct HintedGlyph {
+  GlyphOutline outline;
+  int32_t advance;
+  bool hinted;
+};
+
+std::shared_ptr<const FontHinting> font_hinting(const VerifiedFont &font);
+std::shared_ptr<const HintSizeState> hint_size_state(const VerifiedFont &font, uint16_t ppem);
+
+// Simple glyphs only, like decode_outline; composites come back empty and
+// CFF glyphs scaled but unhinted
+HintedGlyph hint_glyph(const VerifiedFont &font, uint16_t glyph, uint16_t ppem, Arena &arena);
+
+#endif
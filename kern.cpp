@@ -0,0 +1,309 @@
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "bytes.h"
+#include "kern.h"
+
+using namespace std;
+
+static const uint64_t EMPTY_KEY = UINT64_MAX;
+static const uint32_t NO_SUBTABLE = UINT32_MAX;
+
+static inline uint32_t pair_slot(uint64_t key, uint32_t mask) {
+  return (key * 0x9E3779B97F4A7C15ull >> 32) & mask;
+}
+
+static inline uint64_t pair_key(uint32_t lookup, uint16_t left, uint16_t right) {
+  return (uint64_t)lookup << 32 | (uint32_t)left << 16 | right;
+}
+
+// Pair Hash
+
+struct PairList {
+  vector<uint64_t> keys;
+  vector<int16_t> values;
+  vector<uint16_t> subtables;
+
+  void add(uint64_t key, int16_t value, uint16_t subtable) {
+    keys.push_back(key);
+    values.push_back(value);
+    subtables.push_back(subtable);
+  }
+};
+
+// Pairs are listed in subtable order and the first subtable of a lookup
+// takes precedence, so later duplicates are dropped on build
+static void build_pair_hash(const PairList &pairs, KernTable &kern) {
+  uint32_t capacity = 16;
+  while (capacity < pairs.keys.size() * 2)
+    capacity <<= 1;
+  kern.mask = capacity - 1;
+  kern.keys.assign(capacity, EMPTY_KEY);
+  kern.values.assign(capacity, 0);
+  kern.subtables.assign(capacity, 0);
+
+  for (size_t i = 0; i < pairs.keys.size(); ++i) {
+    uint32_t slot = pair_slot(pairs.keys[i], kern.mask);
+    while (kern.keys[slot] != EMPTY_KEY && kern.keys[slot] != pairs.keys[i])
+      slot = (slot + 1) & kern.mask;
+    if (kern.keys[slot] == EMPTY_KEY) {
+      kern.keys[slot] = pairs.keys[i];
+      kern.values[slot] = pairs.values[i];
+      kern.subtables[slot] = pairs.subtables[i];
+    }
+  }
+}
+
+// kern Table
+
+// Read as a single lookup whose subtables are the kern subtables
+static void read_kern_table(const TableBytes &data, PairList &pairs) {
+  if (get_u16(data, 0) != 0)
+    return; // only the Microsoft version 0 layout
+
+  uint16_t nTables = get_u16(data, 2);
+  size_t offset = 4;
+  for (int t = 0; t < nTables; ++t) {
+    uint16_t length = get_u16(data, offset + 2);
+    uint16_t coverage = get_u16(data, offset + 4);
+    bool horizontal = coverage & 0x01;
+    bool minimum = coverage & 0x02;
+    bool crossStream = coverage & 0x04;
+    if ((coverage >> 8) == 0 && horizontal && !minimum && !crossStream) {
+      // each pair record is left, right, value
+      uint16_t nPairs = get_u16(data, offset + 6);
+      vector<uint16_t> records(3 * nPairs);
+      if (get_u16_array(data, offset + 14, records.size(), records.data())) {
+        for (int i = 0; i < nPairs; ++i) {
+          pairs.add(pair_key(0, records[3 * i], records[3 * i + 1]),
+                    (int16_t)records[3 * i + 2], t);
+        }
+      }
+    }
+    if (length == 0)
+      break;
+    offset += length;
+  }
+}
+
+// GPOS PairPos
+
+static int value_record_size(uint16_t valueFormat) {
+  return __builtin_popcount(valueFormat) * 2;
+}
+
+// Position of XAdvance inside a value record, or -1 if it is not present
+static int x_advance_offset(uint16_t valueFormat) {
+  if (!(valueFormat & 0x0004))
+    return -1;
+  return __builtin_popcount(valueFormat & 0x0003) * 2;
+}
+
+static vector<uint16_t> read_coverage(const TableBytes &d, size_t o) {
+  vector<uint16_t> glyphs;
+  uint16_t format = get_u16(d, o);
+  uint16_t count = get_u16(d, o + 2);
+  if (format == 1) {
+    glyphs.resize(count);
+    if (!get_u16_array(d, o + 4, count, glyphs.data()))
+      glyphs.clear();
+  } else if (format == 2) {
+    for (int i = 0; i < count; ++i) {
+      size_t r = o + 4 + i * 6;
+      uint16_t start = get_u16(d, r), end = get_u16(d, r + 2);
+      for (uint32_t g = start; g <= end; ++g)
+        glyphs.push_back(g);
+    }
+  }
+  return glyphs;
+}
+
+static vector<uint16_t> read_class_def(const TableBytes &d, size_t o,
+                                       uint16_t numGlyphs) {
+  vector<uint16_t> classes(numGlyphs, 0);
+  uint16_t format = get_u16(d, o);
+  if (format == 1) {
+    uint16_t start = get_u16(d, o + 2);
+    uint16_t count = get_u16(d, o + 4);
+    for (int i = 0; i < count && start + i < numGlyphs; ++i)
+      classes[start + i] = get_u16(d, o + 6 + i * 2);
+  } else if (format == 2) {
+    uint16_t count = get_u16(d, o + 2);
+    for (int i = 0; i < count; ++i) {
+      size_t r = o + 4 + i * 6;
+      uint16_t start = get_u16(d, r), end = get_u16(d, r + 2);
+      uint16_t cls = get_u16(d, r + 4);
+      for (uint32_t g = start; g <= end && g < numGlyphs; ++g)
+        classes[g] = cls;
+    }
+  }
+  return classes;
+}
+
+static void read_pair_pos(const TableBytes &d, size_t o, uint16_t numGlyphs,
+                          uint32_t lookup, uint16_t subtable,
+                          PairList &pairs, KernLookup &classes) {
+  uint16_t format = get_u16(d, o);
+  vector<uint16_t> coverage = read_coverage(d, o + get_u16(d, o + 2));
+  uint16_t valueFormat1 = get_u16(d, o + 4);
+  uint16_t valueFormat2 = get_u16(d, o + 6);
+  int xAdvance = x_advance_offset(valueFormat1);
+  int size1 = value_record_size(valueFormat1);
+  int size2 = value_record_size(valueFormat2);
+
+  if (format == 1) {
+    uint16_t pairSetCount = get_u16(d, o + 8);
+    for (int i = 0; i < pairSetCount && i < (int)coverage.size(); ++i) {
+      size_t set = o + get_u16(d, o + 10 + i * 2);
+      uint16_t count = get_u16(d, set);
+      size_t r = set + 2;
+      for (int j = 0; j < count; ++j, r += 2 + size1 + size2) {
+        if (xAdvance < 0)
+          continue;
+        uint16_t second = get_u16(d, r);
+        pairs.add(pair_key(lookup, coverage[i], second),
+                  (int16_t)get_u16(d, r + 2 + xAdvance), subtable);
+      }
+    }
+  } else if (format == 2) {
+    if (xAdvance < 0)
+      return;
+    KernClassTable table;
+    table.subtable = subtable;
+    vector<uint16_t> class1 = read_class_def(d, o + get_u16(d, o + 8), numGlyphs);
+    table.class2 = read_class_def(d, o + get_u16(d, o + 10), numGlyphs);
+    uint16_t class1Count = get_u16(d, o + 12);
+    table.class2Count = get_u16(d, o + 14);
+
+    // only glyphs in the coverage table take part, whatever their class
+    table.class1.assign(numGlyphs, KERN_NOT_COVERED);
+    for (uint16_t g : coverage) {
+      if (g < numGlyphs && class1[g] < class1Count)
+        table.class1[g] = class1[g];
+    }
+    for (uint16_t &c : table.class2) {
+      if (c >= table.class2Count)
+        c = 0;
+    }
+
+    table.values.resize((size_t)class1Count * table.class2Count);
+    size_t r = o + 16;
+    for (size_t i = 0; i < table.values.size(); ++i, r += size1 + size2)
+      table.values[i] = (int16_t)get_u16(d, r + xAdvance);
+    classes.classes.push_back(move(table));
+  }
+}
+
+// Lookups referenced by any 'kern' feature, in lookup list order
+static void read_gpos(const TableBytes &d, uint16_t numGlyphs,
+                      PairList &pairs, KernTable &kern) {
+  size_t featureList = get_u16(d, 6);
+  size_t lookupList = get_u16(d, 8);
+
+  uint16_t lookupCount = get_u16(d, lookupList);
+  vector<bool> wanted(lookupCount, false);
+  uint16_t featureCount = get_u16(d, featureList);
+  for (int i = 0; i < featureCount; ++i) {
+    size_t rec = featureList + 2 + i * 6;
+    if (get_u32(d, rec) != 0x6B65726E) // 'kern'
+      continue;
+    size_t feature = featureList + get_u16(d, rec + 4);
+    uint16_t indexCount = get_u16(d, feature + 2);
+    for (int j = 0; j < indexCount; ++j) {
+      uint16_t index = get_u16(d, feature + 4 + j * 2);
+      if (index < lookupCount)
+        wanted[index] = true;
+    }
+  }
+
+  for (int i = 0; i < lookupCount; ++i) {
+    if (!wanted[i])
+      continue;
+    uint32_t index = kern.lookups.size();
+    kern.lookups.emplace_back();
+    size_t lookup = lookupList + get_u16(d, lookupList + 2 + i * 2);
+    uint16_t type = get_u16(d, lookup);
+    uint16_t subTableCount = get_u16(d, lookup + 4);
+    for (int j = 0; j < subTableCount; ++j) {
+      size_t sub = lookup + get_u16(d, lookup + 6 + j * 2);
+      uint16_t subType = type;
+      if (type == 9) { // extension positioning
+        subType = get_u16(d, sub + 2);
+        sub += get_u32(d, sub + 4);
+      }
+      if (subType == 2)
+        read_pair_pos(d, sub, numGlyphs, index, j, pairs, kern.lookups[index]);
+    }
+  }
+}
+
+// Load Kerning
+
+// GPOS kerning supersedes the legacy kern table when both are present
+KernTable parse_kerning(const VerifiedFont &font) {
+  KernTable kern;
+  PairList pairs;
+
+  if (has_table(font.tables, TABLE_GPOS)) {
+    TableBytes gpos = table_bytes(font, TABLE_GPOS);
+    read_gpos(gpos, font.numGlyphs, pairs, kern);
+  }
+  bool classes = any_of(kern.lookups.begin(), kern.lookups.end(),
+                        [](const KernLookup &l) { return !l.classes.empty(); });
+  if (pairs.keys.empty() && !classes && has_table(font.tables, TABLE_KERN)) {
+    TableBytes table = table_bytes(font, TABLE_KERN);
+    kern.lookups.assign(1, KernLookup());
+    read_kern_table(table, pairs);
+  }
+
+  build_pair_hash(pairs, kern);
+  return kern;
+}
+
+shared_ptr<const KernTable> font_kerning(const VerifiedFont &font) {
+  return lazy_cache(font, font.kerning, [&] { return parse_kerning(font); }, kern_table_bytes);
+}
+
+size_t kern_table_bytes(const KernTable &kern) {
+  size_t bytes = vector_bytes(kern.keys) + vector_bytes(kern.values) +
+                 vector_bytes(kern.subtables) + vector_bytes(kern.lookups);
+  for (const KernLookup &lookup : kern.lookups) {
+    bytes += vector_bytes(lookup.classes);
+    for (const KernClassTable &table : lookup.classes)
+      bytes += vector_bytes(table.class1) + vector_bytes(table.class2) + vector_bytes(table.values);
+  }
+  return bytes;
+}
+
+int16_t kern_pair(const KernTable &kern, uint16_t left, uint16_t right) {
+  int total = 0;
+  for (uint32_t l = 0; l < kern.lookups.size(); ++l) {
+    uint32_t subtable = NO_SUBTABLE;
+    int16_t value = 0;
+    uint64_t key = pair_key(l, left, right);
+    uint32_t slot = pair_slot(key, kern.mask);
+    while (!kern.keys.empty() && kern.keys[slot] != EMPTY_KEY) {
+      if (kern.keys[slot] == key) {
+        subtable = kern.subtables[slot];
+        value = kern.values[slot];
+        break;
+      }
+      slot = (slot + 1) & kern.mask;
+    }
+
+    // a class subtable before the pair's own covers the left glyph first
+    for (const KernClassTable &table : kern.lookups[l].classes) {
+      if (table.subtable >= subtable)
+        break;
+      if (left >= table.class1.size() || table.class1[left] == KERN_NOT_COVERED)
+        continue;
+      uint16_t c2 = right < table.class2.size() ? table.class2[right] : 0;
+      value = table.values[(size_t)table.class1[left] * table.class2Count + c2];
+      break;
+    }
+    total += value;
+  }
+  return max(INT16_MIN, min(total, INT16_MAX));
+}
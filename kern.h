@@ -0,0 +1,48 @@
+#ifndef KERN_H
+#define KERN_H
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "font.h"
+
+// PairPos format 2 subtable expanded to per-glyph class arrays so a lookup is
+// two loads and one matrix index.
+struct KernClassTable {
+  uint16_t subtable; // position in its lookup
+  std::vector<uint16_t> class1; // per left glyph, KERN_NOT_COVERED if absent
+  std::vector<uint16_t> class2; // per right glyph, 0 if unlisted
+  uint16_t class2Count;
+  std::vector<int16_t> values; // class1Count x class2Count
+};
+
+static const uint16_t KERN_NOT_COVERED = 0xFFFF;
+
+// Class-based subtables of one kern lookup, in subtable order
+struct KernLookup {
+  std::vector<KernClassTable> classes;
+};
+
+// All pair adjustments of a font compiled into a flat open-addressing hash
+// keyed by (lookup << 32 | left << 16 | right) and tagged with the subtable
+// each came from, plus the class-based subtables of each lookup. Values are
+// x advance adjustments in font units.
+//
+// Within a lookup the first subtable that applies to a pair wins, as in
+// shaping: a specific pair whose subtable has it, or a class subtable that
+// covers the left glyph. The lookups' adjustments add up.
+struct KernTable {
+  std::vector<uint64_t> keys;
+  std::vector<int16_t> values;
+  std::vector<uint16_t> subtables;
+  uint32_t mask = 0;
+  std::vector<KernLookup> lookups;
+};
+
+KernTable parse_kerning(const VerifiedFont &font);
+std::shared_ptr<const KernTable> font_kerning(const VerifiedFont &font);
+size_t kern_table_bytes(const KernTable &kern);
+int16_t kern_pair(const KernTable &kern, uint16_t left, uint16_t right);
+
+#endif
@@ -0,0 +1,53 @@
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "layout.h"
+
+using namespace std;
+
+// Unpaired surrogates are passed through and will map to .notdef
+vector<uint32_t> decode_utf16(const u16string &text) {
+  vector<uint32_t> codepoints;
+  codepoints.reserve(text.size());
+  for (size_t i = 0; i < text.size(); ++i) {
+    uint32_t c = text[i];
+    if (c >= 0xD800 && c <= 0xDBFF && i + 1 < text.size()) {
+      uint32_t low = text[i + 1];
+      if (low >= 0xDC00 && low <= 0xDFFF) {
+        c = 0x10000 + ((c - 0xD800) << 10) + (low - 0xDC00);
+        ++i;
+      }
+    }
+    codepoints.push_back(c);
+  }
+  return codepoints;
+}
+
+LineLayout layout_line(const vector<uint32_t> &codepoints, float size,
+                       const VerifiedFont &font) {
+  shared_ptr<const CharMap> cmapCache = font_char_map(font);
+  shared_ptr<const HorizontalMetrics> metricsCache = font_horizontal_metrics(font);
+  shared_ptr<const KernTable> kernCache = font_kerning(font);
+  const CharMap &cmap = *cmapCache;
+  const HorizontalMetrics &metrics = *metricsCache;
+  const KernTable &kern = *kernCache;
+
+  LineLayout line;
+  line.glyphs.resize(codepoints.size());
+  line.positions.resize(codepoints.size() + 1);
+
+  float scale = size / (metrics.font.unitsPerEm ? metrics.font.unitsPerEm : 1000);
+  int32_t pen = 0; // font units, scaled once per glyph to avoid drift
+  for (size_t i = 0; i < codepoints.size(); ++i) {
+    uint16_t glyph = char_map_lookup(cmap, codepoints[i]);
+    if (i > 0)
+      pen += kern_pair(kern, line.glyphs[i - 1], glyph);
+    line.glyphs[i] = glyph;
+    line.positions[i] = pen * scale;
+    pen += glyph_metrics(metrics, glyph).advance;
+  }
+  line.positions[codepoints.size()] = pen * scale;
+
+  return line;
+}
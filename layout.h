@@ -0,0 +1,23 @@
+#ifndef LAYOUT_H
+#define LAYOUT_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "cmap.h"
+#include "kern.h"
+#include "metrics.h"
+
+// A single shaped line: glyph i is drawn at pen position positions[i], and
+// positions.back() is the pen position after the last glyph (line width).
+struct LineLayout {
+  std::vector<uint16_t> glyphs;
+  std::vector<float> positions;
+};
+
+std::vector<uint32_t> decode_utf16(const std::u16string &text);
+LineLayout layout_line(const std::vector<uint32_t> &codepoints, float size,
+                       const VerifiedFont &font);
+
+#endif
@@ -1,443 +1,875 @@
+#include <algorithm>
 #include <cstddef>
 #include <emscripten.h>
 #include <emscripten/bind.h>
 #include <cstdint>
 #include <cstring>
 #include <fstream>
-#include <iostream>
 #include <map>
-#include <stdexcept>
+#include <memory>
 #include <string>
 #include <vector>
 
 #include "writeback.h"
 #include "reorganize.h"
+#include "font.h"
+#include "atlas.h"
+#include "path.h"
+#include "cmap.h"
+#include "coverage.h"
+#include "curves.h"
+#include "metrics.h"
+#include "kern.h"
+#include "layout.h"
+#include "validate.h"
+#include "arena.h"
+#include "decode.h"
+#include "variation.h"
+#include "edit.h"
+#include "snapshot.h"
+#include "spatial.h"
+#include "aggregates.h"
+#include "fontdiff.h"
+#include "fingerprint.h"
+#include "flatten.h"
+#include "hinting.h"
+#include "bytes.h"
+#include "session.h"
 
 using namespace std;
 using namespace emscripten;
 
-struct TableRecord {
-  uint32_t offset;
-  uint32_t length;
-};
+FontSessions fonts;  // every open font, by handle
+Arena request_arena; // owns decoded outlines for the duration of one binding call
 
-struct Point {
-  int x, y;
-  bool onCurve;
-};
+// Main Program
 
-std::string filename;
+// Opens a font next to any already open; pass the handle to the other
+// bindings and to close_font when done
+EMSCRIPTEN_KEEPALIVE
+OpenedFont open_font(const std::string font_name) {
+  vector<uint8_t> data;
+  if (!read_file_bytes(font_name, data))
+    return {0, {false, FONT_NOT_FOUND, "", -1, "Font not found"}};
+  uint64_t hash = content_hash(data.data(), data.size());
+
+  // snapshots are only written for fonts that passed the full check, so a
+  // hit skips the per-glyph walk on the upload: reorganize only copies each
+  // glyph's bounded data, and the working copy it writes is always checked
+  // in full, since a content hash read back from disk cannot vouch for it
+  auto snapshot = make_shared<FontSnapshot>();
+  bool warm = !fonts.snapshotDir.empty() &&
+              load_snapshot(snapshot_path(fonts.snapshotDir, hash), hash, *snapshot);
+
+  // validate the upload before reorganize trusts its table directory
+  VerifiedFont input;
+  FontDiagnostic diag = validate_font(move(data), input, !warm);
+  if (!diag.ok)
+    return {0, diag};
+
+  int handle = fonts.nextHandle++;
+  unique_ptr<FontSession> session(new FontSession());
+  session->handle = handle;
+  session->filename = "output-" + to_string(session->handle) + ".ttf";
+  session->contentHash = hash;
+  diag = reorganize(font_name, session->filename);
+  if (!diag.ok) {
+    remove(session->filename.c_str());
+    return {0, diag};
+  }
 
-// Reading Binary Data
+  auto font = make_shared<VerifiedFont>();
+  diag = load_verified_font(session->filename, *font);
+  if (!diag.ok) {
+    remove(session->filename.c_str());
+    return {0, diag};
+  }
+  publish_font(*session, font);
+
+  if (!fonts.snapshotDir.empty()) {
+    bool ready = warm;
+    if (!warm) {
+      vector<uint8_t> bytes;
+      ready = build_snapshot(*font, hash, bytes);
+      if (ready) {
+        write_snapshot(snapshot_path(fonts.snapshotDir, hash), bytes);
+        ready = open_snapshot(move(bytes), hash, *snapshot);
+      }
+    }
+    if (ready && snapshot->header.numGlyphs == font->numGlyphs) {
+      session->snapshot = snapshot;
+      session->snapshotUsable = true;
+    }
+  }
 
-uint16_t read_u16(ifstream &f) {
-  uint8_t bytes[2];
-  f.read((char *)bytes, 2);
-  return (bytes[0] << 8) | bytes[1];
+  font_coverage(*font); // fallback queries hit many fonts at once
+  session->lastUse = ++fonts.clock;
+  fonts.open[handle] = move(session);
+  enforce_budget(fonts, fonts.open[handle].get());
+  return {handle, diag};
 }
 
-uint32_t read_u32(ifstream &f) {
-  uint8_t bytes[4];
-  f.read((char *)bytes, 4);
-  return (bytes[0] << 24) | (bytes[1] << 16) | (bytes[2] << 8) | bytes[3];
+// Drops the font, its caches and its working copy; pending edits are lost
+EMSCRIPTEN_KEEPALIVE
+void close_font(int handle) {
+  auto it = fonts.open.find(handle);
+  if (it == fonts.open.end())
+    return;
+  remove(it->second->filename.c_str());
+  fonts.open.erase(it);
 }
 
-int16_t read_i16(ifstream &f) { return (int16_t)read_u16(f); }
+// Bytes all open fonts may hold between them; the decoded caches of the
+// least recently used fonts are released to stay under it
+EMSCRIPTEN_KEEPALIVE
+void set_memory_budget(size_t bytes) {
+  fonts.budget = bytes;
+  enforce_budget(fonts, nullptr);
+}
 
-// Load Table Directory
+// Directory for outline snapshots keyed by the font's content hash; an
+// IDBFS mount in the browser (synced by the caller), any directory
+// natively. Empty turns the cache off for fonts opened afterwards.
+EMSCRIPTEN_KEEPALIVE
+void set_snapshot_dir(const std::string dir) {
+  fonts.snapshotDir = dir;
+}
 
-map<string, TableRecord> read_table_directory(ifstream &f) {
-  f.seekg(0);
-  f.ignore(4); // skip scaler type
-  uint16_t numTables = read_u16(f);
-  f.ignore(6); // skip searchRange, entrySelector, rangeShift
+// Outcome of the last binding that took a handle; the bindings return an
+// empty result for a handle that is not open instead of throwing, so the
+// module builds without exception support
+FontDiagnostic lastError = {true, FONT_OK, "", -1, ""};
 
-  map<string, TableRecord> tables;
-  for (int i = 0; i < numTables; ++i) {
-    char tag[5] = {0};
-    f.read(tag, 4);
-    f.ignore(4); // checksum
-    uint32_t offset = read_u32(f);
-    uint32_t length = read_u32(f);
-    tables[string(tag)] = {offset, length};
-  }
-  return tables;
+EMSCRIPTEN_KEEPALIVE
+FontDiagnostic last_error() {
+  return lastError;
 }
 
-// Load Key Font Info
-
-uint16_t get_num_glyphs(ifstream &f, const TableRecord &maxp) {
-  f.seekg(maxp.offset + 4);
-  return read_u16(f);
+// Null, with lastError set, for a handle that is not open. The font's
+// parsed tables grow inside whichever binding first reads them, so the
+// budget is checked here as well, for what the previous calls built.
+FontSession *session_for(int handle) {
+  FontSession *session = use_session(fonts, handle);
+  if (!session) {
+    lastError = {false, FONT_BAD_HANDLE, "", -1, "Font not found"};
+    return nullptr;
+  }
+  lastError = {true, FONT_OK, "", -1, ""};
+  enforce_budget(fonts, session);
+  return session;
 }
 
-uint16_t get_index_to_loc_format(ifstream &f, const TableRecord &head) {
-  f.seekg(head.offset + 50);
-  return read_u16(f);
+// Writes the committed font to path packed for shipping: the headroom the
+// working copy keeps for edits is dropped and loca goes back to the short
+// format when it fits. Pending edits are not included.
+EMSCRIPTEN_KEEPALIVE
+FontDiagnostic save_font(int handle, const std::string path) {
+  FontSession *session = session_for(handle);
+  if (!session)
+    return lastError;
+  return reorganize(session->filename, path, GLYF_TIGHT);
 }
 
-// Load Loca Table
+// Edits leave the snapshot behind for good
+void font_edited(FontSession &session) {
+  session.snapshot.reset();
+  session.snapshotUsable = false;
+}
 
-vector<uint32_t> read_loca(ifstream &f, const TableRecord &loca, int numGlyphs,
-                           bool shortFormat) {
-  vector<uint32_t> offsets(numGlyphs + 1);
-  f.seekg(loca.offset);
-  if (shortFormat) {
-    for (int i = 0; i <= numGlyphs; ++i) {
-      offsets[i] = read_u16(f) * 2;
-    }
-  } else {
-    for (int i = 0; i <= numGlyphs; ++i) {
-      offsets[i] = read_u32(f);
-    }
-  }
-  return offsets;
+// -1 for a handle that is not open, so it cannot pass for .notdef
+EMSCRIPTEN_KEEPALIVE
+int find_glyph_index(int handle, uint32_t unicode) {
+  FontSession *session = session_for(handle);
+  if (!session)
+    return -1;
+  if (const FontSnapshot *snapshot = session_snapshot(fonts, *session))
+    return snapshot_lookup(*snapshot, unicode);
+  return char_map_lookup(*font_char_map(*session_font(*session)), unicode);
 }
 
-// Extract One Glyph
+EMSCRIPTEN_KEEPALIVE
+vector<vector<vector<Point>>> extract_glyphs(int handle) {
+  FontSession *session = session_for(handle);
+  if (!session)
+    return {};
+  shared_ptr<const VerifiedFont> version = session_font(*session);
+  const VerifiedFont &font = *version;
+  const FontSnapshot *snapshot = session_snapshot(fonts, *session);
+
+  vector<vector<vector<Point>>> glyphs(font.numGlyphs);
+  for (int i = 0; i < font.numGlyphs; i++)
+    glyphs[i] = snapshot ? snapshot_glyph(*snapshot, i) : decode_glyph(font, i);
 
-vector<vector<Point>> read_simple_glyph(ifstream &f, const TableRecord &glyf,
-                                uint32_t glyphOffset) {
-  vector<vector<Point>> points;
+  return glyphs;
+}
 
-  f.seekg(glyf.offset + glyphOffset);
-  int16_t numContours = read_i16(f);
-  f.ignore(8); // skip bbox
+EMSCRIPTEN_KEEPALIVE
+vector<vector<Point>> extract_glyph(int handle, uint32_t unicode) {
+  FontSession *session = session_for(handle);
+  if (!session)
+    return {};
+  uint16_t glyph = find_glyph_index(handle, unicode);
+  if (const FontSnapshot *snapshot = session_snapshot(fonts, *session))
+    return snapshot_glyph(*snapshot, glyph);
+  return decode_glyph(*session_font(*session), glyph);
+}
 
-  if (numContours < 0)
-    return {}; // skip composite
+EMSCRIPTEN_KEEPALIVE
+vector<VariationAxis> variation_axes(int handle) {
+  FontSession *session = session_for(handle);
+  if (!session)
+    return {};
+  return font_variations(*session_font(*session))->axes;
+}
 
-  vector<uint16_t> endPts(numContours);
-  for (int i = 0; i < numContours; ++i) {
-    endPts[i] = read_u16(f);
-  }
+// coords are user-space axis values in variation_axes() order
+EMSCRIPTEN_KEEPALIVE
+vector<vector<Point>> extract_glyph_at(int handle, uint32_t unicode, vector<float> coords) {
+  FontSession *session = session_for(handle);
+  if (!session)
+    return {};
+  shared_ptr<const VerifiedFont> version = session_font(*session);
+  const VerifiedFont &font = *version;
+  uint16_t glyph = find_glyph_index(handle, unicode);
+
+  arena_reset(request_arena);
+  GlyphOutline outline = decode_outline(font, glyph, request_arena);
+  vary_outline(font, glyph, normalize_coords(*font_variations(font), coords), outline);
+  return outline_contours(outline);
+}
 
-  uint16_t instructionLength = read_u16(f);
-  f.ignore(instructionLength);
+// The glyph grid-fitted by its TrueType instructions at ppem, in 26.6
+// pixels with the left side bearing point at x = 0
+EMSCRIPTEN_KEEPALIVE
+vector<vector<Point>> hinted_glyph(int handle, uint32_t unicode, int ppem) {
+  FontSession *session = session_for(handle);
+  if (!session)
+    return {};
+  shared_ptr<const VerifiedFont> version = session_font(*session);
+  const VerifiedFont &font = *version;
+  uint16_t glyph = find_glyph_index(handle, unicode);
+
+  arena_reset(request_arena);
+  return outline_contours(hint_glyph(font, glyph, max(1, min(ppem, 0xFFFF)), request_arena).outline);
+}
 
-  int numPoints = endPts.back() + 1;
+EMSCRIPTEN_KEEPALIVE
+std::map<uint16_t, std::vector<uint16_t>> glyph_index_to_unicode_map(int handle) {
+  FontSession *session = session_for(handle);
+  if (!session)
+    return {};
+  if (const FontSnapshot *snapshot = session_snapshot(fonts, *session))
+    return snapshot_reverse_map(*snapshot);
+  return char_map_reverse(*font_char_map(*session_font(*session)));
+}
 
-  // Read flags
-  vector<uint8_t> flags;
-  while ((int)flags.size() < numPoints) {
-    uint8_t flag = f.get();
-    flags.push_back(flag);
-    if (flag & 0x08) { // repeat
-      uint8_t repeatCount = f.get();
-      for (int i = 0; i < repeatCount; ++i)
-        flags.push_back(flag);
+static FontDiagnostic check_entries(const VerifiedFont &font, const map<uint16_t, vector<WBPoint>> &points) {
+    if (font.cff)
+        return {false, FONT_BAD_EDIT, "CFF ", -1, "CFF outlines cannot be written back"};
+    for (const auto& pair : points) {
+        // modify_glyph indexes loca/glyf directly, so reject edits it cannot place
+        if (pair.first >= font.numGlyphs)
+            return {false, FONT_BAD_EDIT, "glyf", pair.first, "glyph index out of range"};
+        if (pair.second.empty() || !pair.second.back().endPt)
+            return {false, FONT_BAD_EDIT, "glyf", pair.first, "last point must end a contour"};
+        for (const WBPoint& p : pair.second) {
+            if (p.x < INT16_MIN || p.x > INT16_MAX || p.y < INT16_MIN || p.y > INT16_MAX)
+                return {false, FONT_BAD_EDIT, "glyf", pair.first, "coordinate outside int16"};
+        }
     }
-  }
+    return {true, FONT_OK, "", -1, ""};
+}
 
-  // Read X coords
-  vector<int> xCoords(numPoints);
-  int x = 0;
-  for (int i = 0; i < numPoints; ++i) {
-    uint8_t flag = flags[i];
-    int dx = 0;
-    if (flag & 0x02) {
-      uint8_t val = f.get();
-      dx = (flag & 0x10) ? val : -val;
-    } else if (!(flag & 0x10)) {
-      dx = (int16_t)read_u16(f);
+// Writes glyphs through the aggregates so head/maxp/hhea stay current. The
+// edited font is built from the published one, with only the edited glyphs
+// checked again, and written next to the working copy. Only then does it
+// replace the file and get published, so readers never see a half-written
+// font and a failed commit leaves both the file and the font as they were.
+FontDiagnostic write_glyphs(FontSession &session, const map<uint16_t, vector<WBPoint>> &points) {
+    if (!session.aggregates)
+        session.aggregates.reset(new FontAggregates(build_font_aggregates(*session_font(session))));
+    string next = session.filename + ".next";
+    auto font = make_shared<VerifiedFont>();
+    FontDiagnostic diag = writeback_font(*session_font(session), next, points, session.aggregates.get(), *font);
+    if (diag.ok && rename(next.c_str(), session.filename.c_str()) != 0)
+        diag = {false, FONT_IO, "", -1, "could not replace " + session.filename};
+    if (!diag.ok) {
+        remove(next.c_str());
+        session.aggregates.reset(); // may be ahead of the file now
+        return diag;
     }
-    x += dx;
-    xCoords[i] = x;
-  }
-
-  // Read Y coords
-  vector<int> yCoords(numPoints);
-  int y = 0;
-  for (int i = 0; i < numPoints; ++i) {
-    uint8_t flag = flags[i];
-    int dy = 0;
-    if (flag & 0x04) {
-      uint8_t val = f.get();
-      dy = (flag & 0x20) ? val : -val;
-    } else if (!(flag & 0x20)) {
-      dy = (int16_t)read_u16(f);
+    publish_font(session, font);
+    for (const auto& pair : points) {
+        drop_polylines(session.polylines, pair.first);
+        drop_sdf(session.atlas, pair.first);
     }
-    y += dy;
-    yCoords[i] = y;
-  }
+    enforce_budget(fonts, &session);
+    return diag;
+}
 
-  vector<Point> temp;
-  for (int i = 0; i < numPoints; ++i) {
-    temp.push_back(
-        {xCoords[i], yCoords[i], static_cast<bool>((flags[i] & 0x01))});
-    if (std::find(endPts.begin(), endPts.end(), i) != endPts.end()) {
-        points.push_back(temp);
-        temp.clear();
+EMSCRIPTEN_KEEPALIVE
+FontDiagnostic write_entries(int handle, const map<uint16_t, vector<WBPoint>> &points) {
+    FontSession *found = session_for(handle);
+    if (!found)
+        return lastError;
+    FontSession &session = *found;
+    FontDiagnostic diag = check_entries(*session_font(session), points);
+    if (!diag.ok)
+        return diag;
+    diag = write_glyphs(session, points);
+    if (!diag.ok)
+        return diag;
+    for (const auto& pair : points) {
+        session.pendingEdits.erase(pair.first);
+        drop_point_grid(session.grids, pair.first);
     }
-  }
-
-  if (!temp.empty()) {
-    points.push_back(temp);
-  }
-
-  return points;
+    font_edited(session);
+    return diag;
 }
 
-uint16_t get_glyph_index(ifstream &file, const TableRecord &cmap,
-                       int16_t character) {
-
-  file.seekg(cmap.offset);
-  read_u16(file); // version
-  uint16_t numSubtables = read_u16(file);
+// edits is an Int32Array in the edit.h record format. Only the named
+// points are touched; nothing is written until commit_edits().
+EMSCRIPTEN_KEEPALIVE
+FontDiagnostic apply_edits(int handle, val edits) {
+    FontSession *session = session_for(handle);
+    if (!session)
+        return lastError;
+    vector<int32_t> words = convertJSArrayToNumberVector<int32_t>(edits);
+    FontDiagnostic diag = apply_glyph_edits(*session_font(*session), words.data(), words.size(),
+                                            session->pendingEdits, &session->grids);
+    enforce_budget(fonts, session);
+    return diag;
+}
 
-  uint32_t bestSubtableOffset = 0;
-  for (int i = 0; i < numSubtables; ++i) {
-    uint16_t platformID = read_u16(file);
-    uint16_t encodingID = read_u16(file);
-    uint32_t offset = read_u32(file);
+EMSCRIPTEN_KEEPALIVE
+FontDiagnostic commit_edits(int handle) {
+    FontSession *found = session_for(handle);
+    if (!found)
+        return lastError;
+    FontSession &session = *found;
+    FontDiagnostic diag = check_entries(*session_font(session), session.pendingEdits);
+    if (!diag.ok)
+        return diag;
+    if (session.pendingEdits.empty())
+        return diag;
+    diag = write_glyphs(session, session.pendingEdits);
+    if (!diag.ok)
+        return diag; // the edits stay pending
+    session.pendingEdits.clear();
+    font_edited(session);
+    return diag;
+}
 
-    if (platformID == 3 && (encodingID == 1 || encodingID == 10)) {
-      bestSubtableOffset = cmap.offset + offset;
-      break;
+// Drops the uncommitted edits of glyph, or of every glyph when it is left
+// out. Their grids go too, so the next lookup sees the font's outline.
+EMSCRIPTEN_KEEPALIVE
+FontDiagnostic discard_edits(int handle, val glyph) {
+    FontSession *found = session_for(handle);
+    if (!found)
+        return lastError;
+    FontSession &session = *found;
+    if (glyph.isUndefined()) {
+        for (const auto& pair : session.pendingEdits)
+            drop_point_grid(session.grids, pair.first);
+        session.pendingEdits.clear();
+    } else {
+        int index = glyph.as<int>();
+        if (index >= 0 && index <= UINT16_MAX && session.pendingEdits.erase(index))
+            drop_point_grid(session.grids, index);
     }
-  }
+    return {true, FONT_OK, "", -1, ""};
+}
 
-  if (bestSubtableOffset == 0) {
-    std::cerr << "No usable cmap subtable found." << std::endl;
-    return 0;
+// The grid follows the editor's view of the glyph: its pending outline if
+// it has uncommitted edits, otherwise the font's.
+const PointGrid &glyph_grid(FontSession &session, uint16_t glyph) {
+  auto it = session.grids.byGlyph.find(glyph);
+  if (it != session.grids.byGlyph.end())
+    return it->second;
+
+  vector<int32_t> xs, ys;
+  auto pending = session.pendingEdits.find(glyph);
+  if (pending != session.pendingEdits.end()) {
+    for (const WBPoint &p : pending->second) {
+      xs.push_back(p.x);
+      ys.push_back(p.y);
+    }
+  } else if (glyph < session_font(session)->numGlyphs) {
+    arena_reset(request_arena);
+    shared_ptr<const VerifiedFont> version = session_font(session);
+    GlyphOutline outline = decode_outline(*version, glyph, request_arena);
+    for (uint32_t i = 0; i < outline.numPoints; i++) {
+      xs.push_back(outline.points[i].x);
+      ys.push_back(outline.points[i].y);
+    }
   }
+  const PointGrid &grid = store_point_grid(session.grids, glyph,
+                                           build_point_grid(xs.data(), ys.data(), xs.size()));
+  enforce_budget(fonts, &session);
+  return grid;
+}
 
-  file.seekg(bestSubtableOffset);
-  uint16_t format = read_u16(file);
-  if (format != 4) {
-    std::cerr << "Only Format 4 cmap is supported." << std::endl;
-    return 0;
-  }
+// Index of the point nearest (x, y) within radius font units, or -1
+EMSCRIPTEN_KEEPALIVE
+int nearest_point(int handle, int glyph, float x, float y, float radius) {
+  FontSession *session = session_for(handle);
+  if (!session || glyph < 0 || glyph >= session_font(*session)->numGlyphs)
+    return -1;
+  return grid_nearest_point(glyph_grid(*session, glyph), x, y, radius);
+}
 
-  uint16_t length = read_u16(file);
-  read_u16(file); // language
-  uint16_t segCountX2 = read_u16(file);
-  uint16_t segCount = segCountX2 / 2;
-
-  file.seekg(6, std::ios::cur); // skip searchRange, entrySelector, rangeShift
-
-  std::vector<uint16_t> endCode(segCount);
-  for (int i = 0; i < segCount; ++i)
-    endCode[i] = read_u16(file);
-  read_u16(file); // reservedPad
-  std::vector<uint16_t> startCode(segCount);
-  for (int i = 0; i < segCount; ++i)
-    startCode[i] = read_u16(file);
-  std::vector<int16_t> idDelta(segCount);
-  for (int i = 0; i < segCount; ++i)
-    idDelta[i] = read_i16(file);
-  std::vector<uint16_t> idRangeOffset(segCount);
-  for (int i = 0; i < segCount; ++i)
-    idRangeOffset[i] = read_u16(file);
-
-  uint32_t glyphIdArrayStart = file.tellg();
-
-  uint16_t charCode = character;
-  for (int i = 0; i < segCount; ++i) {
-    if (startCode[i] <= charCode && charCode <= endCode[i]) {
-      if (idRangeOffset[i] == 0) {
-        return (charCode + idDelta[i]) % 65536;
-      } else {
-        std::streampos pos = glyphIdArrayStart + 2 * i + idRangeOffset[i] +
-                             2 * (charCode - startCode[i]);
-        file.seekg(pos);
-        uint16_t glyphId = read_u16(file);
-        if (glyphId == 0)
-          return 0;
-        return (glyphId + idDelta[i]) % 65536;
-      }
-    }
+// Glyph-level comparison of two open fonts, e.g. two weights of a family
+// or a font and a copy of it that has been edited
+EMSCRIPTEN_KEEPALIVE
+FontDiff diff(int a, int b) {
+  FontSession *before = session_for(a);
+  FontSession *after = before ? session_for(b) : nullptr;
+  if (!after) {
+    FontDiff result;
+    result.status = lastError;
+    return result;
   }
+  return diff_fonts(*session_font(*before), *session_font(*after));
+}
 
-  return 0; // not found
+// Copies into a fresh JS typed array so the result survives heap growth
+template <typename T>
+val typed_array(const char *type, const vector<T> &data) {
+  return val::global(type).new_(typed_memory_view(data.size(), data.data()));
 }
 
-vector<vector<Point>> read_glyph(ifstream &file, map<string, TableRecord> tables, vector<uint32_t> loca, int unicode) {
-  int glyph_index = get_glyph_index(file, tables["cmap"], unicode);
-  auto glyph = read_simple_glyph(file, tables["glyf"], loca[glyph_index]);
+// The glyphs [first, first + count) that the font has. The end is found in
+// 64 bits, so a first or count near INT_MAX cannot wrap into the font.
+struct GlyphRange {
+  uint32_t first, last;
+};
 
-  return glyph;
+static GlyphRange glyph_range(const VerifiedFont &font, int first, int count) {
+  int64_t begin = max(first, 0);
+  int64_t end = begin + max(count, 0);
+  return {(uint32_t)min<int64_t>(begin, font.numGlyphs),
+          (uint32_t)min<int64_t>(end, font.numGlyphs)};
 }
 
-std::map<uint16_t, std::vector<uint16_t>> gntu_map(ifstream &file, const TableRecord &cmap) {
+val path_buffer_to_val(PathBuffer &buffer) {
+  buffer.verbStarts.push_back(buffer.verbs.size());
+  buffer.coordStarts.push_back(buffer.coords.size());
 
-  std::map<uint16_t, std::vector<uint16_t>> glyphToUnicode;
-
-  file.seekg(cmap.offset);
-  read_u16(file); // version
-  uint16_t numSubtables = read_u16(file);
+  val result = val::object();
+  result.set("verbs", typed_array("Uint8Array", buffer.verbs));
+  result.set("coords", typed_array("Float32Array", buffer.coords));
+  result.set("verbStarts", typed_array("Uint32Array", buffer.verbStarts));
+  result.set("coordStarts", typed_array("Uint32Array", buffer.coordStarts));
+  return result;
+}
 
-  uint32_t bestSubtableOffset = 0;
-  for (int i = 0; i < numSubtables; ++i) {
-    uint16_t platformID = read_u16(file);
-    uint16_t encodingID = read_u16(file);
-    uint32_t offset = read_u32(file);
+// Indices of the points inside a marquee, ascending, as a Uint32Array
+EMSCRIPTEN_KEEPALIVE
+val points_in_rect(int handle, int glyph, float x0, float y0, float x1, float y1) {
+  FontSession *session = session_for(handle);
+  vector<uint32_t> points;
+  if (session && glyph >= 0 && glyph < session_font(*session)->numGlyphs)
+    points = grid_points_in_rect(glyph_grid(*session, glyph), x0, y0, x1, y1);
+  return typed_array("Uint32Array", points);
+}
 
-    if (platformID == 3 && (encodingID == 1 || encodingID == 10)) {
-      bestSubtableOffset = cmap.offset + offset;
-      break;
-    }
-  }
+// Whether every character of text maps to a glyph other than .notdef
+EMSCRIPTEN_KEEPALIVE
+bool covers(int handle, std::u16string text) {
+  FontSession *session = session_for(handle);
+  if (!session)
+    return false;
+  return coverage_covers(*font_coverage(*session_font(*session)), coverage_query(decode_utf16(text)));
+}
 
-  if (bestSubtableOffset == 0) {
-    std::cerr << "No usable cmap subtable found." << std::endl;
-    return glyphToUnicode;
-  }
+// The characters of text the font has no glyph for, ascending and without
+// repeats, as a Uint32Array
+EMSCRIPTEN_KEEPALIVE
+val missing(int handle, std::u16string text) {
+  FontSession *session = session_for(handle);
+  if (!session)
+    return typed_array("Uint32Array", vector<uint32_t>());
+  shared_ptr<const VerifiedFont> version = session_font(*session);
+  shared_ptr<const CoverageSet> coverage = font_coverage(*version);
+  return typed_array("Uint32Array", coverage_missing(*coverage, coverage_query(decode_utf16(text))));
+}
 
-  file.seekg(bestSubtableOffset);
-  uint16_t format = read_u16(file);
-  if (format != 4) {
-    std::cerr << "Only Format 4 cmap is supported." << std::endl;
-    return glyphToUnicode;
-  }
+// Covered code points as inclusive first, last pairs in a Uint32Array
+EMSCRIPTEN_KEEPALIVE
+val font_coverage_ranges(int handle) {
+  FontSession *session = session_for(handle);
+  if (!session)
+    return typed_array("Uint32Array", vector<uint32_t>());
+  return typed_array("Uint32Array", coverage_ranges(*font_coverage(*session_font(*session))));
+}
 
-  uint16_t length = read_u16(file);
-  read_u16(file); // language
-  uint16_t segCountX2 = read_u16(file);
-  uint16_t segCount = segCountX2 / 2;
-
-  file.seekg(6, std::ios::cur); // skip searchRange, entrySelector, rangeShift
-
-  std::vector<uint16_t> endCode(segCount);
-  for (int i = 0; i < segCount; ++i)
-    endCode[i] = read_u16(file);
-  read_u16(file); // reservedPad
-  std::vector<uint16_t> startCode(segCount);
-  for (int i = 0; i < segCount; ++i)
-    startCode[i] = read_u16(file);
-  std::vector<int16_t> idDelta(segCount);
-  for (int i = 0; i < segCount; ++i)
-    idDelta[i] = read_i16(file);
-  std::vector<uint16_t> idRangeOffset(segCount);
-  for (int i = 0; i < segCount; ++i)
-    idRangeOffset[i] = read_u16(file);
-
-  uint32_t glyphIdArrayStart = file.tellg();
-  for (uint16_t charCode = 0; charCode < 65535; charCode++) {
-    for (int i = 0; i < segCount; ++i) {
-      if (startCode[i] <= charCode && charCode <= endCode[i]) {
-        if (idRangeOffset[i] == 0) {
-          glyphToUnicode[(charCode + idDelta[i]) % 65536].push_back(charCode);
-        } else {
-          std::streampos pos = glyphIdArrayStart + 2 * i + idRangeOffset[i] +
-                              2 * (charCode - startCode[i]);
-          file.seekg(pos);
-          uint16_t glyphId = read_u16(file);
-          if (glyphId == 0)
-            glyphToUnicode[0].push_back(charCode);
-          glyphToUnicode[(charCode + idDelta[i]) % 65536].push_back(charCode);
-        }
-      }
-    }
-    //cout << charCode;
+// The candidates (an Int32Array of handles) that cover all of text, in
+// their original order, for picking fallback fonts; handles that are not
+// open are skipped. Candidates are looked up directly and the budget is
+// checked once for the whole query, so its cost stays linear in the
+// number of candidates.
+EMSCRIPTEN_KEEPALIVE
+val fonts_covering(val handles, std::u16string text) {
+  CoverageQuery query = coverage_query(decode_utf16(text));
+  vector<int32_t> covering;
+  for (int32_t handle : convertJSArrayToNumberVector<int32_t>(handles)) {
+    FontSession *session = use_session(fonts, handle);
+    if (session && coverage_covers(*font_coverage(*session_font(*session)), query))
+      covering.push_back(handle);
   }
+  lastError = {true, FONT_OK, "", -1, ""};
+  enforce_budget(fonts, nullptr);
+  return typed_array("Int32Array", covering);
+}
 
-  return glyphToUnicode;
+EMSCRIPTEN_KEEPALIVE
+std::string glyph_svg_path(int handle, uint32_t unicode) {
+  return glyph_to_svg(extract_glyph(handle, unicode));
 }
 
-vector<vector<vector<Point>>> read_glyphs(ifstream &file, map<string, TableRecord> tables, vector<uint32_t> loca, int num_glyphs) {
-  vector<vector<vector<Point>>> glyphs;
-  for (int i = 0; i < num_glyphs; i++) {
-    auto glyph = read_simple_glyph(file, tables["glyf"], loca[i]);
-    glyphs.push_back(glyph);
-  }
+EMSCRIPTEN_KEEPALIVE
+vector<std::string> glyph_svg_paths(int handle, int first, int count) {
+  FontSession *session = session_for(handle);
+  if (!session)
+    return {};
+  shared_ptr<const VerifiedFont> version = session_font(*session);
+  const VerifiedFont &font = *version;
+
+  GlyphRange range = glyph_range(font, first, count);
+  vector<std::string> paths;
+  for (uint32_t i = range.first; i < range.last; i++)
+    paths.push_back(glyph_to_svg(decode_glyph(font, i)));
+
+  return paths;
+}
 
-  return glyphs;
+EMSCRIPTEN_KEEPALIVE
+val glyph_path_commands(int handle, uint32_t unicode) {
+  PathBuffer buffer;
+  append_glyph_commands(extract_glyph(handle, unicode), buffer);
+  return path_buffer_to_val(buffer);
 }
 
-// Main Program
 EMSCRIPTEN_KEEPALIVE
-void open_font(const std::string font_name) {
-  ifstream font(font_name, ios::binary);
-  if (!font)
-    throw runtime_error("Font not found");
+val glyph_path_commands_batch(int handle, int first, int count) {
+  FontSession *session = session_for(handle);
+  if (!session)
+    return val::null();
+  shared_ptr<const VerifiedFont> version = session_font(*session);
+  const VerifiedFont &font = *version;
+
+  arena_reset(request_arena);
+  GlyphRange range = glyph_range(font, first, count);
+  OutlineBatch batch = decode_outlines(font, range.first, range.last - range.first, request_arena);
+
+  PathBuffer buffer;
+  for (uint32_t i = 0; i < batch.count; i++)
+    append_outline_commands(batch.glyphs[i], buffer);
+
+  return path_buffer_to_val(buffer);
+}
 
-  font.close();
+// Points of count outlines as flat typed arrays: glyph i owns points
+// pointStarts[i]..pointStarts[i + 1] and contour ends
+// contourStarts[i]..contourStarts[i + 1], relative to its first point.
+static val outlines_flat(const GlyphOutline *glyphs, uint32_t count) {
+  size_t numPoints = 0, numContours = 0;
+  for (uint32_t i = 0; i < count; i++) {
+    numPoints += glyphs[i].numPoints;
+    numContours += glyphs[i].numContours;
+  }
 
-  reorganize(font_name);
+  vector<int32_t> coords;
+  vector<uint8_t> onCurve;
+  vector<uint16_t> contourEnds;
+  vector<uint32_t> pointStarts, contourStarts;
+  coords.reserve(numPoints * 2);
+  onCurve.reserve(numPoints);
+  contourEnds.reserve(numContours);
+  pointStarts.reserve(count + 1);
+  contourStarts.reserve(count + 1);
+  for (uint32_t i = 0; i < count; i++) {
+    const GlyphOutline &g = glyphs[i];
+    pointStarts.push_back(onCurve.size());
+    contourStarts.push_back(contourEnds.size());
+    for (uint32_t k = 0; k < g.numPoints; k++) {
+      coords.push_back(g.points[k].x);
+      coords.push_back(g.points[k].y);
+      onCurve.push_back(g.points[k].onCurve);
+    }
+    contourEnds.insert(contourEnds.end(), g.contourEnds, g.contourEnds + g.numContours);
+  }
+  pointStarts.push_back(onCurve.size());
+  contourStarts.push_back(contourEnds.size());
+
+  val result = val::object();
+  result.set("coords", typed_array("Int32Array", coords));
+  result.set("onCurve", typed_array("Uint8Array", onCurve));
+  result.set("contourEnds", typed_array("Uint16Array", contourEnds));
+  result.set("pointStarts", typed_array("Uint32Array", pointStarts));
+  result.set("contourStarts", typed_array("Uint32Array", contourStarts));
+  return result;
+}
 
-  filename = "output.ttf";
+// A glyph range in font units, laid out by outlines_flat
+EMSCRIPTEN_KEEPALIVE
+val extract_glyphs_flat(int handle, int first, int count) {
+  FontSession *session = session_for(handle);
+  if (!session)
+    return val::null();
+  shared_ptr<const VerifiedFont> version = session_font(*session);
+  const VerifiedFont &font = *version;
+
+  arena_reset(request_arena);
+  GlyphRange range = glyph_range(font, first, count);
+  OutlineBatch batch = decode_outlines(font, range.first, range.last - range.first, request_arena);
+  return outlines_flat(batch.glyphs, batch.count);
 }
 
+// A glyph range grid-fitted at ppem, in 26.6 pixels, laid out by
+// outlines_flat plus each glyph's hinted advance and whether its program
+// ran (0 for glyphs that are only scaled)
 EMSCRIPTEN_KEEPALIVE
-int find_glyph_index(uint16_t unicode) {
-  ifstream font(filename, ios::binary);
-  if (!font)
-    throw runtime_error("Font not found");
+val hinted_glyphs_flat(int handle, int first, int count, int ppem) {
+  FontSession *session = session_for(handle);
+  if (!session)
+    return val::null();
+  shared_ptr<const VerifiedFont> version = session_font(*session);
+  const VerifiedFont &font = *version;
+
+  arena_reset(request_arena);
+  GlyphRange range = glyph_range(font, first, count);
+  uint16_t size = max(1, min(ppem, 0xFFFF));
+  vector<GlyphOutline> glyphs;
+  vector<int32_t> advances;
+  vector<uint8_t> hinted;
+  for (uint32_t glyph = range.first; glyph < range.last; glyph++) {
+    HintedGlyph h = hint_glyph(font, glyph, size, request_arena);
+    glyphs.push_back(h.outline);
+    advances.push_back(h.advance);
+    hinted.push_back(h.hinted);
+  }
 
-  auto tables = read_table_directory(font);
-  int glyph_index = get_glyph_index(font, tables["cmap"], unicode);
+  val result = outlines_flat(glyphs.data(), glyphs.size());
+  result.set("advances", typed_array("Int32Array", advances));
+  result.set("hinted", typed_array("Uint8Array", hinted));
+  return result;
+}
 
-  return glyph_index;
+// Every glyph as banded quadratic curves for a shader that evaluates them
+// directly; the layout of each buffer is described in curves.h
+EMSCRIPTEN_KEEPALIVE
+val curve_buffers(int handle, int band_count) {
+  FontSession *session = session_for(handle);
+  if (!session)
+    return val::null();
+  shared_ptr<const VerifiedFont> version = session_font(*session);
+  const VerifiedFont &font = *version;
+
+  arena_reset(request_arena);
+  OutlineBatch batch = decode_outlines(font, 0, font.numGlyphs, request_arena);
+  CurveBuffers buffers = build_curve_buffers(batch, band_count);
+
+  val result = val::object();
+  result.set("bandCount", buffers.bandCount);
+  result.set("curves", typed_array("Float32Array", buffers.curves));
+  result.set("bounds", typed_array("Float32Array", buffers.bounds));
+  result.set("bands", typed_array("Uint32Array", buffers.bands));
+  result.set("bandCurves", typed_array("Uint32Array", buffers.bandCurves));
+  return result;
 }
 
+// A glyph range as polylines that stay within tolerance pixels of the
+// outline at px_size, in font units: glyph i owns the x, y pairs
+// pointStarts[i]..pointStarts[i + 1] of coords and the contour ends
+// contourStarts[i]..contourStarts[i + 1], inclusive and relative to its
+// first point. Polylines are cached per glyph and tolerance bucket.
 EMSCRIPTEN_KEEPALIVE
-vector<vector<vector<Point>>> extract_glyphs() {
-  ifstream font(filename, ios::binary);
-  if (!font)
-    throw runtime_error("Font not found");
+val flatten_glyphs(int handle, int first, int count, float px_size, float tolerance) {
+  FontSession *session = session_for(handle);
+  if (!session || !(px_size > 0) || !(tolerance > 0))
+    return val::null();
+  shared_ptr<const VerifiedFont> version = session_font(*session);
+  const VerifiedFont &font = *version;
+  float units = tolerance * font.unitsPerEm / px_size;
+
+  GlyphRange range = glyph_range(font, first, count);
+  vector<float> coords;
+  vector<uint32_t> contourEnds, pointStarts, contourStarts;
+  for (uint32_t glyph = range.first; glyph < range.last; glyph++) {
+    const Polyline &polyline = cached_polyline(session->polylines, font, glyph, units, request_arena);
+    pointStarts.push_back(coords.size() / 2);
+    contourStarts.push_back(contourEnds.size());
+    coords.insert(coords.end(), polyline.coords.begin(), polyline.coords.end());
+    contourEnds.insert(contourEnds.end(), polyline.contourEnds.begin(), polyline.contourEnds.end());
+  }
+  pointStarts.push_back(coords.size() / 2);
+  contourStarts.push_back(contourEnds.size());
+  enforce_budget(fonts, session);
+
+  val result = val::object();
+  result.set("coords", typed_array("Float32Array", coords));
+  result.set("contourEnds", typed_array("Uint32Array", contourEnds));
+  result.set("pointStarts", typed_array("Uint32Array", pointStarts));
+  result.set("contourStarts", typed_array("Uint32Array", contourStarts));
+  return result;
+}
 
-  auto tables = read_table_directory(font);
+EMSCRIPTEN_KEEPALIVE
+val flatten_glyph(int handle, int glyph, float px_size, float tolerance) {
+  return flatten_glyphs(handle, glyph, 1, px_size, tolerance);
+}
 
-  uint16_t numGlyphs = get_num_glyphs(font, tables["maxp"]);
-  uint16_t format = get_index_to_loc_format(font, tables["head"]);
+// Near-duplicate fonts and glyphs
 
-  auto loca = read_loca(font, tables["loca"], numGlyphs, format == 0);
+FingerprintIndex fingerprints; // everything added by index_font_files and index_open_font
 
-  auto glyphs = read_glyphs(font, tables, loca, numGlyphs);
-  font.close();
+// Sketches the font files (a JS array of paths) in parallel and adds them to
+// the index; their index ids as an Int32Array, -1 where a file failed to load
+EMSCRIPTEN_KEEPALIVE
+val index_font_files(val paths) {
+  vector<FontDiagnostic> diagnostics;
+  vector<FontSketch> sketches = font_sketch_files(vecFromJSArray<std::string>(paths), diagnostics);
+  vector<int32_t> ids;
+  for (size_t i = 0; i < sketches.size(); ++i) {
+    if (!diagnostics[i].ok) {
+      lastError = diagnostics[i];
+      ids.push_back(-1);
+    } else {
+      ids.push_back(index_add(fingerprints, move(sketches[i])));
+    }
+  }
+  return typed_array("Int32Array", ids);
+}
 
-  return glyphs;
+EMSCRIPTEN_KEEPALIVE
+int index_open_font(int handle) {
+  FontSession *session = session_for(handle);
+  if (!session)
+    return -1;
+  arena_reset(request_arena);
+  return index_add(fingerprints, font_sketch(*session_font(*session), request_arena));
 }
 
+// Indexed fonts estimated to share at least min_similarity of the open
+// font's glyph outlines, most similar first: {fonts: Int32Array of index
+// ids, similarity: Float32Array}
 EMSCRIPTEN_KEEPALIVE
-vector<vector<Point>> extract_glyph(int unicode) {
-  ifstream font(filename, ios::binary);
-  if (!font)
-    throw runtime_error("Font not found");
+val similar_fonts(int handle, float min_similarity) {
+  FontSession *session = session_for(handle);
+  if (!session)
+    return val::null();
+  arena_reset(request_arena);
+  FontSketch sketch = font_sketch(*session_font(*session), request_arena);
+
+  vector<int32_t> ids;
+  vector<float> similarity;
+  for (const FontMatch &match : index_similar_fonts(fingerprints, sketch, min_similarity)) {
+    ids.push_back(match.font);
+    similarity.push_back(match.similarity);
+  }
+  val result = val::object();
+  result.set("fonts", typed_array("Int32Array", ids));
+  result.set("similarity", typed_array("Float32Array", similarity));
+  return result;
+}
 
-  auto tables = read_table_directory(font);
+// Indexed glyphs whose fingerprint is within max_distance bits of the open
+// font's glyph, nearest first: {fonts: Int32Array of index ids, glyphs:
+// Uint16Array, distances: Uint8Array}
+EMSCRIPTEN_KEEPALIVE
+val similar_glyphs(int handle, int glyph, int max_distance) {
+  FontSession *session = session_for(handle);
+  if (!session)
+    return val::null();
+  shared_ptr<const VerifiedFont> version = session_font(*session);
+  const VerifiedFont &font = *version;
+  if (glyph < 0 || glyph >= font.numGlyphs)
+    return val::null();
+
+  arena_reset(request_arena);
+  uint64_t fingerprint = glyph_fingerprint(decode_outline(font, glyph, request_arena), font.unitsPerEm);
+  vector<int32_t> ids;
+  vector<uint16_t> glyphs;
+  vector<uint8_t> distances;
+  for (const GlyphMatch &match : index_similar_glyphs(fingerprints, fingerprint, max_distance)) {
+    ids.push_back(match.font);
+    glyphs.push_back(match.glyph);
+    distances.push_back(match.distance);
+  }
+  val result = val::object();
+  result.set("fonts", typed_array("Int32Array", ids));
+  result.set("glyphs", typed_array("Uint16Array", glyphs));
+  result.set("distances", typed_array("Uint8Array", distances));
+  return result;
+}
 
-  uint16_t numGlyphs = get_num_glyphs(font, tables["maxp"]);
-  uint16_t format = get_index_to_loc_format(font, tables["head"]);
+EMSCRIPTEN_KEEPALIVE
+FontMetrics font_metrics(int handle) {
+  FontSession *session = session_for(handle);
+  if (!session)
+    return {0, 0, 0, 0};
+  return font_horizontal_metrics(*session_font(*session))->font;
+}
 
-  auto loca = read_loca(font, tables["loca"], numGlyphs, format == 0);
+EMSCRIPTEN_KEEPALIVE
+GlyphMetrics glyph_advance(int handle, uint16_t glyph) {
+  FontSession *session = session_for(handle);
+  if (!session)
+    return {0, 0};
+  return glyph_metrics(*font_horizontal_metrics(*session_font(*session)), glyph);
+}
 
-  auto glyphs = read_glyph(font, tables, loca, unicode);
-  font.close();
+EMSCRIPTEN_KEEPALIVE
+int kerning(int handle, uint16_t left, uint16_t right) {
+  FontSession *session = session_for(handle);
+  if (!session)
+    return 0;
+  return kern_pair(*font_kerning(*session_font(*session)), left, right);
+}
 
-  return glyphs;
+val line_layout_to_val(const LineLayout &line) {
+  val result = val::object();
+  result.set("glyphs", typed_array("Uint16Array", line.glyphs));
+  result.set("positions", typed_array("Float32Array", line.positions));
+  return result;
 }
 
 EMSCRIPTEN_KEEPALIVE
-std::map<uint16_t, std::vector<uint16_t>> glyph_index_to_unicode_map() {
-  ifstream font(filename, ios::binary);
-  if (!font)
-    throw runtime_error("Font not found");
-
-  auto tables = read_table_directory(font);
-  std::map<uint16_t, std::vector<uint16_t>> glyphNumToUnicode = gntu_map(font, tables["cmap"]);
-  font.close();
+val layout(int handle, std::u16string text, float size) {
+  FontSession *session = session_for(handle);
+  if (!session)
+    return val::null();
+  return line_layout_to_val(layout_line(decode_utf16(text), size, *session_font(*session)));
+}
 
-  return glyphNumToUnicode;
+EMSCRIPTEN_KEEPALIVE
+val layout_codepoints(int handle, val codepoints, float size) {
+  FontSession *session = session_for(handle);
+  if (!session)
+    return val::null();
+  return line_layout_to_val(layout_line(
+      convertJSArrayToNumberVector<uint32_t>(codepoints), size, *session_font(*session)));
 }
 
 EMSCRIPTEN_KEEPALIVE
-void write_entries(map<uint16_t, vector<WBPoint>> points) {
-    std::vector<int> glyphIndices;
-    std::vector<std::vector<WBPoint>> pointsVectors;
-    for (const auto& pair : points) {
-        glyphIndices.push_back(pair.first);
-        pointsVectors.push_back(pair.second);
-    }
-    writeback(filename, filename, glyphIndices, pointsVectors);
+SdfAtlas bake_sdf_atlas(int handle, float px_size, int spread, int atlas_width) {
+  FontSession *session = session_for(handle);
+  if (!session)
+    return {lastError, 0, 0, {}, {}, {}};
+
+  SdfAtlas atlas = bake_atlas(*session_font(*session), px_size, spread, atlas_width,
+                              session->atlas);
+  enforce_budget(fonts, session);
+  return atlas;
 }
 
 EMSCRIPTEN_BINDINGS(my_module) {
   emscripten::value_object<Point>("Point")
     .field("x", &Point::x)
     .field("y", &Point::y)
-    .field("onCurve", &Point::onCurve);
+    .field("onCurve", &Point::onCurve)
+    .field("cubic", &Point::cubic);
 
   emscripten::value_object<WBPoint>("WBPoint")
     .field("x", &WBPoint::x)
@@ -452,6 +884,74 @@ EMSCRIPTEN_BINDINGS(my_module) {
   emscripten::register_map<uint16_t, std::vector<uint16_t>>("map<uint16_t, vector<uint16_t>>");
   emscripten::register_vector<std::vector<std::vector<Point>>>("VectorVectorVectorPoint");
 
+  emscripten::value_object<AtlasGlyph>("AtlasGlyph")
+    .field("glyph", &AtlasGlyph::glyph)
+    .field("x", &AtlasGlyph::x)
+    .field("y", &AtlasGlyph::y)
+    .field("width", &AtlasGlyph::width)
+    .field("height", &AtlasGlyph::height)
+    .field("left", &AtlasGlyph::left)
+    .field("top", &AtlasGlyph::top);
+
+  emscripten::value_object<SdfAtlas>("SdfAtlas")
+    .field("status", &SdfAtlas::status)
+    .field("width", &SdfAtlas::width)
+    .field("height", &SdfAtlas::height)
+    .field("bitmap", &SdfAtlas::bitmap)
+    .field("glyphs", &SdfAtlas::glyphs)
+    .field("codepoints", &SdfAtlas::codepoints);
+
+  emscripten::value_object<FontDiagnostic>("FontDiagnostic")
+    .field("ok", &FontDiagnostic::ok)
+    .field("code", &FontDiagnostic::code)
+    .field("table", &FontDiagnostic::table)
+    .field("glyph", &FontDiagnostic::glyph)
+    .field("message", &FontDiagnostic::message);
+
+  emscripten::value_object<OpenedFont>("OpenedFont")
+    .field("handle", &OpenedFont::handle)
+    .field("diagnostic", &OpenedFont::diagnostic);
+
+  emscripten::value_object<FontMetrics>("FontMetrics")
+    .field("unitsPerEm", &FontMetrics::unitsPerEm)
+    .field("ascender", &FontMetrics::ascender)
+    .field("descender", &FontMetrics::descender)
+    .field("lineGap", &FontMetrics::lineGap);
+
+  emscripten::value_object<GlyphMetrics>("GlyphMetrics")
+    .field("advance", &GlyphMetrics::advance)
+    .field("lsb", &GlyphMetrics::lsb);
+
+  emscripten::value_object<VariationAxis>("VariationAxis")
+    .field("tag", &VariationAxis::tag)
+    .field("minValue", &VariationAxis::minValue)
+    .field("defaultValue", &VariationAxis::defaultValue)
+    .field("maxValue", &VariationAxis::maxValue);
+
+  emscripten::value_object<CmapChange>("CmapChange")
+    .field("codepoint", &CmapChange::codepoint)
+    .field("before", &CmapChange::before)
+    .field("after", &CmapChange::after);
+
+  emscripten::value_object<FontDiff>("FontDiff")
+    .field("status", &FontDiff::status)
+    .field("tablesAdded", &FontDiff::tablesAdded)
+    .field("tablesRemoved", &FontDiff::tablesRemoved)
+    .field("tablesChanged", &FontDiff::tablesChanged)
+    .field("changed", &FontDiff::changed)
+    .field("reencoded", &FontDiff::reencoded)
+    .field("added", &FontDiff::added)
+    .field("removed", &FontDiff::removed)
+    .field("cmap", &FontDiff::cmap);
+
+  emscripten::register_vector<uint8_t>("vector<uint8_t>");
+  emscripten::register_vector<std::string>("vector<string>");
+  emscripten::register_vector<AtlasGlyph>("VectorAtlasGlyph");
+  emscripten::register_vector<VariationAxis>("VectorVariationAxis");
+  emscripten::register_vector<CmapChange>("VectorCmapChange");
+  emscripten::register_vector<float>("vector<float>");
+  emscripten::register_map<uint16_t, uint16_t>("map<uint16_t, uint16_t>");
+
   emscripten::register_vector<WBPoint>("VectorWBPoint");
   emscripten::register_vector<std::vector<WBPoint>>("VectorVectorWBPoint");
   emscripten::register_map<uint16_t, std::vector<WBPoint>>("MapUint16VectorWBPoint");
@@ -460,9 +960,46 @@ EMSCRIPTEN_BINDINGS(my_module) {
 
   // Bind functions
   emscripten::function("open_font", &open_font);
+  emscripten::function("save_font", &save_font);
+  emscripten::function("close_font", &close_font);
+  emscripten::function("last_error", &last_error);
+  emscripten::function("set_memory_budget", &set_memory_budget);
+  emscripten::function("set_snapshot_dir", &set_snapshot_dir);
   emscripten::function("find_glyph_index", &find_glyph_index);
   emscripten::function("extract_glyph", &extract_glyph);
+  emscripten::function("variation_axes", &variation_axes);
+  emscripten::function("extract_glyph_at", &extract_glyph_at);
+  emscripten::function("hinted_glyph", &hinted_glyph);
   emscripten::function("glyph_index_to_unicode_map", &glyph_index_to_unicode_map);
   emscripten::function("extract_glyphs", &extract_glyphs);
   emscripten::function("write_entries", &write_entries);
+  emscripten::function("apply_edits", &apply_edits);
+  emscripten::function("commit_edits", &commit_edits);
+  emscripten::function("discard_edits", &discard_edits);
+  emscripten::function("nearest_point", &nearest_point);
+  emscripten::function("points_in_rect", &points_in_rect);
+  emscripten::function("covers", &covers);
+  emscripten::function("missing", &missing);
+  emscripten::function("coverage_ranges", &font_coverage_ranges);
+  emscripten::function("fonts_covering", &fonts_covering);
+  emscripten::function("diff", &diff);
+  emscripten::function("bake_sdf_atlas", &bake_sdf_atlas);
+  emscripten::function("glyph_svg_path", &glyph_svg_path);
+  emscripten::function("glyph_svg_paths", &glyph_svg_paths);
+  emscripten::function("glyph_path_commands", &glyph_path_commands);
+  emscripten::function("glyph_path_commands_batch", &glyph_path_commands_batch);
+  emscripten::function("extract_glyphs_flat", &extract_glyphs_flat);
+  emscripten::function("hinted_glyphs_flat", &hinted_glyphs_flat);
+  emscripten::function("curve_buffers", &curve_buffers);
+  emscripten::function("flatten_glyph", &flatten_glyph);
+  emscripten::function("flatten_glyphs", &flatten_glyphs);
+  emscripten::function("index_font_files", &index_font_files);
+  emscripten::function("index_open_font", &index_open_font);
+  emscripten::function("similar_fonts", &similar_fonts);
+  emscripten::function("similar_glyphs", &similar_glyphs);
+  emscripten::function("font_metrics", &font_metrics);
+  emscripten::function("glyph_advance", &glyph_advance);
+  emscripten::function("kerning", &kerning);
+  emscripten::function("layout", &layout);
+  emscripten::function("layout_codepoints", &layout_codepoints);
 }
@@ -0,0 +1,56 @@
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "bytes.h"
+#include "metrics.h"
+
+using namespace std;
+
+// hhea/hmtx sizes were checked by validate_font; a font without them gets
+// zero metrics rather than an error, since only layout needs them.
+HorizontalMetrics parse_horizontal_metrics(const VerifiedFont &font) {
+  HorizontalMetrics metrics;
+  metrics.font = {font.unitsPerEm, 0, 0, 0};
+  metrics.advances.resize(font.numGlyphs);
+  metrics.lsbs.resize(font.numGlyphs);
+  if (!has_table(font.tables, TABLE_HHEA) || !has_table(font.tables, TABLE_HMTX))
+    return metrics;
+
+  const uint8_t *hhea = table_data(font, TABLE_HHEA);
+  metrics.font.ascender = (int16_t)be16(hhea + 4);
+  metrics.font.descender = (int16_t)be16(hhea + 6);
+  metrics.font.lineGap = (int16_t)be16(hhea + 8);
+  uint16_t numberOfHMetrics = be16(hhea + 34);
+  if (numberOfHMetrics > font.numGlyphs)
+    numberOfHMetrics = font.numGlyphs;
+
+  // longHorMetric pairs are swapped in one pass, then split
+  const uint8_t *hmtx = table_data(font, TABLE_HMTX);
+  vector<uint16_t> pairs(2 * numberOfHMetrics);
+  decode_be16(hmtx, pairs.size(), pairs.data());
+  for (int i = 0; i < numberOfHMetrics; ++i) {
+    metrics.advances[i] = pairs[2 * i];
+    metrics.lsbs[i] = (int16_t)pairs[2 * i + 1];
+  }
+  uint16_t lastAdvance = numberOfHMetrics ? metrics.advances[numberOfHMetrics - 1] : 0;
+  for (int i = numberOfHMetrics; i < font.numGlyphs; ++i)
+    metrics.advances[i] = lastAdvance;
+  decode_be16(hmtx + 4 * numberOfHMetrics, font.numGlyphs - numberOfHMetrics,
+              metrics.lsbs.data() + numberOfHMetrics);
+
+  return metrics;
+}
+
+shared_ptr<const HorizontalMetrics> font_horizontal_metrics(const VerifiedFont &font) {
+  return lazy_cache(font, font.horizontalMetrics, [&] { return parse_horizontal_metrics(font); },
+                    [](const HorizontalMetrics &m) {
+                      return vector_bytes(m.advances) + vector_bytes(m.lsbs);
+                    });
+}
+
+GlyphMetrics glyph_metrics(const HorizontalMetrics &metrics, uint16_t glyph) {
+  if (glyph >= metrics.advances.size())
+    return {0, 0};
+  return {metrics.advances[glyph], metrics.lsbs[glyph]};
+}
@@ -0,0 +1,32 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "font.h"
+
+struct FontMetrics {
+  uint16_t unitsPerEm;
+  int16_t ascender, descender, lineGap;
+};
+
+struct GlyphMetrics {
+  uint16_t advance;
+  int16_t lsb;
+};
+
+// hhea/hmtx expanded to one entry per glyph so lookups are a plain index;
+// glyphs past numberOfHMetrics repeat the last advance as the spec requires.
+struct HorizontalMetrics {
+  FontMetrics font;
+  std::vector<uint16_t> advances;
+  std::vector<int16_t> lsbs;
+};
+
+HorizontalMetrics parse_horizontal_metrics(const VerifiedFont &font);
+std::shared_ptr<const HorizontalMetrics> font_horizontal_metrics(const VerifiedFont &font);
+GlyphMetrics glyph_metrics(const HorizontalMetrics &metrics, uint16_t glyph);
+
+#endif
@@ -0,0 +1,116 @@
+#include <vector>
+
+#include "outline.h"
+
+using namespace std;
+
+// Resolve Contours
+
+// Walks the TrueType on/off-curve sequence of a closed contour. Two off-curve
+// points in a row imply an on-curve point halfway between them, and a contour
+// with no on-curve point at all starts at the midpoint of its last and first
+// points. Cubic off-curve points are taken two at a time and never imply
+// anything.
+void contour_to_segments(const Point *contour, int n, vector<Segment> &out) {
+  if (n == 0)
+    return;
+
+  int first = -1;
+  for (int i = 0; i < n; ++i) {
+    if (contour[i].onCurve) {
+      first = i;
+      break;
+    }
+  }
+
+  float sx, sy;
+  int begin;
+  if (first >= 0) {
+    sx = contour[first].x;
+    sy = contour[first].y;
+    begin = first + 1;
+  } else {
+    sx = (contour[n - 1].x + contour[0].x) * 0.5f;
+    sy = (contour[n - 1].y + contour[0].y) * 0.5f;
+    begin = 0;
+  }
+
+  float curX = sx, curY = sy;
+  float ctrlX = 0, ctrlY = 0;
+  bool haveCtrl = false;
+  float cubicX[2], cubicY[2];
+  int cubicCount = 0;
+  int remaining = (first >= 0) ? n - 1 : n;
+
+  // the closing step revisits the start point as an on-curve point
+  for (int k = 0; k <= remaining; ++k) {
+    float qx, qy;
+    bool on, cubic = false;
+    if (k == remaining) {
+      qx = sx;
+      qy = sy;
+      on = true;
+    } else {
+      const Point &p = contour[(begin + k) % n];
+      qx = p.x;
+      qy = p.y;
+      on = p.onCurve;
+      cubic = p.cubic;
+    }
+
+    if (cubic && !on) {
+      if (cubicCount < 2) {
+        cubicX[cubicCount] = qx;
+        cubicY[cubicCount] = qy;
+        ++cubicCount;
+      }
+      continue;
+    }
+    if (on && cubicCount == 2) {
+      Segment s = {false, curX, curY, cubicX[0], cubicY[0], qx, qy};
+      s.cubic = true;
+      s.cx2 = cubicX[1];
+      s.cy2 = cubicY[1];
+      out.push_back(s);
+      curX = qx;
+      curY = qy;
+      cubicCount = 0;
+      continue;
+    }
+    cubicCount = 0;
+
+    if (on) {
+      if (haveCtrl) {
+        out.push_back({true, curX, curY, ctrlX, ctrlY, qx, qy});
+      } else if (qx != curX || qy != curY) {
+        out.push_back({false, curX, curY, 0, 0, qx, qy});
+      }
+      curX = qx;
+      curY = qy;
+      haveCtrl = false;
+    } else if (haveCtrl) {
+      float mx = (ctrlX + qx) * 0.5f;
+      float my = (ctrlY + qy) * 0.5f;
+      out.push_back({true, curX, curY, ctrlX, ctrlY, mx, my});
+      curX = mx;
+      curY = my;
+      ctrlX = qx;
+      ctrlY = qy;
+    } else {
+      ctrlX = qx;
+      ctrlY = qy;
+      haveCtrl = true;
+    }
+  }
+}
+
+void contour_to_segments(const vector<Point> &contour, vector<Segment> &out) {
+  contour_to_segments(contour.data(), contour.size(), out);
+}
+
+vector<Segment> glyph_to_segments(const vector<vector<Point>> &glyph) {
+  vector<Segment> segments;
+  for (const auto &contour : glyph)
+    contour_to_segments(contour, segments);
+  return segments;
+}
@@ -0,0 +1,25 @@
+#ifndef OUTLINE_H
+#define OUTLINE_H
+
+#include <vector>
+
+#include "font.h"
+
+// One segment of a contour after implied on-curve points are resolved.
+// Lines leave cx/cy unused; cubics (from CFF outlines) have quad false and
+// use cx/cy and cx2/cy2 as their two control points.
+struct Segment {
+  bool quad;
+  float x0, y0;
+  float cx, cy;
+  float x1, y1;
+  bool cubic = false;
+  float cx2 = 0, cy2 = 0;
+};
+
+void contour_to_segments(const Point *points, int n, std::vector<Segment> &out);
+void contour_to_segments(const std::vector<Point> &contour,
+                         std::vector<Segment> &out);
+std::vector<Segment> glyph_to_segments(const std::vector<std::vector<Point>> &glyph);
+
+#endif
@@ -0,0 +1,67 @@
+#ifndef PARALLEL_H
+#define PARALLEL_H
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <thread>
+#include <vector>
+
+// Work spread over the cores. Items are handed out chunk at a time from a
+// shared counter, so slow items do not hold up a fixed share of the rest;
+// the chunk size trades that balance against contention on the counter.
+
+// The wasm build without -pthread cannot start threads (and, built without
+// exceptions, aborts when it tries), so there everything runs serially.
+#if defined(__EMSCRIPTEN__) && !defined(__EMSCRIPTEN_PTHREADS__)
+#define PARALLEL_THREADS 0
+#else
+#define PARALLEL_THREADS 1
+#endif
+
+// One worker per core, but never more than there are chunks
+inline unsigned parallel_workers(size_t count, size_t chunk) {
+#if PARALLEL_THREADS
+  size_t chunks = (count + chunk - 1) / chunk;
+  return std::min<size_t>(std::thread::hardware_concurrency(), chunks);
+#else
+  return 1;
+#endif
+}
+
+// Runs work(state, i) for every i in [0, count). Each worker has its own
+// State, such as an Arena, for as long as it runs. With one worker or less
+// everything runs on the calling thread.
+template <typename State, typename F>
+void parallel_for(size_t count, size_t chunk, F work) {
+  chunk = std::max<size_t>(chunk, 1);
+  std::atomic<size_t> next(0);
+  auto worker = [&]() {
+    State state;
+    for (size_t first = next.fetch_add(chunk); first < count; first = next.fetch_add(chunk)) {
+      size_t last = std::min(first + chunk, count);
+      for (size_t i = first; i < last; ++i)
+        work(state, i);
+    }
+  };
+  unsigned threads = parallel_workers(count, chunk);
+  if (threads <= 1) {
+    worker();
+    return;
+  }
+#if PARALLEL_THREADS
+  std::vector<std::thread> pool;
+  for (unsigned t = 0; t < threads; ++t)
+    pool.emplace_back(worker);
+  for (auto &t : pool)
+    t.join();
+#endif
+}
+
+// Runs work(i) for every i in [0, count), as above
+template <typename F> void parallel_for(size_t count, size_t chunk, F work) {
+  struct NoState {};
+  parallel_for<NoState>(count, chunk, [&](NoState &, size_t i) { work(i); });
+}
+
+#endif
@@ -0,0 +1,117 @@
+#include <cmath>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "outline.h"
+#include "path.h"
+
+using namespace std;
+
+// Implied points land on half units, so one decimal is always exact
+static void append_number(string &out, float v) {
+  char buf[16];
+  if (v == floor(v))
+    snprintf(buf, sizeof(buf), "%d", (int)v);
+  else
+    snprintf(buf, sizeof(buf), "%.1f", v);
+  out += buf;
+}
+
+static void append_xy(string &out, float x, float y) {
+  append_number(out, x);
+  out += ' ';
+  append_number(out, y);
+}
+
+// SVG Path Data
+
+// Coordinates stay in font units with y up; callers flip with a transform.
+string glyph_to_svg(const vector<vector<Point>> &glyph) {
+  string d;
+  vector<Segment> segments;
+  for (const auto &contour : glyph) {
+    segments.clear();
+    contour_to_segments(contour, segments);
+    if (segments.empty())
+      continue;
+
+    if (!d.empty())
+      d += ' ';
+    d += 'M';
+    append_xy(d, segments[0].x0, segments[0].y0);
+    for (const Segment &s : segments) {
+      if (s.cubic) {
+        d += 'C';
+        append_xy(d, s.cx, s.cy);
+        d += ' ';
+        append_xy(d, s.cx2, s.cy2);
+        d += ' ';
+      } else if (s.quad) {
+        d += 'Q';
+        append_xy(d, s.cx, s.cy);
+        d += ' ';
+      } else {
+        d += 'L';
+      }
+      append_xy(d, s.x1, s.y1);
+    }
+    d += 'Z';
+  }
+  return d;
+}
+
+// Binary Command Stream
+
+static void append_contour_commands(const Point *points, int n,
+                                    vector<Segment> &segments, PathBuffer &out) {
+  segments.clear();
+  contour_to_segments(points, n, segments);
+  if (segments.empty())
+    return;
+
+  out.verbs.push_back(PATH_MOVE);
+  out.coords.push_back(segments[0].x0);
+  out.coords.push_back(segments[0].y0);
+  for (const Segment &s : segments) {
+    if (s.cubic) {
+      out.verbs.push_back(PATH_CUBIC);
+      out.coords.push_back(s.cx);
+      out.coords.push_back(s.cy);
+      out.coords.push_back(s.cx2);
+      out.coords.push_back(s.cy2);
+    } else if (s.quad) {
+      out.verbs.push_back(PATH_QUAD);
+      out.coords.push_back(s.cx);
+      out.coords.push_back(s.cy);
+    } else {
+      out.verbs.push_back(PATH_LINE);
+    }
+    out.coords.push_back(s.x1);
+    out.coords.push_back(s.y1);
+  }
+  out.verbs.push_back(PATH_CLOSE);
+}
+
+void append_glyph_commands(const vector<vector<Point>> &glyph,
+                           PathBuffer &out) {
+  out.verbStarts.push_back(out.verbs.size());
+  out.coordStarts.push_back(out.coords.size());
+
+  vector<Segment> segments;
+  for (const auto &contour : glyph)
+    append_contour_commands(contour.data(), contour.size(), segments, out);
+}
+
+void append_outline_commands(const GlyphOutline &outline, PathBuffer &out) {
+  out.verbStarts.push_back(out.verbs.size());
+  out.coordStarts.push_back(out.coords.size());
+
+  static thread_local vector<Segment> segments;
+  uint32_t start = 0;
+  for (int c = 0; c < outline.numContours; ++c) {
+    uint32_t end = outline.contourEnds[c] + 1;
+    append_contour_commands(outline.points + start, end - start, segments, out);
+    start = end;
+  }
+}
@@ -0,0 +1,33 @@
+#ifndef PATH_H
+#define PATH_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "decode.h"
+#include "font.h"
+
+enum PathVerb : uint8_t {
+  PATH_MOVE = 0,  // x y
+  PATH_LINE = 1,  // x y
+  PATH_QUAD = 2,  // cx cy x y
+  PATH_CLOSE = 3, // no coordinates
+  PATH_CUBIC = 4, // c1x c1y c2x c2y x y
+};
+
+// Flat command stream for one or more glyphs. Glyph i occupies
+// verbs[verbStarts[i] .. verbStarts[i + 1]) and coords from coordStarts[i].
+struct PathBuffer {
+  std::vector<uint8_t> verbs;
+  std::vector<float> coords;
+  std::vector<uint32_t> verbStarts;
+  std::vector<uint32_t> coordStarts;
+};
+
+std::string glyph_to_svg(const std::vector<std::vector<Point>> &glyph);
+void append_glyph_commands(const std::vector<std::vector<Point>> &glyph,
+                           PathBuffer &out);
+void append_outline_commands(const GlyphOutline &outline, PathBuffer &out);
+
+#endif
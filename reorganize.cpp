@@ -3,10 +3,11 @@
 #include <algorithm>
 #include <cstdint>
 #include <cstring>
-#include <iostream>
-#include <iomanip>
 #include <string>
 
+#include "reorganize.h"
+#include "tables.h"
+
 // Align x up to multiple of a
 static uint32_t align4(uint32_t x) {
     return (x + 3) & ~3u;
@@ -58,29 +59,151 @@ static uint32_t compute_checksum(const std::vector<uint8_t>& data) {
     return sum;
 }
 
-struct TableRecord {
-    char     tag[4];
-    uint32_t checksum;
-    uint32_t offset;
-    uint32_t length;
-};
-
 struct Table {
     TableRecord rec;
     std::vector<uint8_t> data;
 };
 
-int reorganize(std::string filename) {
-    // if (argc != 3) {
-    //     std::cerr << "Usage: " << argv[0]
-    //               << " <input.ttf> <output.ttf>\n";
-    //     return 1;
-    // }
-    const char* outPath = "output.ttf";
+static uint16_t get16(const std::vector<uint8_t>& data, size_t offset) {
+    return (uint16_t(data[offset]) << 8) | data[offset + 1];
+}
+
+static uint32_t get32(const std::vector<uint8_t>& data, size_t offset) {
+    return (uint32_t(get16(data, offset)) << 16) | get16(data, offset + 2);
+}
+
+static void put16(std::vector<uint8_t>& data, size_t offset, uint16_t v) {
+    data[offset] = uint8_t(v >> 8);
+    data[offset + 1] = uint8_t(v);
+}
+
+static void put32(std::vector<uint8_t>& data, size_t offset, uint32_t v) {
+    put16(data, offset, uint16_t(v >> 16));
+    put16(data, offset + 2, uint16_t(v));
+}
+
+// Glyph Slots
+
+uint32_t glyph_slot_size(uint32_t length) {
+    if (length == 0)
+        return 0;
+    return align4(length + std::max<uint32_t>(length / 4, 40));
+}
+
+uint32_t glyph_data_length(const uint8_t* g, uint32_t available) {
+    if (available < 10)
+        return available;
+    auto u16 = [&](uint32_t o) { return (uint16_t(g[o]) << 8) | g[o + 1]; };
+    int16_t numContours = int16_t(u16(0));
+    uint32_t p = 10;
+
+    if (numContours < 0) {
+        // components, then the instructions if any component asks for them
+        uint16_t flags, all = 0;
+        do {
+            if (p + 4 > available)
+                return available;
+            flags = u16(p);
+            all |= flags;
+            p += 4;
+            p += (flags & 0x0001) ? 4 : 2;      // ARG_1_AND_2_ARE_WORDS
+            if (flags & 0x0008) p += 2;         // WE_HAVE_A_SCALE
+            else if (flags & 0x0040) p += 4;    // WE_HAVE_AN_X_AND_Y_SCALE
+            else if (flags & 0x0080) p += 8;    // WE_HAVE_A_TWO_BY_TWO
+        } while (flags & 0x0020);               // MORE_COMPONENTS
+        if (all & 0x0100) {                     // WE_HAVE_INSTRUCTIONS
+            if (p + 2 > available)
+                return available;
+            p += 2 + u16(p);
+        }
+        return std::min(p, available);
+    }
+
+    p += 2 * numContours;
+    if (p + 2 > available)
+        return available;
+    uint32_t numPoints = numContours ? u16(p - 2) + 1 : 0;
+    p += 2 + u16(p);
+
+    uint32_t count = 0, coordBytes = 0;
+    while (count < numPoints) {
+        if (p >= available)
+            return available;
+        uint8_t flag = g[p++];
+        uint32_t repeat = 1;
+        if (flag & 0x08) {
+            if (p >= available)
+                return available;
+            repeat += g[p++];
+        }
+        uint32_t perPoint = ((flag & 0x02) ? 1 : (flag & 0x10) ? 0 : 2) +
+                            ((flag & 0x04) ? 1 : (flag & 0x20) ? 0 : 2);
+        coordBytes += perPoint * repeat;
+        count += repeat;
+    }
+    return std::min(p + coordBytes, available);
+}
+
+// Lays glyf out again with each glyph in a slot of the layout's size and
+// rewrites loca (and head's loca format) to match. Fonts without glyf, such
+// as CFF ones, are left alone.
+static FontDiagnostic layout_glyf(std::vector<Table>& tables, GlyfLayout layout) {
+    Table *head = nullptr, *maxp = nullptr, *loca = nullptr, *glyf = nullptr;
+    for (Table& t : tables) {
+        if (t.rec.tag == TAG_HEAD) head = &t;
+        else if (t.rec.tag == TAG_MAXP) maxp = &t;
+        else if (t.rec.tag == TAG_LOCA) loca = &t;
+        else if (t.rec.tag == TAG_GLYF) glyf = &t;
+    }
+    if (!glyf || !loca)
+        return {true, FONT_OK, "", -1, ""};
+    if (!head || head->data.size() < 54)
+        return {false, FONT_BAD_HEAD, "head", -1, "head table truncated"};
+    if (!maxp || maxp->data.size() < 6)
+        return {false, FONT_MISSING_TABLE, "maxp", -1, "maxp table truncated"};
+
+    uint16_t numGlyphs = get16(maxp->data, 4);
+    bool shortLoca = get16(head->data, 50) == 0;
+    if (loca->data.size() < size_t(numGlyphs + 1) * (shortLoca ? 2 : 4))
+        return {false, FONT_BAD_LOCA, "loca", -1, "loca shorter than numGlyphs + 1 entries"};
+    auto offset = [&](int i) {
+        uint32_t o = shortLoca ? uint32_t(get16(loca->data, 2 * i)) * 2 : get32(loca->data, 4 * i);
+        return std::min<uint32_t>(o, glyf->data.size());
+    };
+
+    std::vector<uint8_t> packed;
+    std::vector<uint32_t> starts(numGlyphs + 1);
+    for (int i = 0; i < numGlyphs; ++i) {
+        uint32_t start = offset(i), end = std::max(offset(i + 1), start);
+        uint32_t length = glyph_data_length(glyf->data.data() + start, end - start);
+        uint32_t slot = layout == GLYF_SLACK ? glyph_slot_size(length) : align4(length);
+        starts[i] = packed.size();
+        packed.insert(packed.end(), glyf->data.begin() + start, glyf->data.begin() + start + length);
+        packed.resize(starts[i] + slot, 0);
+    }
+    starts[numGlyphs] = packed.size();
+
+    // the editing layout stays long so a grown slot can never overflow loca
+    bool longLoca = layout == GLYF_SLACK || packed.size() > 0x1FFFE;
+    loca->data.assign(size_t(numGlyphs + 1) * (longLoca ? 4 : 2), 0);
+    for (int i = 0; i <= numGlyphs; ++i) {
+        if (longLoca)
+            put32(loca->data, 4 * i, starts[i]);
+        else
+            put16(loca->data, 2 * i, uint16_t(starts[i] / 2));
+    }
+    put16(head->data, 50, longLoca ? 1 : 0); // indexToLocFormat
+    glyf->data = std::move(packed);
+    return {true, FONT_OK, "", -1, ""};
+}
+
+FontDiagnostic reorganize(std::string filename, std::string output, GlyfLayout layout) {
+    const char* outPath = output.c_str();
 
     // 1) Open input and read OffsetTable
     std::ifstream in(filename, std::ios::binary);
-    if (!in) { perror("Opening input"); return 1; }
+    if (!in)
+        return {false, FONT_NOT_FOUND, "", -1, "Font not found"};
 
     // sfnt version
     uint32_t sfntVersion = re_read_u32(in);
@@ -96,7 +219,7 @@ int reorganize(std::string filename) {
     for (int i = 0; i < numTables; ++i) {
         in.seekg(dirStart + std::streamoff(16 * i), std::ios::beg);
         Table t;
-        in.read(reinterpret_cast<char*>(t.rec.tag), 4);
+        t.rec.tag      = re_read_u32(in);
         t.rec.checksum = re_read_u32(in);
         t.rec.offset   = re_read_u32(in);
         t.rec.length   = re_read_u32(in);
@@ -108,27 +231,18 @@ int reorganize(std::string filename) {
         tables.push_back(std::move(t));
     }
 
-    std::cerr << "Tables in input font:\n";
-    for (auto &tbl : tables) {
-        std::string tag(tbl.rec.tag, 4);
-        std::cerr << "  “" << tag << "” (offset=" << tbl.rec.offset
-                  << ", length=" << tbl.rec.length << ")\n";
-    }
-
-    // 3) Extract glyf table
-    auto it = std::find_if(tables.begin(), tables.end(),
-        [](auto &t){ return std::memcmp(t.rec.tag, "glyf", 4) == 0; });
-    if (it == tables.end()) {
-        std::cerr << "Error: glyf table not found in input font\n";
-        return 1;
-    }
-    Table glyfTable = *it;
-    tables.erase(it);
+    if (!in)
+        return {false, FONT_TRUNCATED, "", -1, "a table runs past the end of the file"};
 
-    // 4) (Optional) keep the other tables in original order, then append glyf last
-    tables.push_back(std::move(glyfTable));
+    // 3) glyf goes last so edits can grow it in place; CFF fonts have none
+    //    and are only re-laid out with head first
     uint16_t newNumTables = uint16_t(tables.size());
 
+    // 4) Give every glyph its slot, or pack them for saving
+    FontDiagnostic diag = layout_glyf(tables, layout);
+    if (!diag.ok)
+        return diag;
+
     // 5) Recompute offsets, lengths, checksums
     //    Directory size = 12 + 16 * numTables
     uint32_t dirSize = 12 + 16u * newNumTables;
@@ -136,13 +250,13 @@ int reorganize(std::string filename) {
 
     // Sort so head is first, glyf is last (head must exist!)
     std::sort(tables.begin(), tables.end(), [](auto &a, auto &b){
-        bool aHead = std::memcmp(a.rec.tag,"head",4)==0;
-        bool bHead = std::memcmp(b.rec.tag,"head",4)==0;
+        bool aHead = a.rec.tag == TAG_HEAD;
+        bool bHead = b.rec.tag == TAG_HEAD;
         if (aHead != bHead) return aHead;       // head first
-        bool aGlyf = std::memcmp(a.rec.tag,"glyf",4)==0;
-        bool bGlyf = std::memcmp(b.rec.tag,"glyf",4)==0;
+        bool aGlyf = a.rec.tag == TAG_GLYF;
+        bool bGlyf = b.rec.tag == TAG_GLYF;
         if (aGlyf != bGlyf) return !aGlyf;     // glyf last
-        return std::memcmp(a.rec.tag, b.rec.tag, 4) < 0;
+        return a.rec.tag < b.rec.tag;  // big-endian tags sort bytewise
     });
 
     // Assign new offsets & recalc checksums
@@ -175,7 +289,7 @@ int reorganize(std::string filename) {
 
     // TableRecords
     for (auto &tbl : tables) {
-        tmp.insert(tmp.end(), tbl.rec.tag, tbl.rec.tag+4);
+        push32(tbl.rec.tag);
         push32(tbl.rec.checksum);
         push32(tbl.rec.offset);
         push32(tbl.rec.length);
@@ -194,15 +308,13 @@ int reorganize(std::string filename) {
     // Find the head table's data offset (already in tables[].rec.offset)
     uint32_t headDataOffset = 0;
     for (auto &tbl : tables) {
-        if (std::memcmp(tbl.rec.tag, "head", 4) == 0) {
+        if (tbl.rec.tag == TAG_HEAD) {
             headDataOffset = tbl.rec.offset;
             break;
         }
     }
-    if (headDataOffset == 0) {
-        std::cerr << "Error: head table not found\n";
-        return 1;
-    }
+    if (headDataOffset == 0)
+        return {false, FONT_MISSING_TABLE, "head", -1, "head table not found"};
     // checkSumAdjustment lives at bytes 8..11 of the head table data
     for (int i = 0; i < 4; ++i) {
         tmp[headDataOffset + 8 + i] = 0;
@@ -230,48 +342,10 @@ int reorganize(std::string filename) {
 
     // 7) Write tmp buffer out
     std::ofstream out(outPath, std::ios::binary);
-    if (!out) { perror("Opening output"); return 1; }
     out.write(reinterpret_cast<char*>(tmp.data()), tmp.size());
     out.close();
+    if (!out)
+        return {false, FONT_IO, "", -1, "could not write " + output};
 
-    std::cout << "Reordered glyf to end and wrote: " << outPath << "\n";
-
-
-    std::ifstream nin(outPath, std::ios::binary);
-    if (!in) { perror("Opening input"); return 1; }
-
-    // sfnt version
-    sfntVersion = re_read_u32(nin);
-    numTables   = re_read_u16(nin);
-    searchRange = re_read_u16(nin);
-    entrySelector = re_read_u16(nin);
-    rangeShift  = re_read_u16(nin);
-
-    // 2) Read all table records
-    std::vector<Table> tables2;
-    tables2.reserve(numTables);
-    dirStart = nin.tellg();  // after header
-    for (int i = 0; i < numTables; ++i) {
-        nin.seekg(dirStart + std::streamoff(16 * i), std::ios::beg);
-        Table t;
-        nin.read(reinterpret_cast<char*>(t.rec.tag), 4);
-        t.rec.checksum = re_read_u32(nin);
-        t.rec.offset   = re_read_u32(nin);
-        t.rec.length   = re_read_u32(nin);
-
-        // Read the table data
-        nin.seekg(t.rec.offset, std::ios::beg);
-        t.data.resize(t.rec.length);
-        nin.read(reinterpret_cast<char*>(t.data.data()), t.rec.length);
-        tables2.push_back(std::move(t));
-    }
-
-    std::cerr << "Tables in input font:\n";
-    for (auto &tbl : tables2) {
-        std::string tag(tbl.rec.tag, 4);
-        std::cerr << "  “" << tag << "” (offset=" << tbl.rec.offset
-                  << ", length=" << tbl.rec.length << ")\n";
-    }
-
-    return 0;
+    return {true, FONT_OK, "", -1, ""};
 }
@@ -1,7 +1,30 @@
 #ifndef REORGANIZE_H
 #define REORGANIZE_H
 
+#include <cstdint>
 #include <string>
-int reorganize(std::string filename);
+
+#include "validate.h"
+
+// How reorganize lays out glyf. GLYF_SLACK is the editing layout: every
+// glyph sits in a slot of glyph_slot_size() bytes, zero-filled past its
+// data, and loca is long, so an edit that adds a few points rewrites only
+// its own slot. GLYF_TIGHT packs the glyphs back together for saving.
+enum GlyfLayout {
+  GLYF_SLACK,
+  GLYF_TIGHT,
+};
+
+// Rewrites filename to output with head first and glyf last
+FontDiagnostic reorganize(std::string filename, std::string output,
+                          GlyfLayout layout = GLYF_SLACK);
+
+// Slot for a glyph of length bytes in the editing layout: a quarter more,
+// and at least room for eight more points. Empty glyphs stay empty.
+uint32_t glyph_slot_size(uint32_t length);
+
+// Bytes a glyph's data takes, found by walking it, so the zeros after it in
+// a slot are not counted; available when the glyph runs past it
+uint32_t glyph_data_length(const uint8_t *glyph, uint32_t available);
 
 #endif
@@ -0,0 +1,101 @@
+#include <algorithm>
+#include <vector>
+
+#include "session.h"
+
+using namespace std;
+
+// Publishing
+
+shared_ptr<const VerifiedFont> session_font(const FontSession &session) {
+  return atomic_load(&session.font);
+}
+
+void publish_font(FontSession &session, shared_ptr<const VerifiedFont> font) {
+  atomic_store(&session.font, move(font));
+}
+
+size_t session_resident_bytes(const FontSession &session) {
+  shared_ptr<const VerifiedFont> font = session_font(session);
+  size_t bytes = vector_bytes(font->data) + vector_bytes(font->loca);
+  for (const auto &pair : session.pendingEdits)
+    bytes += vector_bytes(pair.second);
+  return bytes;
+}
+
+// Kept up as the caches change, so this is cheap enough for every check
+size_t session_cache_bytes(const FontSession &session) {
+  size_t bytes = session.grids.bytes + session.polylines.bytes + session.atlas.bytes +
+                 session_font(session)->cacheBytes.bytes;
+  if (session.aggregates) {
+    bytes += vector_bytes(session.aggregates->advances) +
+             vector_bytes(session.aggregates->lsbs);
+    for (const ExtremaTree &tree : session.aggregates->trees)
+      bytes += vector_bytes(tree.nodes);
+  }
+  if (session.snapshot)
+    bytes += vector_bytes(session.snapshot->bytes);
+  return bytes;
+}
+
+// Eviction
+
+void release_session_caches(FontSession &session) {
+  session.grids = GlyphGrids();
+  session.polylines = PolylineCache();
+  session.atlas = AtlasCache();
+  session.aggregates.reset();
+  session.snapshot.reset(); // snapshotUsable stays set so it is reloaded
+  release_font_caches(*session_font(session));
+}
+
+void enforce_budget(FontSessions &sessions, const FontSession *keep) {
+  vector<pair<FontSession *, size_t>> caches;
+  size_t total = 0;
+  for (auto &pair : sessions.open) {
+    FontSession *session = pair.second.get();
+    size_t cached = session_cache_bytes(*session);
+    total += session_resident_bytes(*session) + cached;
+    if (session != keep && cached > 0)
+      caches.push_back({session, cached});
+  }
+  if (total <= sessions.budget)
+    return;
+
+  sort(caches.begin(), caches.end(), [](const auto &a, const auto &b) {
+    return a.first->lastUse < b.first->lastUse;
+  });
+  for (const auto &entry : caches) {
+    release_session_caches(*entry.first);
+    total -= entry.second - session_cache_bytes(*entry.first);
+    if (total <= sessions.budget)
+      break;
+  }
+}
+
+FontSession *use_session(FontSessions &sessions, int handle) {
+  auto it = sessions.open.find(handle);
+  if (it == sessions.open.end())
+    return nullptr;
+  FontSession *session = it->second.get();
+  session->lastUse = ++sessions.clock;
+  return session;
+}
+
+const FontSnapshot *session_snapshot(FontSessions &sessions, FontSession &session) {
+  if (!session.snapshotUsable)
+    return nullptr;
+  if (!session.snapshot) {
+    auto snapshot = make_shared<FontSnapshot>();
+    if (sessions.snapshotDir.empty() ||
+        !load_snapshot(snapshot_path(sessions.snapshotDir, session.contentHash),
+                       session.contentHash, *snapshot) ||
+        snapshot->header.numGlyphs != session_font(session)->numGlyphs) {
+      session.snapshotUsable = false;
+      return nullptr;
+    }
+    session.snapshot = snapshot;
+    enforce_budget(sessions, &session);
+  }
+  return session.snapshot.get();
+}
@@ -0,0 +1,83 @@
+#ifndef SESSION_H
+#define SESSION_H
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <string>
+
+#include "aggregates.h"
+#include "atlas.h"
+#include "edit.h"
+#include "flatten.h"
+#include "font.h"
+#include "snapshot.h"
+#include "spatial.h"
+#include "validate.h"
+
+// One open font: its reorganized working copy and everything the bindings
+// keep for it. The session's caches (grids, polylines, SDFs, aggregates,
+// snapshot) and the font's own parsed tables and CFF subroutine tokens are
+// rebuilt on demand, so any of them can be dropped to stay inside the
+// budget; the font bytes and pending edits are never dropped.
+//
+// font is the published version of the font. Its bytes are never changed
+// once published: a commit builds the edited font as a new version and
+// swaps it in, and a version is freed when the last reader holding it lets
+// go. Dropping its caches only resets their pointers, so readers holding
+// one keep it.
+struct FontSession {
+  int handle;
+  std::string filename;
+  std::shared_ptr<const VerifiedFont> font; // read with session_font
+  PendingEdits pendingEdits; // editor deltas not yet written to the font
+  GlyphGrids grids;          // hit-test grids, built on first query per glyph
+  PolylineCache polylines;   // flattened outlines, built on first request per tolerance
+  AtlasCache atlas;
+  std::unique_ptr<FontAggregates> aggregates; // built on the first write
+  std::shared_ptr<const FontSnapshot> snapshot;
+  uint64_t contentHash = 0;
+  bool snapshotUsable = false; // unedited, and a snapshot was built for contentHash
+  uint64_t lastUse = 0;
+};
+
+// Every open font, sharing one memory budget. When the fonts' combined
+// size goes over it, the caches of the least recently used fonts are
+// released first.
+struct FontSessions {
+  std::map<int, std::unique_ptr<FontSession>> open;
+  int nextHandle = 1;
+  uint64_t clock = 0;
+  size_t budget = 64u << 20;
+  std::string snapshotDir; // empty: the snapshot cache is off
+};
+
+// Result of open_font; handle is 0 when the font was rejected
+struct OpenedFont {
+  int handle;
+  FontDiagnostic diagnostic;
+};
+
+// The published version, loaded atomically so any thread may call it while
+// a commit publishes; keep the pointer for as long as the read lasts
+std::shared_ptr<const VerifiedFont> session_font(const FontSession &session);
+void publish_font(FontSession &session, std::shared_ptr<const VerifiedFont> font);
+
+size_t session_resident_bytes(const FontSession &session);
+size_t session_cache_bytes(const FontSession &session);
+void release_session_caches(FontSession &session);
+
+// Releases caches of other fonts, oldest use first, until everything open
+// fits the budget again or only keep's caches are left. Call it after a
+// font's caches or pending edits grow; nothing else can push the total up.
+void enforce_budget(FontSessions &sessions, const FontSession *keep);
+
+// Marks the font used; null for an unknown handle
+FontSession *use_session(FontSessions &sessions, int handle);
+
+// The snapshot while the font is unedited, reloaded from the snapshot
+// directory if the budget dropped it; null when there is none
+const FontSnapshot *session_snapshot(FontSessions &sessions, FontSession &session);
+
+#endif
@@ -0,0 +1,200 @@
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "arena.h"
+#include "bytes.h"
+#include "cmap.h"
+#include "decode.h"
+#include "snapshot.h"
+
+using namespace std;
+
+static_assert(sizeof(SnapshotHeader) == 40, "snapshot header is written as-is");
+
+string snapshot_path(const string &dir, uint64_t contentHash) {
+  char name[24];
+  snprintf(name, sizeof(name), "%016llx.snap", (unsigned long long)contentHash);
+  return dir + "/" + name;
+}
+
+template <typename T> static void append(vector<uint8_t> &out, const T *data, size_t count) {
+  const uint8_t *p = reinterpret_cast<const uint8_t *>(data);
+  out.insert(out.end(), p, p + count * sizeof(T));
+}
+
+// Building
+
+bool build_snapshot(const VerifiedFont &font, uint64_t contentHash, vector<uint8_t> &bytes) {
+  Arena arena;
+  OutlineBatch batch = decode_outlines(font, 0, font.numGlyphs, arena);
+
+  vector<uint32_t> pointStarts, contourStarts;
+  vector<int16_t> coords;
+  vector<uint16_t> contourEnds;
+  vector<uint8_t> flags;
+  pointStarts.reserve(batch.count + 1);
+  contourStarts.reserve(batch.count + 1);
+  for (uint32_t i = 0; i < batch.count; ++i) {
+    const GlyphOutline &g = batch.glyphs[i];
+    pointStarts.push_back(flags.size());
+    contourStarts.push_back(contourEnds.size());
+    for (uint32_t k = 0; k < g.numPoints; ++k) {
+      const Point &p = g.points[k];
+      if (p.x != (int16_t)p.x || p.y != (int16_t)p.y)
+        return false;
+      coords.push_back(p.x);
+      coords.push_back(p.y);
+      flags.push_back((p.onCurve ? SNAPSHOT_ON_CURVE : 0) | (p.cubic ? SNAPSHOT_CUBIC : 0));
+    }
+    contourEnds.insert(contourEnds.end(), g.contourEnds, g.contourEnds + g.numContours);
+  }
+  pointStarts.push_back(flags.size());
+  contourStarts.push_back(contourEnds.size());
+
+  map<uint32_t, uint16_t> mappings = char_map_forward(*font_char_map(font));
+  vector<uint32_t> codepoints;
+  vector<uint16_t> mappedGlyphs;
+  for (const auto &mapping : mappings) {
+    codepoints.push_back(mapping.first);
+    mappedGlyphs.push_back(mapping.second);
+  }
+
+  SnapshotHeader header = {SNAPSHOT_MAGIC, SNAPSHOT_VERSION, contentHash,
+                           batch.count, (uint32_t)flags.size(),
+                           (uint32_t)contourEnds.size(), (uint32_t)mappings.size(),
+                           font.unitsPerEm, 0};
+  bytes.clear();
+  append(bytes, &header, 1);
+  append(bytes, pointStarts.data(), pointStarts.size());
+  append(bytes, contourStarts.data(), contourStarts.size());
+  append(bytes, coords.data(), coords.size());
+  append(bytes, codepoints.data(), codepoints.size());
+  append(bytes, contourEnds.data(), contourEnds.size());
+  append(bytes, mappedGlyphs.data(), mappedGlyphs.size());
+  append(bytes, flags.data(), flags.size());
+  return true;
+}
+
+bool write_snapshot(const string &path, const vector<uint8_t> &bytes) {
+  // written beside the target and renamed, so a reader never sees half a file
+  string temp = path + ".tmp";
+  {
+    ofstream out(temp, ios::binary | ios::trunc);
+    if (!out)
+      return false;
+    out.write(reinterpret_cast<const char *>(bytes.data()), bytes.size());
+    if (!out)
+      return false;
+  }
+  return rename(temp.c_str(), path.c_str()) == 0;
+}
+
+// Loading
+
+bool open_snapshot(vector<uint8_t> bytes, uint64_t contentHash, FontSnapshot &snapshot) {
+  snapshot.bytes = move(bytes);
+  const vector<uint8_t> &b = snapshot.bytes;
+  if (b.size() < sizeof(SnapshotHeader))
+    return false;
+  SnapshotHeader &h = snapshot.header;
+  memcpy(&h, b.data(), sizeof(h));
+  if (h.magic != SNAPSHOT_MAGIC || h.version != SNAPSHOT_VERSION || h.contentHash != contentHash)
+    return false;
+
+  uint64_t size = sizeof(SnapshotHeader) + 8ull * ((uint64_t)h.numGlyphs + 1) +
+                  5ull * h.numPoints + 2ull * h.numContours + 6ull * h.numMappings;
+  if (size != b.size())
+    return false;
+
+  const uint8_t *p = b.data() + sizeof(SnapshotHeader);
+  snapshot.pointStarts = reinterpret_cast<const uint32_t *>(p);
+  p += 4 * (h.numGlyphs + 1);
+  snapshot.contourStarts = reinterpret_cast<const uint32_t *>(p);
+  p += 4 * (h.numGlyphs + 1);
+  snapshot.coords = reinterpret_cast<const int16_t *>(p);
+  p += 4 * h.numPoints;
+  snapshot.codepoints = reinterpret_cast<const uint32_t *>(p); // still 4-aligned
+  p += 4 * h.numMappings;
+  snapshot.contourEnds = reinterpret_cast<const uint16_t *>(p);
+  p += 2 * h.numContours;
+  snapshot.mappedGlyphs = reinterpret_cast<const uint16_t *>(p);
+  p += 2 * h.numMappings;
+  snapshot.flags = p;
+
+  // the glyph index must be monotonic and every contour must end inside
+  // its own glyph, so snapshot_glyph can slice without checks
+  if (snapshot.pointStarts[0] != 0 || snapshot.contourStarts[0] != 0 ||
+      snapshot.pointStarts[h.numGlyphs] != h.numPoints ||
+      snapshot.contourStarts[h.numGlyphs] != h.numContours)
+    return false;
+  for (uint32_t g = 0; g < h.numGlyphs; ++g) {
+    uint32_t points = snapshot.pointStarts[g + 1] - snapshot.pointStarts[g];
+    uint32_t first = snapshot.contourStarts[g], last = snapshot.contourStarts[g + 1];
+    if (snapshot.pointStarts[g + 1] < snapshot.pointStarts[g] || last < first)
+      return false;
+    uint32_t previous = 0;
+    for (uint32_t c = first; c < last; ++c) {
+      uint32_t end = snapshot.contourEnds[c] + 1u;
+      if (end <= previous || end > points)
+        return false;
+      previous = end;
+    }
+    if (previous != points)
+      return false;
+  }
+  for (uint32_t i = 1; i < h.numMappings; ++i) {
+    if (snapshot.codepoints[i] <= snapshot.codepoints[i - 1])
+      return false;
+  }
+  return true;
+}
+
+bool load_snapshot(const string &path, uint64_t contentHash, FontSnapshot &snapshot) {
+  vector<uint8_t> bytes;
+  if (!read_file_bytes(path, bytes))
+    return false;
+  return open_snapshot(move(bytes), contentHash, snapshot);
+}
+
+// Queries
+
+vector<vector<Point>> snapshot_glyph(const FontSnapshot &snapshot, uint16_t glyph) {
+  if (glyph >= snapshot.header.numGlyphs)
+    return {};
+  uint32_t base = snapshot.pointStarts[glyph];
+  uint32_t first = snapshot.contourStarts[glyph], last = snapshot.contourStarts[glyph + 1];
+
+  vector<vector<Point>> contours(last - first);
+  uint32_t start = 0;
+  for (uint32_t c = first; c < last; ++c) {
+    uint32_t end = snapshot.contourEnds[c] + 1u;
+    vector<Point> &contour = contours[c - first];
+    contour.resize(end - start);
+    for (uint32_t k = start; k < end; ++k) {
+      uint8_t f = snapshot.flags[base + k];
+      contour[k - start] = {snapshot.coords[2 * (base + k)], snapshot.coords[2 * (base + k) + 1],
+                            (f & SNAPSHOT_ON_CURVE) != 0, (f & SNAPSHOT_CUBIC) != 0};
+    }
+    start = end;
+  }
+  return contours;
+}
+
+uint16_t snapshot_lookup(const FontSnapshot &snapshot, uint32_t codepoint) {
+  const uint32_t *begin = snapshot.codepoints;
+  const uint32_t *end = begin + snapshot.header.numMappings;
+  const uint32_t *it = lower_bound(begin, end, codepoint);
+  return it != end && *it == codepoint ? snapshot.mappedGlyphs[it - begin] : 0;
+}
+
+map<uint16_t, vector<uint16_t>> snapshot_reverse_map(const FontSnapshot &snapshot) {
+  map<uint16_t, vector<uint16_t>> glyphToUnicode;
+  for (uint32_t i = 0; i < snapshot.header.numMappings && snapshot.codepoints[i] <= 0xFFFF; ++i)
+    glyphToUnicode[snapshot.mappedGlyphs[i]].push_back(snapshot.codepoints[i]);
+  return glyphToUnicode;
+}
@@ -0,0 +1,74 @@
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "font.h"
+
+static const uint32_t SNAPSHOT_MAGIC = 0x53465454; // "TTFS" little-endian
+static const uint32_t SNAPSHOT_VERSION = 2;
+
+// Snapshot file layout, in host byte order (a host with the other byte
+// order sees a wrong magic and rebuilds):
+//   SnapshotHeader
+//   uint32 pointStarts[numGlyphs + 1]    glyph order, into the point arrays
+//   uint32 contourStarts[numGlyphs + 1]  into contourEnds
+//   int16  coords[2 * numPoints]         x, y in font units
+//   uint32 codepoints[numMappings]       ascending, all of Unicode
+//   uint16 contourEnds[numContours]      relative to the glyph's first point
+//   uint16 mappedGlyphs[numMappings]
+//   uint8  flags[numPoints]              SNAPSHOT_ON_CURVE | SNAPSHOT_CUBIC
+struct SnapshotHeader {
+  uint32_t magic;
+  uint32_t version;
+  uint64_t contentHash; // of the font file the snapshot was built from
+  uint32_t numGlyphs, numPoints, numContours, numMappings;
+  uint32_t unitsPerEm;
+  uint32_t reserved;
+};
+
+enum SnapshotFlag {
+  SNAPSHOT_ON_CURVE = 1,
+  SNAPSHOT_CUBIC = 2,
+};
+
+// A snapshot file read into memory in one go. The arrays point into bytes,
+// so a FontSnapshot is filled in place and not copied.
+struct FontSnapshot {
+  std::vector<uint8_t> bytes;
+  SnapshotHeader header;
+  const uint32_t *pointStarts;
+  const uint32_t *contourStarts;
+  const int16_t *coords;
+  const uint32_t *codepoints;
+  const uint16_t *contourEnds;
+  const uint16_t *mappedGlyphs;
+  const uint8_t *flags;
+
+  FontSnapshot() = default;
+  FontSnapshot(const FontSnapshot &) = delete;
+  FontSnapshot &operator=(const FontSnapshot &) = delete;
+};
+
+std::string snapshot_path(const std::string &dir, uint64_t contentHash);
+
+// Decodes every outline and the whole cmap of a validated font. Fails (false)
+// when a coordinate does not fit in int16.
+bool build_snapshot(const VerifiedFont &font, uint64_t contentHash,
+                    std::vector<uint8_t> &bytes);
+bool write_snapshot(const std::string &path, const std::vector<uint8_t> &bytes);
+
+// Takes ownership of bytes and checks that every array fits. Any mismatch,
+// including a different content hash, leaves the snapshot unusable.
+bool open_snapshot(std::vector<uint8_t> bytes, uint64_t contentHash, FontSnapshot &snapshot);
+bool load_snapshot(const std::string &path, uint64_t contentHash, FontSnapshot &snapshot);
+
+std::vector<std::vector<Point>> snapshot_glyph(const FontSnapshot &snapshot, uint16_t glyph);
+uint16_t snapshot_lookup(const FontSnapshot &snapshot, uint32_t codepoint);
+// BMP code points only, like char_map_reverse
+std::map<uint16_t, std::vector<uint16_t>> snapshot_reverse_map(const FontSnapshot &snapshot);
+
+#endif
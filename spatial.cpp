@@ -0,0 +1,148 @@
+#include <algorithm>
+#include <climits>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+#include "spatial.h"
+
+using namespace std;
+
+static const int GRID_MAX_SIDE = 256;  // cells per row/column
+static const int GRID_POINTS_PER_CELL = 2;
+
+static int cell_coord(float v, int origin, int cellSize, int count) {
+  float c = floor((v - origin) / cellSize);
+  if (!(c >= 0)) // also catches NaN
+    return 0;
+  if (c >= count)
+    return count - 1;
+  return (int)c;
+}
+
+static uint32_t cell_index(const PointGrid &grid, int32_t x, int32_t y) {
+  return cell_coord(y, grid.originY, grid.cellSize, grid.rows) * grid.cols +
+         cell_coord(x, grid.originX, grid.cellSize, grid.cols);
+}
+
+PointGrid build_point_grid(const int32_t *xs, const int32_t *ys, uint32_t count) {
+  PointGrid grid;
+  grid.xs.assign(xs, xs + count);
+  grid.ys.assign(ys, ys + count);
+
+  int xMin = INT_MAX, yMin = INT_MAX, xMax = INT_MIN, yMax = INT_MIN;
+  for (uint32_t i = 0; i < count; ++i) {
+    xMin = min(xMin, xs[i]);
+    xMax = max(xMax, xs[i]);
+    yMin = min(yMin, ys[i]);
+    yMax = max(yMax, ys[i]);
+  }
+  if (count == 0)
+    xMin = yMin = xMax = yMax = 0;
+
+  // square cells sized for a few points each
+  double width = (double)xMax - xMin + 1, height = (double)yMax - yMin + 1;
+  double cellsWanted = max(1.0, (double)count / GRID_POINTS_PER_CELL);
+  double side = max(sqrt(width * height / cellsWanted),
+                    max(width, height) / GRID_MAX_SIDE);
+  grid.cellSize = max(1, (int)ceil(side));
+  grid.originX = xMin;
+  grid.originY = yMin;
+  grid.cols = (int)ceil(width / grid.cellSize);
+  grid.rows = (int)ceil(height / grid.cellSize);
+  grid.cells.resize((size_t)grid.cols * grid.rows);
+
+  grid.cellOf.resize(count);
+  for (uint32_t i = 0; i < count; ++i) {
+    grid.cellOf[i] = cell_index(grid, xs[i], ys[i]);
+    grid.cells[grid.cellOf[i]].push_back(i);
+  }
+  return grid;
+}
+
+const PointGrid &store_point_grid(GlyphGrids &grids, uint16_t glyph, PointGrid grid) {
+  drop_point_grid(grids, glyph);
+  grid.bytes = sizeof(grid) + grid.cells.capacity() * sizeof(grid.cells[0]) +
+               (grid.xs.capacity() + grid.ys.capacity()) * sizeof(int32_t) +
+               grid.cellOf.capacity() * sizeof(uint32_t);
+  for (const auto &cell : grid.cells)
+    grid.bytes += cell.capacity() * sizeof(uint32_t);
+  grids.bytes += grid.bytes;
+  return grids.byGlyph[glyph] = move(grid);
+}
+
+void drop_point_grid(GlyphGrids &grids, uint16_t glyph) {
+  auto it = grids.byGlyph.find(glyph);
+  if (it == grids.byGlyph.end())
+    return;
+  grids.bytes -= it->second.bytes;
+  grids.byGlyph.erase(it);
+}
+
+void grid_move_point(PointGrid &grid, uint32_t point, int32_t x, int32_t y) {
+  if (point >= grid.xs.size())
+    return;
+  grid.xs[point] = x;
+  grid.ys[point] = y;
+  uint32_t to = cell_index(grid, x, y);
+  uint32_t from = grid.cellOf[point];
+  if (to == from)
+    return;
+
+  vector<uint32_t> &old = grid.cells[from];
+  *find(old.begin(), old.end(), point) = old.back();
+  old.pop_back();
+  grid.cells[to].push_back(point);
+  grid.cellOf[point] = to;
+}
+
+int grid_nearest_point(const PointGrid &grid, float x, float y, float radius) {
+  if (grid.xs.empty() || !(radius >= 0))
+    return -1;
+  int cx0 = cell_coord(x - radius, grid.originX, grid.cellSize, grid.cols);
+  int cx1 = cell_coord(x + radius, grid.originX, grid.cellSize, grid.cols);
+  int cy0 = cell_coord(y - radius, grid.originY, grid.cellSize, grid.rows);
+  int cy1 = cell_coord(y + radius, grid.originY, grid.cellSize, grid.rows);
+
+  int best = -1;
+  double bestDist = (double)radius * radius;
+  for (int cy = cy0; cy <= cy1; ++cy) {
+    for (int cx = cx0; cx <= cx1; ++cx) {
+      for (uint32_t i : grid.cells[(size_t)cy * grid.cols + cx]) {
+        double dx = grid.xs[i] - (double)x, dy = grid.ys[i] - (double)y;
+        double d = dx * dx + dy * dy;
+        if (d < bestDist || (d == bestDist && (best < 0 || (int)i < best))) {
+          best = i;
+          bestDist = d;
+        }
+      }
+    }
+  }
+  return best;
+}
+
+vector<uint32_t> grid_points_in_rect(const PointGrid &grid, float x0, float y0,
+                                     float x1, float y1) {
+  vector<uint32_t> found;
+  if (x0 > x1)
+    swap(x0, x1);
+  if (y0 > y1)
+    swap(y0, y1);
+  if (grid.xs.empty())
+    return found;
+  int cx0 = cell_coord(x0, grid.originX, grid.cellSize, grid.cols);
+  int cx1 = cell_coord(x1, grid.originX, grid.cellSize, grid.cols);
+  int cy0 = cell_coord(y0, grid.originY, grid.cellSize, grid.rows);
+  int cy1 = cell_coord(y1, grid.originY, grid.cellSize, grid.rows);
+
+  for (int cy = cy0; cy <= cy1; ++cy) {
+    for (int cx = cx0; cx <= cx1; ++cx) {
+      for (uint32_t i : grid.cells[(size_t)cy * grid.cols + cx]) {
+        if (grid.xs[i] >= x0 && grid.xs[i] <= x1 && grid.ys[i] >= y0 && grid.ys[i] <= y1)
+          found.push_back(i);
+      }
+    }
+  }
+  sort(found.begin(), found.end());
+  return found;
+}
@@ -0,0 +1,46 @@
+#ifndef SPATIAL_H
+#define SPATIAL_H
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <vector>
+
+// Uniform grid over one glyph's points for editor hit-testing. Point
+// indices are positions in the glyph's flat point list, as in edit.h.
+// Points that move outside the grid's original bounds are kept in the
+// nearest edge cell, so queries stay exact without a rebuild.
+struct PointGrid {
+  int originX = 0, originY = 0;
+  int cellSize = 1;
+  int cols = 0, rows = 0;
+  std::vector<std::vector<uint32_t>> cells; // row-major
+  std::vector<int32_t> xs, ys;              // per point
+  std::vector<uint32_t> cellOf;             // per point
+  size_t bytes = 0; // what it added to GlyphGrids::bytes when stored
+};
+
+// Grids of the glyphs the editor has hit-tested, by glyph index, and the
+// bytes they held when built; moves shift points between cells without
+// being counted.
+struct GlyphGrids {
+  std::map<uint16_t, PointGrid> byGlyph;
+  size_t bytes = 0;
+};
+
+PointGrid build_point_grid(const int32_t *xs, const int32_t *ys, uint32_t count);
+
+const PointGrid &store_point_grid(GlyphGrids &grids, uint16_t glyph, PointGrid grid);
+void drop_point_grid(GlyphGrids &grids, uint16_t glyph);
+
+// Moves one point; cost is the size of the two cells involved
+void grid_move_point(PointGrid &grid, uint32_t point, int32_t x, int32_t y);
+
+// Closest point at most radius away (ties go to the lower index), or -1
+int grid_nearest_point(const PointGrid &grid, float x, float y, float radius);
+
+// Points inside the rectangle, edges included, in ascending index order
+std::vector<uint32_t> grid_points_in_rect(const PointGrid &grid, float x0, float y0,
+                                          float x1, float y1);
+
+#endif
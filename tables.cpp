@@ -0,0 +1,39 @@
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "bytes.h"
+#include "tables.h"
+
+using namespace std;
+
+string tag_name(uint32_t tag) {
+  char name[4] = {char(tag >> 24), char(tag >> 16), char(tag >> 8), char(tag)};
+  return string(name, 4);
+}
+
+// data points at the first 16-byte table record, just past the offset table
+TableDirectory parse_table_directory(const uint8_t *data, uint16_t numTables) {
+  TableDirectory dir;
+  for (int &i : dir.index)
+    i = -1;
+
+  // records are four big-endian u32s, the same layout as TableRecord
+  static_assert(sizeof(TableRecord) == 16, "TableRecord mirrors the file record");
+  dir.records.resize(numTables);
+  decode_be32(data, 4 * numTables, reinterpret_cast<uint32_t *>(dir.records.data()));
+  for (int i = 0; i < numTables; ++i) {
+    int id = table_id(dir.records[i].tag);
+    if (id >= 0 && dir.index[id] < 0)
+      dir.index[id] = i;
+  }
+  return dir;
+}
+
+const TableRecord *find_table(const TableDirectory &dir, TableId id) {
+  return dir.index[id] < 0 ? nullptr : &dir.records[dir.index[id]];
+}
+
+TableRecord *find_table(TableDirectory &dir, TableId id) {
+  return dir.index[id] < 0 ? nullptr : &dir.records[dir.index[id]];
+}
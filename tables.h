@@ -0,0 +1,94 @@
+#ifndef TABLES_H
+#define TABLES_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+constexpr uint32_t make_tag(char a, char b, char c, char d) {
+  return (uint32_t)(uint8_t)a << 24 | (uint32_t)(uint8_t)b << 16 |
+         (uint32_t)(uint8_t)c << 8 | (uint32_t)(uint8_t)d;
+}
+
+constexpr uint32_t TAG_HEAD = make_tag('h', 'e', 'a', 'd');
+constexpr uint32_t TAG_HHEA = make_tag('h', 'h', 'e', 'a');
+constexpr uint32_t TAG_HMTX = make_tag('h', 'm', 't', 'x');
+constexpr uint32_t TAG_MAXP = make_tag('m', 'a', 'x', 'p');
+constexpr uint32_t TAG_LOCA = make_tag('l', 'o', 'c', 'a');
+constexpr uint32_t TAG_GLYF = make_tag('g', 'l', 'y', 'f');
+constexpr uint32_t TAG_CMAP = make_tag('c', 'm', 'a', 'p');
+constexpr uint32_t TAG_KERN = make_tag('k', 'e', 'r', 'n');
+constexpr uint32_t TAG_GPOS = make_tag('G', 'P', 'O', 'S');
+constexpr uint32_t TAG_FVAR = make_tag('f', 'v', 'a', 'r');
+constexpr uint32_t TAG_AVAR = make_tag('a', 'v', 'a', 'r');
+constexpr uint32_t TAG_GVAR = make_tag('g', 'v', 'a', 'r');
+constexpr uint32_t TAG_CFF = make_tag('C', 'F', 'F', ' ');
+constexpr uint32_t TAG_CFF2 = make_tag('C', 'F', 'F', '2');
+constexpr uint32_t TAG_FPGM = make_tag('f', 'p', 'g', 'm');
+constexpr uint32_t TAG_PREP = make_tag('p', 'r', 'e', 'p');
+constexpr uint32_t TAG_CVT = make_tag('c', 'v', 't', ' ');
+
+// Tables the project parses get a fixed slot so lookup is an array index
+enum TableId {
+  TABLE_HEAD,
+  TABLE_HHEA,
+  TABLE_HMTX,
+  TABLE_MAXP,
+  TABLE_LOCA,
+  TABLE_GLYF,
+  TABLE_CMAP,
+  TABLE_KERN,
+  TABLE_GPOS,
+  TABLE_FVAR,
+  TABLE_AVAR,
+  TABLE_GVAR,
+  TABLE_CFF,
+  TABLE_CFF2,
+  TABLE_FPGM,
+  TABLE_PREP,
+  TABLE_CVT,
+  TABLE_COUNT
+};
+
+constexpr uint32_t TABLE_TAGS[TABLE_COUNT] = {
+    TAG_HEAD, TAG_HHEA, TAG_HMTX, TAG_MAXP, TAG_LOCA,
+    TAG_GLYF, TAG_CMAP, TAG_KERN, TAG_GPOS,
+    TAG_FVAR, TAG_AVAR, TAG_GVAR, TAG_CFF, TAG_CFF2,
+    TAG_FPGM, TAG_PREP, TAG_CVT,
+};
+
+constexpr int table_id(uint32_t tag) {
+  for (int i = 0; i < TABLE_COUNT; ++i) {
+    if (TABLE_TAGS[i] == tag)
+      return i;
+  }
+  return -1;
+}
+
+struct TableRecord {
+  uint32_t tag;
+  uint32_t checksum;
+  uint32_t offset;
+  uint32_t length;
+};
+
+// Every record in file order, plus the position of each known table
+// (-1 when the font does not have it).
+struct TableDirectory {
+  std::vector<TableRecord> records;
+  int index[TABLE_COUNT];
+};
+
+std::string tag_name(uint32_t tag);
+TableDirectory parse_table_directory(const uint8_t *data, uint16_t numTables);
+
+inline bool has_table(const TableDirectory &dir, TableId id) {
+  return dir.index[id] >= 0;
+}
+
+// Null when the font does not have the table. Validation guarantees the
+// required tables; callers handle the optional ones being missing.
+const TableRecord *find_table(const TableDirectory &dir, TableId id);
+TableRecord *find_table(TableDirectory &dir, TableId id);
+
+#endif
@@ -0,0 +1,304 @@
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "bytes.h"
+#include "cff.h"
+#include "validate.h"
+
+using namespace std;
+
+static FontDiagnostic fail(int code, const string &table, int glyph,
+                           const string &message) {
+  return {false, code, table, glyph, message};
+}
+
+static FontDiagnostic success() { return {true, FONT_OK, "", -1, ""}; }
+
+// Table Directory
+
+static FontDiagnostic check_directory(const vector<uint8_t> &data,
+                                      TableDirectory &tables) {
+  if (data.size() < 12)
+    return fail(FONT_TRUNCATED, "", -1, "file shorter than the offset table");
+
+  uint16_t numTables = be16(&data[4]);
+  if (12 + 16 * (size_t)numTables > data.size())
+    return fail(FONT_TRUNCATED, "", -1, "table directory runs past end of file");
+
+  tables = parse_table_directory(&data[12], numTables);
+  for (const TableRecord &rec : tables.records) {
+    if ((uint64_t)rec.offset + rec.length > data.size())
+      return fail(FONT_TABLE_OUT_OF_BOUNDS, tag_name(rec.tag), -1,
+                  "table extends past end of file");
+  }
+
+  for (TableId required : {TABLE_HEAD, TABLE_MAXP, TABLE_CMAP}) {
+    if (!has_table(tables, required))
+      return fail(FONT_MISSING_TABLE, tag_name(TABLE_TAGS[required]), -1,
+                  "required table missing");
+  }
+  bool truetype = has_table(tables, TABLE_LOCA) && has_table(tables, TABLE_GLYF);
+  if (!truetype && !has_table(tables, TABLE_CFF) && !has_table(tables, TABLE_CFF2))
+    return fail(FONT_MISSING_TABLE, "glyf", -1, "no glyf/loca or CFF outlines");
+  return success();
+}
+
+// Loca and Glyphs
+
+static FontDiagnostic check_loca(const vector<uint8_t> &data, VerifiedFont &font) {
+  // only called once both tables are known to be present
+  const TableRecord &loca = *find_table(font.tables, TABLE_LOCA);
+  const TableRecord &glyf = *find_table(font.tables, TABLE_GLYF);
+  size_t entrySize = font.shortLoca ? 2 : 4;
+  if ((font.numGlyphs + 1) * entrySize > loca.length)
+    return fail(FONT_BAD_LOCA, "loca", -1, "loca shorter than numGlyphs + 1 entries");
+
+  font.loca.resize(font.numGlyphs + 1);
+  const uint8_t *p = &data[loca.offset];
+  if (font.shortLoca)
+    decode_be16_wide(p, font.numGlyphs + 1, font.loca.data(), 1);
+  else
+    decode_be32(p, font.numGlyphs + 1, font.loca.data());
+  for (int i = 1; i <= font.numGlyphs; ++i) {
+    if (font.loca[i] < font.loca[i - 1])
+      return fail(FONT_BAD_LOCA, "loca", i - 1, "loca offsets decrease");
+  }
+  if (font.loca[font.numGlyphs] > glyf.length)
+    return fail(FONT_BAD_LOCA, "loca", font.numGlyphs - 1,
+                "loca points past end of glyf");
+  return success();
+}
+
+// Establishes every invariant decode_outline depends on: header and endPts in
+// range and increasing, flags that expand to exactly numPoints, and enough
+// bytes left for the coordinates those flags describe.
+static FontDiagnostic check_glyph(const VerifiedFont &font, uint16_t glyph) {
+  uint32_t start = font.loca[glyph], end = font.loca[glyph + 1];
+  uint32_t length = end - start;
+  if (length == 0)
+    return success();
+  if (length < 10)
+    return fail(FONT_BAD_GLYPH, "glyf", glyph, "glyph header truncated");
+
+  const uint8_t *g = &font.data[font.glyfOffset + start];
+  int16_t numContours = (int16_t)be16(g);
+  if (numContours <= 0)
+    return success(); // composite or empty, decode skips both
+
+  uint32_t p = 10 + 2 * numContours;
+  if (p + 2 > length)
+    return fail(FONT_BAD_GLYPH, "glyf", glyph, "endPtsOfContours truncated");
+
+  int last = -1;
+  for (int i = 0; i < numContours; ++i) {
+    int endPt = be16(g + 10 + 2 * i);
+    if (endPt <= last)
+      return fail(FONT_BAD_GLYPH, "glyf", glyph, "endPtsOfContours not increasing");
+    last = endPt;
+  }
+  uint32_t numPoints = last + 1;
+
+  p += 2 + be16(g + p);
+  if (p > length)
+    return fail(FONT_BAD_GLYPH, "glyf", glyph, "instructions run past glyph end");
+
+  uint32_t count = 0, xBytes = 0, yBytes = 0;
+  while (count < numPoints) {
+    if (p >= length)
+      return fail(FONT_BAD_GLYPH, "glyf", glyph, "flags run past glyph end");
+    uint8_t flag = g[p++];
+    uint32_t repeat = 1;
+    if (flag & 0x08) {
+      if (p >= length)
+        return fail(FONT_BAD_GLYPH, "glyf", glyph, "flag repeat count truncated");
+      repeat += g[p++];
+    }
+    if (count + repeat > numPoints)
+      return fail(FONT_BAD_GLYPH, "glyf", glyph, "flag repeat overruns point count");
+    count += repeat;
+    xBytes += repeat * ((flag & 0x02) ? 1 : (flag & 0x10) ? 0 : 2);
+    yBytes += repeat * ((flag & 0x04) ? 1 : (flag & 0x20) ? 0 : 2);
+  }
+  if (p + xBytes + yBytes > length)
+    return fail(FONT_BAD_GLYPH, "glyf", glyph, "coordinates run past glyph end");
+  return success();
+}
+
+// cmap
+
+static FontDiagnostic check_cmap_subtable(const uint8_t *t, uint32_t available) {
+  if (available < 2)
+    return fail(FONT_BAD_CMAP, "cmap", -1, "subtable truncated");
+  uint16_t format = be16(t);
+
+  if (format == 4) {
+    if (available < 14)
+      return fail(FONT_BAD_CMAP, "cmap", -1, "format 4 header truncated");
+    uint16_t segCountX2 = be16(t + 6);
+    uint32_t segCount = segCountX2 / 2;
+    if (segCount == 0 || segCountX2 % 2 != 0)
+      return fail(FONT_BAD_CMAP, "cmap", -1, "bad segCountX2");
+    if (16 + 8 * segCount > available)
+      return fail(FONT_BAD_CMAP, "cmap", -1, "segment arrays truncated");
+
+    const uint8_t *endCode = t + 14;
+    const uint8_t *startCode = endCode + segCountX2 + 2;
+    const uint8_t *idRangeOffset = startCode + 2 * segCountX2;
+    uint32_t prevEnd = 0;
+    for (uint32_t i = 0; i < segCount; ++i) {
+      uint16_t end = be16(endCode + 2 * i);
+      uint16_t start = be16(startCode + 2 * i);
+      if (start > end || (i > 0 && end <= prevEnd))
+        return fail(FONT_BAD_CMAP, "cmap", -1, "segments unsorted or overlapping");
+      prevEnd = end;
+      uint16_t rangeOffset = be16(idRangeOffset + 2 * i);
+      if (rangeOffset != 0) {
+        // glyph id of the segment's last code must lie inside the subtable
+        uint32_t slot = 16 + 6 * segCount + 2 * i + rangeOffset + 2 * (end - start);
+        if (slot + 2 > available)
+          return fail(FONT_BAD_CMAP, "cmap", -1, "idRangeOffset points outside subtable");
+      }
+    }
+    if (prevEnd != 0xFFFF)
+      return fail(FONT_BAD_CMAP, "cmap", -1, "last segment does not end at 0xFFFF");
+  } else if (format == 12) {
+    if (available < 16)
+      return fail(FONT_BAD_CMAP, "cmap", -1, "format 12 header truncated");
+    uint32_t numGroups = be32(t + 12);
+    if (16 + 12 * (uint64_t)numGroups > available)
+      return fail(FONT_BAD_CMAP, "cmap", -1, "groups truncated");
+    uint32_t prevEnd = 0;
+    for (uint32_t i = 0; i < numGroups; ++i) {
+      uint32_t start = be32(t + 16 + 12 * i);
+      uint32_t end = be32(t + 20 + 12 * i);
+      if (start > end || (i > 0 && start <= prevEnd))
+        return fail(FONT_BAD_CMAP, "cmap", -1, "groups unsorted or overlapping");
+      prevEnd = end;
+    }
+  }
+  return success();
+}
+
+static FontDiagnostic check_cmap(const VerifiedFont &font) {
+  const TableRecord &cmap = *find_table(font.tables, TABLE_CMAP); // required
+  if (cmap.length < 4)
+    return fail(FONT_BAD_CMAP, "cmap", -1, "cmap header truncated");
+  const uint8_t *c = &font.data[cmap.offset];
+  uint16_t numSubtables = be16(c + 2);
+  if (4 + 8 * (uint32_t)numSubtables > cmap.length)
+    return fail(FONT_BAD_CMAP, "cmap", -1, "encoding records truncated");
+
+  for (int i = 0; i < numSubtables; ++i) {
+    uint32_t offset = be32(c + 4 + 8 * i + 4);
+    if (offset >= cmap.length)
+      return fail(FONT_BAD_CMAP, "cmap", -1, "subtable offset outside cmap");
+    FontDiagnostic diag = check_cmap_subtable(c + offset, cmap.length - offset);
+    if (!diag.ok)
+      return diag;
+  }
+  return success();
+}
+
+// Validation
+
+FontDiagnostic validate_font(vector<uint8_t> data, VerifiedFont &font, bool checkGlyphs) {
+  font = VerifiedFont();
+  font.data = move(data);
+
+  FontDiagnostic diag = check_directory(font.data, font.tables);
+  if (!diag.ok)
+    return diag;
+
+  // check_directory has made sure the required tables are there
+  const TableRecord &head = *find_table(font.tables, TABLE_HEAD);
+  if (head.length < 54 || be32(&font.data[head.offset + 12]) != 0x5F0F3CF5)
+    return fail(FONT_BAD_HEAD, "head", -1, "head too short or bad magic number");
+  uint16_t locFormat = be16(&font.data[head.offset + 50]);
+  if (locFormat > 1)
+    return fail(FONT_BAD_HEAD, "head", -1, "unknown indexToLocFormat");
+  font.shortLoca = locFormat == 0;
+  font.unitsPerEm = be16(&font.data[head.offset + 18]);
+
+  const TableRecord &maxp = *find_table(font.tables, TABLE_MAXP);
+  if (maxp.length < 6)
+    return fail(FONT_TRUNCATED, "maxp", -1, "maxp too short");
+  font.numGlyphs = be16(&font.data[maxp.offset + 4]);
+
+  const TableRecord *glyf = find_table(font.tables, TABLE_GLYF);
+  if (glyf && has_table(font.tables, TABLE_LOCA)) {
+    font.glyfOffset = glyf->offset;
+    diag = check_loca(font.data, font);
+    if (!diag.ok)
+      return diag;
+
+    for (int i = 0; checkGlyphs && i < font.numGlyphs; ++i) {
+      diag = check_glyph(font, i);
+      if (!diag.ok)
+        return diag;
+    }
+  } else {
+    // charstrings are bounds-checked as they run, so only the
+    // INDEX/DICT structure is checked here
+    auto cff = make_shared<CffFont>();
+    string error = parse_cff(font, *cff);
+    if (!error.empty())
+      return fail(FONT_BAD_CFF, has_table(font.tables, TABLE_CFF) ? "CFF " : "CFF2", -1, error);
+    font.cff = cff;
+  }
+
+  diag = check_cmap(font);
+  if (!diag.ok)
+    return diag;
+
+  const TableRecord *hhea = find_table(font.tables, TABLE_HHEA);
+  const TableRecord *hmtx = find_table(font.tables, TABLE_HMTX);
+  if (hhea && hmtx) {
+    if (hhea->length < 36)
+      return fail(FONT_BAD_HMTX, "hhea", -1, "hhea too short");
+    uint32_t numberOfHMetrics = be16(&font.data[hhea->offset + 34]);
+    uint32_t lsbCount = numberOfHMetrics < font.numGlyphs ? font.numGlyphs - numberOfHMetrics : 0;
+    if (4 * numberOfHMetrics + 2 * lsbCount > hmtx->length)
+      return fail(FONT_BAD_HMTX, "hmtx", -1, "hmtx shorter than hhea/maxp require");
+  }
+
+  return success();
+}
+
+FontDiagnostic load_verified_font(const string &filename, VerifiedFont &font,
+                                  bool checkGlyphs) {
+  vector<uint8_t> data;
+  if (!read_file_bytes(filename, data))
+    return fail(FONT_NOT_FOUND, "", -1, "Font not found");
+  return validate_font(move(data), font, checkGlyphs);
+}
+
+void release_font_caches(const VerifiedFont &font) {
+  atomic_store(&font.charMap, shared_ptr<const CharMap>());
+  atomic_store(&font.horizontalMetrics, shared_ptr<const HorizontalMetrics>());
+  atomic_store(&font.kerning, shared_ptr<const KernTable>());
+  atomic_store(&font.variations, shared_ptr<const FontVariations>());
+  atomic_store(&font.coverage, shared_ptr<const CoverageSet>());
+  atomic_store(&font.hinting, shared_ptr<const FontHinting>());
+  if (font.cff) {
+    for (auto &tokens : font.cff->globalCache.tokens)
+      atomic_store(&tokens, shared_ptr<const vector<CffToken>>());
+    for (const CffPrivateDict &priv : font.cff->privates) {
+      for (auto &tokens : priv.cache.tokens)
+        atomic_store(&tokens, shared_ptr<const vector<CffToken>>());
+    }
+  }
+  font.cacheBytes.bytes = 0;
+}
+
+FontDiagnostic check_glyphs(const VerifiedFont &font, const vector<uint16_t> &glyphs) {
+  for (uint16_t glyph : glyphs) {
+    if (glyph >= font.numGlyphs)
+      return fail(FONT_BAD_GLYPH, "glyf", glyph, "glyph index out of range");
+    FontDiagnostic diag = check_glyph(font, glyph);
+    if (!diag.ok)
+      return diag;
+  }
+  return success();
+}
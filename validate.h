@@ -0,0 +1,52 @@
+#ifndef VALIDATE_H
+#define VALIDATE_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "font.h"
+
+enum FontError {
+  FONT_OK = 0,
+  FONT_NOT_FOUND,
+  FONT_TRUNCATED,         // file too short for its own header/directory
+  FONT_MISSING_TABLE,     // a required table is absent
+  FONT_TABLE_OUT_OF_BOUNDS,
+  FONT_BAD_HEAD,
+  FONT_BAD_LOCA,
+  FONT_BAD_GLYPH,
+  FONT_BAD_CMAP,
+  FONT_BAD_HMTX,
+  FONT_BAD_CFF,
+  FONT_BAD_EDIT,          // write_entries payload does not fit the font
+  FONT_BAD_HANDLE,        // no open font has the handle
+  FONT_IO,                // the working copy could not be read or written
+  FONT_BAD_ARGUMENT,      // a binding argument is outside its range
+};
+
+// Where and why validation stopped. table/glyph are empty/-1 when they do
+// not apply.
+struct FontDiagnostic {
+  bool ok;
+  int code;
+  std::string table;
+  int glyph;
+  std::string message;
+};
+
+// checkGlyphs = false skips the per-glyph walk, for bytes whose glyphs are
+// never decoded: an upload with a snapshot hit is only reorganized, and the
+// reorganized copy is checked in full
+FontDiagnostic validate_font(std::vector<uint8_t> data, VerifiedFont &font,
+                             bool checkGlyphs = true);
+FontDiagnostic load_verified_font(const std::string &filename, VerifiedFont &font,
+                                  bool checkGlyphs = true);
+// Drops every cache the font has built and zeroes its cacheBytes. Readers
+// holding a cache keep it; later calls build it again.
+void release_font_caches(const VerifiedFont &font);
+// Checks only the given glyphs, for a verified font whose other glyphs are
+// as they were when it was checked
+FontDiagnostic check_glyphs(const VerifiedFont &font, const std::vector<uint16_t> &glyphs);
+
+#endif
@@ -0,0 +1,411 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "bytes.h"
+#include "variation.h"
+
+#if defined(__AVX__) || defined(__SSE2__)
+#include <immintrin.h>
+#elif defined(__wasm_simd128__)
+#include <wasm_simd128.h>
+#endif
+
+using namespace std;
+
+static float fixed_to_float(uint32_t v) { return (int32_t)v / 65536.0f; }
+static float f2dot14_to_float(uint16_t v) { return (int16_t)v / 16384.0f; }
+
+// fvar, avar and gvar Headers
+
+FontVariations parse_variations(const VerifiedFont &font) {
+  FontVariations vars;
+  vars.glyphs.resize(font.numGlyphs);
+  if (!has_table(font.tables, TABLE_FVAR))
+    return vars;
+
+  TableBytes fvar = table_bytes(font, TABLE_FVAR);
+  uint16_t axesOffset = get_u16(fvar, 4);
+  uint16_t axisCount = get_u16(fvar, 8);
+  uint16_t axisSize = get_u16(fvar, 10);
+  for (int i = 0; i < axisCount; ++i) {
+    size_t r = axesOffset + (size_t)i * axisSize;
+    if (r + 20 > fvar.size)
+      break;
+    vars.axes.push_back({tag_name(get_u32(fvar, r)), fixed_to_float(get_u32(fvar, r + 4)),
+                         fixed_to_float(get_u32(fvar, r + 8)),
+                         fixed_to_float(get_u32(fvar, r + 12))});
+  }
+  axisCount = vars.axes.size();
+
+  vars.avarFrom.resize(axisCount);
+  vars.avarTo.resize(axisCount);
+  if (has_table(font.tables, TABLE_AVAR)) {
+    TableBytes avar = table_bytes(font, TABLE_AVAR);
+    if (get_u16(avar, 6) == axisCount) {
+      size_t p = 8;
+      for (int i = 0; i < axisCount; ++i) {
+        uint16_t count = get_u16(avar, p);
+        p += 2;
+        for (int k = 0; k < count; ++k, p += 4) {
+          vars.avarFrom[i].push_back(f2dot14_to_float(get_u16(avar, p)));
+          vars.avarTo[i].push_back(f2dot14_to_float(get_u16(avar, p + 2)));
+        }
+      }
+    }
+  }
+
+  if (!has_table(font.tables, TABLE_GVAR))
+    return vars;
+  TableBytes gvar = table_bytes(font, TABLE_GVAR);
+  if (get_u16(gvar, 4) != axisCount)
+    return vars; // gvar built for a different fvar; use the default master
+
+  uint16_t sharedTupleCount = get_u16(gvar, 6);
+  uint32_t sharedTuplesOffset = get_u32(gvar, 8);
+  uint16_t glyphCount = get_u16(gvar, 12);
+  bool longOffsets = get_u16(gvar, 14) & 1;
+  vars.glyphDataStart = get_u32(gvar, 16);
+
+  vector<uint16_t> shared(sharedTupleCount * axisCount);
+  if (get_u16_array(gvar, sharedTuplesOffset, shared.size(), shared.data())) {
+    for (uint16_t v : shared)
+      vars.sharedTuples.push_back(f2dot14_to_float(v));
+  }
+
+  // glyphs past glyphCount have no variation data
+  vars.glyphDataOffsets.assign(font.numGlyphs + 1, 0);
+  uint16_t n = min<uint16_t>(glyphCount, font.numGlyphs);
+  for (int i = 0; i <= n; ++i)
+    vars.glyphDataOffsets[i] = longOffsets ? get_u32(gvar, 20 + 4 * i)
+                                           : get_u16(gvar, 20 + 2 * i) * 2;
+  for (int i = n + 1; i <= font.numGlyphs; ++i)
+    vars.glyphDataOffsets[i] = vars.glyphDataOffsets[n];
+
+  return vars;
+}
+
+shared_ptr<const FontVariations> font_variations(const VerifiedFont &font) {
+  return lazy_cache(font, font.variations, [&] { return parse_variations(font); },
+                    [](const FontVariations &vars) {
+                      size_t bytes = vector_bytes(vars.axes) + vector_bytes(vars.avarFrom) +
+                                     vector_bytes(vars.avarTo) + vector_bytes(vars.sharedTuples) +
+                                     vector_bytes(vars.glyphDataOffsets) + vector_bytes(vars.glyphs);
+                      for (const vector<float> &from : vars.avarFrom)
+                        bytes += vector_bytes(from);
+                      for (const vector<float> &to : vars.avarTo)
+                        bytes += vector_bytes(to);
+                      return bytes;
+                    });
+}
+
+// Glyph Variation Data
+
+// Point numbers as a sorted list; all is set when the tuple covers every point
+static size_t read_packed_points(const TableBytes &d, size_t p, vector<uint16_t> &points,
+                                 bool &all) {
+  points.clear();
+  uint16_t count = get_u8(d, p++);
+  all = count == 0;
+  if (count & 0x80)
+    count = (count & 0x7F) << 8 | get_u8(d, p++);
+
+  uint16_t point = 0;
+  while (points.size() < count && p < d.size) {
+    uint8_t control = get_u8(d, p++);
+    int run = (control & 0x7F) + 1;
+    for (int i = 0; i < run && points.size() < count; ++i) {
+      if (control & 0x80) {
+        point += get_u16(d, p);
+        p += 2;
+      } else {
+        point += get_u8(d, p++);
+      }
+      points.push_back(point);
+    }
+  }
+  return p;
+}
+
+static size_t read_packed_deltas(const TableBytes &d, size_t p, size_t count,
+                                 vector<float> &deltas) {
+  deltas.clear();
+  while (deltas.size() < count && p < d.size) {
+    uint8_t control = get_u8(d, p++);
+    int run = (control & 0x3F) + 1;
+    for (int i = 0; i < run && deltas.size() < count; ++i) {
+      if (control & 0x80) {
+        deltas.push_back(0);
+      } else if (control & 0x40) {
+        deltas.push_back((int16_t)get_u16(d, p));
+        p += 2;
+      } else {
+        deltas.push_back((int8_t)get_u8(d, p++));
+      }
+    }
+  }
+  deltas.resize(count, 0); // truncated runs contribute nothing
+  return p;
+}
+
+static float interpolate_delta(float x, float x1, float x2, float d1, float d2) {
+  if (x1 == x2)
+    return d1 == d2 ? d1 : 0;
+  if (x1 > x2) {
+    swap(x1, x2);
+    swap(d1, d2);
+  }
+  if (x <= x1)
+    return d1;
+  if (x >= x2)
+    return d2;
+  return d1 + (x - x1) * (d2 - d1) / (x2 - x1);
+}
+
+// IUP: points a tuple does not list take their delta from the nearest
+// touched points of the same contour, interpolated in the default outline.
+static void infer_untouched(const GlyphOutline &outline, const vector<uint8_t> &touched,
+                            float *dx, float *dy) {
+  uint32_t start = 0;
+  for (int c = 0; c < outline.numContours; ++c) {
+    uint32_t end = outline.contourEnds[c];
+    uint32_t length = end - start + 1;
+    uint32_t first = start;
+    while (first <= end && !touched[first])
+      ++first;
+    if (first <= end) {
+      uint32_t prev = first;
+      for (uint32_t k = 1; k <= length; ++k) {
+        uint32_t i = start + (first - start + k) % length;
+        if (!touched[i])
+          continue;
+        // untouched points strictly between prev and i, walking the contour
+        for (uint32_t j = start + (prev - start + 1) % length; j != i;
+             j = start + (j - start + 1) % length) {
+          const Point &a = outline.points[prev], &b = outline.points[i], &q = outline.points[j];
+          dx[j] = interpolate_delta(q.x, a.x, b.x, dx[prev], dx[i]);
+          dy[j] = interpolate_delta(q.y, a.y, b.y, dy[prev], dy[i]);
+        }
+        prev = i;
+      }
+    }
+    start = end + 1;
+  }
+}
+
+static thread_local Arena variation_arena; // default outline for IUP
+
+static GlyphVariations decode_glyph_variations(const VerifiedFont &font,
+                                               const FontVariations &vars, uint16_t glyph) {
+  arena_reset(variation_arena);
+  GlyphOutline outline = decode_outline(font, glyph, variation_arena);
+
+  GlyphVariations result;
+  result.numPoints = outline.numPoints + 4;
+  if (vars.glyphDataOffsets.empty())
+    return result;
+
+  TableBytes gvar = table_bytes(font, TABLE_GVAR);
+  size_t begin = (size_t)vars.glyphDataStart + vars.glyphDataOffsets[glyph];
+  size_t end = min<size_t>((size_t)vars.glyphDataStart + vars.glyphDataOffsets[glyph + 1],
+                           gvar.size);
+  if (begin >= end)
+    return result;
+  TableBytes d = {gvar.data + begin, end - begin};
+
+  size_t axisCount = vars.axes.size();
+  size_t sharedTupleCount = axisCount ? vars.sharedTuples.size() / axisCount : 0;
+  uint16_t tupleVariationCount = get_u16(d, 0);
+  size_t header = 4;
+  size_t data = get_u16(d, 2);
+
+  vector<uint16_t> sharedPoints, privatePoints;
+  bool sharedAll = true, privateAll;
+  if (tupleVariationCount & 0x8000)
+    data = read_packed_points(d, data, sharedPoints, sharedAll);
+
+  vector<float> xs, ys;
+  vector<uint8_t> touched;
+  for (int t = 0; t < (tupleVariationCount & 0x0FFF) && header < d.size; ++t) {
+    uint16_t size = get_u16(d, header);
+    uint16_t index = get_u16(d, header + 2);
+    header += 4;
+
+    GlyphTuple tuple;
+    tuple.intermediate = index & 0x4000;
+    bool valid = true;
+    if (index & 0x8000) {
+      for (size_t a = 0; a < axisCount; ++a)
+        tuple.peak.push_back(f2dot14_to_float(get_u16(d, header + 2 * a)));
+      header += 2 * axisCount;
+    } else if ((index & 0x0FFF) < sharedTupleCount) {
+      auto shared = vars.sharedTuples.begin() + (index & 0x0FFF) * axisCount;
+      tuple.peak.assign(shared, shared + axisCount);
+    } else {
+      valid = false;
+    }
+    if (tuple.intermediate) {
+      for (size_t a = 0; a < axisCount; ++a) {
+        tuple.start.push_back(f2dot14_to_float(get_u16(d, header + 2 * a)));
+        tuple.end.push_back(f2dot14_to_float(get_u16(d, header + 2 * (axisCount + a))));
+      }
+      header += 4 * axisCount;
+    }
+
+    size_t next = data + size;
+    const vector<uint16_t> *points = &sharedPoints;
+    bool all = sharedAll;
+    if (index & 0x2000) {
+      data = read_packed_points(d, data, privatePoints, privateAll);
+      points = &privatePoints;
+      all = privateAll;
+    }
+    size_t count = all ? result.numPoints : points->size();
+    data = read_packed_deltas(d, data, count, xs);
+    read_packed_deltas(d, data, count, ys);
+    data = next;
+    if (!valid)
+      continue;
+
+    uint32_t n = result.numPoints;
+    tuple.deltas.assign(2 * n, 0);
+    float *dx = tuple.deltas.data(), *dy = dx + n;
+    if (all) {
+      copy(xs.begin(), xs.end(), dx);
+      copy(ys.begin(), ys.end(), dy);
+    } else {
+      touched.assign(n, 0);
+      for (size_t i = 0; i < points->size(); ++i) {
+        uint16_t p = (*points)[i];
+        if (p >= n)
+          continue;
+        dx[p] = xs[i];
+        dy[p] = ys[i];
+        touched[p] = 1;
+      }
+      infer_untouched(outline, touched, dx, dy);
+    }
+    result.tuples.push_back(move(tuple));
+  }
+  return result;
+}
+
+shared_ptr<const GlyphVariations> glyph_variations(const VerifiedFont &font, uint16_t glyph) {
+  shared_ptr<const FontVariations> vars = font_variations(font);
+  return lazy_cache(font, vars->glyphs[glyph],
+                    [&] { return decode_glyph_variations(font, *vars, glyph); },
+                    [](const GlyphVariations &glyph) {
+                      size_t bytes = vector_bytes(glyph.tuples);
+                      for (const GlyphTuple &tuple : glyph.tuples)
+                        bytes += vector_bytes(tuple.peak) + vector_bytes(tuple.start) +
+                                 vector_bytes(tuple.end) + vector_bytes(tuple.deltas);
+                      return bytes;
+                    });
+}
+
+// Instancing
+
+vector<float> normalize_coords(const FontVariations &vars, const vector<float> &coords) {
+  vector<float> normalized(vars.axes.size());
+  for (size_t i = 0; i < vars.axes.size(); ++i) {
+    const VariationAxis &axis = vars.axes[i];
+    float v = i < coords.size() ? coords[i] : axis.defaultValue;
+    v = min(max(v, axis.minValue), axis.maxValue);
+
+    float n = 0;
+    if (v < axis.defaultValue && axis.defaultValue > axis.minValue)
+      n = (v - axis.defaultValue) / (axis.defaultValue - axis.minValue);
+    else if (v > axis.defaultValue && axis.maxValue > axis.defaultValue)
+      n = (v - axis.defaultValue) / (axis.maxValue - axis.defaultValue);
+
+    // avar segment map, piecewise linear between its entries
+    const vector<float> &from = vars.avarFrom[i], &to = vars.avarTo[i];
+    if (!from.empty()) {
+      if (n <= from.front()) {
+        n = to.front();
+      } else if (n >= from.back()) {
+        n = to.back();
+      } else {
+        size_t k = 1;
+        while (n > from[k])
+          ++k;
+        n = from[k] == from[k - 1]
+                ? to[k]
+                : to[k - 1] + (n - from[k - 1]) * (to[k] - to[k - 1]) / (from[k] - from[k - 1]);
+      }
+    }
+    normalized[i] = roundf(n * 16384) / 16384; // F2DOT14, as the font was built
+  }
+  return normalized;
+}
+
+float tuple_scalar(const GlyphTuple &tuple, const vector<float> &normalized) {
+  float scalar = 1;
+  for (size_t i = 0; i < tuple.peak.size(); ++i) {
+    float peak = tuple.peak[i];
+    if (peak == 0)
+      continue;
+    float v = i < normalized.size() ? normalized[i] : 0;
+    float lower = tuple.intermediate ? tuple.start[i] : min(peak, 0.0f);
+    float upper = tuple.intermediate ? tuple.end[i] : max(peak, 0.0f);
+    if (lower > peak || peak > upper || (lower < 0 && upper > 0))
+      continue; // malformed region, the axis is ignored
+    if (v == peak)
+      continue;
+    if (v <= lower || v >= upper)
+      return 0;
+    scalar *= v < peak ? (v - lower) / (peak - lower) : (upper - v) / (upper - peak);
+  }
+  return scalar;
+}
+
+// acc += src * scale
+static void multiply_add(float *acc, const float *src, float scale, size_t count) {
+  size_t i = 0;
+#if defined(__AVX__)
+  __m256 s = _mm256_set1_ps(scale);
+  for (; i + 8 <= count; i += 8) {
+    __m256 v = _mm256_add_ps(_mm256_loadu_ps(acc + i), _mm256_mul_ps(_mm256_loadu_ps(src + i), s));
+    _mm256_storeu_ps(acc + i, v);
+  }
+#elif defined(__SSE2__)
+  __m128 s = _mm_set1_ps(scale);
+  for (; i + 4 <= count; i += 4)
+    _mm_storeu_ps(acc + i, _mm_add_ps(_mm_loadu_ps(acc + i), _mm_mul_ps(_mm_loadu_ps(src + i), s)));
+#elif defined(__wasm_simd128__)
+  v128_t s = wasm_f32x4_splat(scale);
+  for (; i + 4 <= count; i += 4) {
+    v128_t v = wasm_f32x4_add(wasm_v128_load(acc + i), wasm_f32x4_mul(wasm_v128_load(src + i), s));
+    wasm_v128_store(acc + i, v);
+  }
+#endif
+  for (; i < count; ++i)
+    acc[i] += src[i] * scale;
+}
+
+void vary_outline(const VerifiedFont &font, uint16_t glyph, const vector<float> &normalized,
+                  GlyphOutline &outline) {
+  if (glyph >= font.numGlyphs)
+    return;
+  shared_ptr<const GlyphVariations> cached = glyph_variations(font, glyph);
+  const GlyphVariations &vars = *cached;
+  if (vars.tuples.empty())
+    return;
+
+  static thread_local vector<float> acc;
+  acc.assign(2 * vars.numPoints, 0);
+  for (const GlyphTuple &tuple : vars.tuples) {
+    float scalar = tuple_scalar(tuple, normalized);
+    if (scalar != 0)
+      multiply_add(acc.data(), tuple.deltas.data(), scalar, acc.size());
+  }
+
+  // phantom points (the last four) would move metrics; only the outline is varied
+  const float *dx = acc.data(), *dy = dx + vars.numPoints;
+  for (uint32_t i = 0; i < outline.numPoints; ++i) {
+    outline.points[i].x += (int)floorf(dx[i] + 0.5f);
+    outline.points[i].y += (int)floorf(dy[i] + 0.5f);
+  }
+}
@@ -0,0 +1,59 @@
+#ifndef VARIATION_H
+#define VARIATION_H
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "decode.h"
+#include "font.h"
+
+// One fvar axis, in user units (e.g. wght 100..900)
+struct VariationAxis {
+  std::string tag;
+  float minValue, defaultValue, maxValue;
+};
+
+// One tuple variation of a glyph. Deltas are stored for every point plus
+// the four phantom points, with IUP already applied, as all x deltas
+// followed by all y deltas. Moving along an axis only re-evaluates the
+// region scalar.
+struct GlyphTuple {
+  std::vector<float> peak, start, end; // normalized, one per axis
+  bool intermediate;
+  std::vector<float> deltas;
+};
+
+struct GlyphVariations {
+  uint32_t numPoints = 0; // including phantom points
+  std::vector<GlyphTuple> tuples;
+};
+
+// fvar/avar plus the gvar offsets. Each glyph's tuples are decoded on first
+// use and kept, so later calls do not touch gvar again.
+struct FontVariations {
+  std::vector<VariationAxis> axes;
+  std::vector<std::vector<float>> avarFrom, avarTo; // per axis, may be empty
+  std::vector<float> sharedTuples;                 // sharedTupleCount x axes
+  std::vector<uint32_t> glyphDataOffsets;          // numGlyphs + 1, into gvar
+  uint32_t glyphDataStart = 0;
+
+  mutable std::vector<std::shared_ptr<const GlyphVariations>> glyphs;
+};
+
+FontVariations parse_variations(const VerifiedFont &font);
+std::shared_ptr<const FontVariations> font_variations(const VerifiedFont &font);
+std::shared_ptr<const GlyphVariations> glyph_variations(const VerifiedFont &font, uint16_t glyph);
+
+// User-space coordinates (fvar axis order) to normalized -1..1 through
+// avar; missing trailing coordinates take the axis default.
+std::vector<float> normalize_coords(const FontVariations &variations,
+                                    const std::vector<float> &coords);
+float tuple_scalar(const GlyphTuple &tuple, const std::vector<float> &normalized);
+
+// Moves the outline's points to the instance at the normalized coordinates
+void vary_outline(const VerifiedFont &font, uint16_t glyph,
+                  const std::vector<float> &normalized, GlyphOutline &outline);
+
+#endif
@@ -1,18 +1,21 @@
-#include <iostream>
+#include <algorithm>
+#include <atomic>
 #include <fstream>
+#include <memory>
 #include <vector>
 #include <cstdint>
 #include <string>
 #include <cstring>
-#include <unordered_map>
 
-// using namespace std;
+#include "aggregates.h"
+#include "cmap.h"
+#include "coverage.h"
+#include "kern.h"
+#include "reorganize.h"
+#include "tables.h"
+#include "writeback.h"
 
-struct WBPoint {
-    int x, y;
-    bool onCurve;
-    bool endPt;
-};
+// using namespace std;
 
 // Big-endian helpers
 uint16_t read_u16(const std::vector<uint8_t>& data, size_t offset) {
@@ -36,121 +39,104 @@ void write_u32(std::vector<uint8_t>& data, size_t offset, uint32_t value) {
     data[offset + 3] = value & 0xFF;
 }
 
-struct TableDirectoryEntry {
-    char tag[5];
-    uint32_t checksum;
-    uint32_t offset;
-    uint32_t length;
-};
-
-uint16_t get_num_glyphs(std::vector<uint8_t>& font, const TableDirectoryEntry& maxp) {
+uint16_t get_num_glyphs(std::vector<uint8_t>& font, const TableRecord& maxp) {
     return read_u16(font, maxp.offset + 4);
 }
 
-std::unordered_map<std::string, TableDirectoryEntry> parse_table_directory(const std::vector<uint8_t>& font, int& numTables) {
-    numTables = read_u16(font, 4);
-    std::unordered_map<std::string, TableDirectoryEntry> tableMap;
-    for (int i = 0; i < numTables; ++i) {
-        size_t offset = 12 + i * 16;
-        TableDirectoryEntry entry;
-        memcpy(entry.tag, &font[offset], 4);
-        entry.tag[4] = '\0';
-        entry.checksum = read_u32(font, offset + 4);
-        entry.offset = read_u32(font, offset + 8);
-        entry.length = read_u32(font, offset + 12);
-        tableMap[std::string(entry.tag)] = entry;
+GlyphBounds points_bounds(const std::vector<WBPoint>& points) {
+    GlyphBounds b = {points.empty(), 0, 0, 0, 0, (uint16_t) points.size(), 0};
+    if (!points.empty()) {
+        b.xMin = b.xMax = points[0].x;
+        b.yMin = b.yMax = points[0].y;
     }
-    return tableMap;
-}
-
-uint32_t modify_glyph(std::vector<uint8_t>& font, const TableDirectoryEntry& glyf, const TableDirectoryEntry& loca, uint16_t index, bool longLocaFormat, std::vector<WBPoint> points) {
-    size_t locaOffset = loca.offset;
-    uint32_t glyphOffset, nextGlyphOffset;
-    if (longLocaFormat) {
-        glyphOffset = read_u32(font, locaOffset + index * 4);
-        nextGlyphOffset = read_u32(font, locaOffset + (index + 1) * 4);
-    } else {
-        glyphOffset = read_u16(font, locaOffset + index * 2) * 2;
-        nextGlyphOffset = read_u16(font, locaOffset + (index + 1) * 2) * 2;
+    for (const WBPoint& p : points) {
+        b.xMin = std::min<int>(b.xMin, p.x);
+        b.yMin = std::min<int>(b.yMin, p.y);
+        b.xMax = std::max<int>(b.xMax, p.x);
+        b.yMax = std::max<int>(b.yMax, p.y);
+        b.contours += p.endPt;
     }
-    size_t glyphStart = glyf.offset + glyphOffset;
+    return b;
+}
 
-    int ind = 0;
+// Encodes a simple glyph: on-curve flags and 16-bit deltas, no instructions
+std::vector<uint8_t> encode_glyph(const std::vector<WBPoint>& points) {
     std::vector<uint16_t> contourEndIndex;
-    for (WBPoint p : points) {
-        if (p.endPt) {
-            contourEndIndex.push_back(ind);
+    for (size_t i = 0; i < points.size(); i++) {
+        if (points[i].endPt) {
+            contourEndIndex.push_back(i);
         }
-        ind++;
     }
 
-    int newGlyphLength = points.size() * 5 + contourEndIndex.size() * 2 + 12;
-    // account for longer glyphs than what was originally there (adding points)
-    if (nextGlyphOffset - glyphOffset < newGlyphLength) {
-        // if new length is longer shift everything after farther down to make space
-        int toAdd = newGlyphLength - (nextGlyphOffset - glyphOffset);
-        for (int i = 0; i < toAdd; i++) {
-            font.insert(font.begin() + glyphStart, 0);
-        }
-    }
-
-    // Build new glyph
-    std::vector<uint8_t> newGlyph;
-    int currOffset = 10;
-    newGlyph.resize(10); // header
+    std::vector<uint8_t> newGlyph(10 + 2 * contourEndIndex.size() + 2 + 5 * points.size());
+    GlyphBounds bounds = points_bounds(points);
     write_u16(newGlyph, 0, (uint16_t) contourEndIndex.size());     // numberOfContours
-    write_u16(newGlyph, 2, read_u16(font, glyphStart + 2));     // xMin
-    write_u16(newGlyph, 4, read_u16(font, glyphStart + 4));     // yMin
-    write_u16(newGlyph, 6, read_u16(font, glyphStart + 6));   // xMax
-    write_u16(newGlyph, 8, read_u16(font, glyphStart + 8));   // yMax
-
-    currOffset += 2 * contourEndIndex.size(); // set space for counter end indexes
-    newGlyph.resize(currOffset); // make room for endPtsOfContours
-    for (int startOff = 10; startOff < currOffset; startOff += 2) {
-        write_u16(newGlyph, startOff, contourEndIndex[(startOff - 10) / 2]); // place contours in
+    write_u16(newGlyph, 2, bounds.xMin);
+    write_u16(newGlyph, 4, bounds.yMin);
+    write_u16(newGlyph, 6, bounds.xMax);
+    write_u16(newGlyph, 8, bounds.yMax);
+
+    size_t currOffset = 10;
+    for (uint16_t end : contourEndIndex) {
+        write_u16(newGlyph, currOffset, end);
+        currOffset += 2;
     }
-    // write_u16(newGlyph, 10, points.size() - 1); // endPtsOfContours[0] = 1
-
-    currOffset += 2; // 14
-    newGlyph.resize(currOffset); // instructionLength = 0
-    write_u16(newGlyph, currOffset - 2, 0);
+    write_u16(newGlyph, currOffset, 0); // instructionLength
+    currOffset += 2;
 
     // place flags for on curve
-    for (WBPoint p : points) {
-        newGlyph.push_back((uint8_t) p.onCurve);
-        currOffset++;
+    for (const WBPoint& p : points) {
+        newGlyph[currOffset++] = (uint8_t) p.onCurve;
     }
 
-    // Coordinates (as signed 8-bit deltas for simplicity)
-
-    // x coordinates
+    // x coordinates, then y, as 16-bit deltas
     int past_x = 0;
-    for (WBPoint p : points) {
+    for (const WBPoint& p : points) {
+        write_u16(newGlyph, currOffset, p.x - past_x);
         currOffset += 2;
-        newGlyph.resize(currOffset);
-        write_u16(newGlyph, currOffset - 2, p.x - past_x);
         past_x = p.x;
     }
-
-    // y coordinates
     int past_y = 0;
-    for (WBPoint p : points) {
+    for (const WBPoint& p : points) {
+        write_u16(newGlyph, currOffset, p.y - past_y);
         currOffset += 2;
-        newGlyph.resize(currOffset);
-        write_u16(newGlyph, currOffset - 2, p.y - past_y);
         past_y = p.y;
     }
+    return newGlyph;
+}
 
-    // Overwrite glyph in font buffer
-    size_t glyphLength = (newGlyphLength <= nextGlyphOffset - glyphOffset) ? nextGlyphOffset - glyphOffset : newGlyphLength;
-    for (size_t i = 0; i < newGlyph.size(); ++i) {
-        font[glyphStart + i] = newGlyph[i];
-    }
-    for (size_t i = newGlyph.size(); i < glyphLength; ++i) {
-        font[glyphStart + i] = 0;
+// Rewrites glyph index in its slot, zeroing what it no longer uses. Only a
+// glyph that outgrew its slot moves anything: the rest of the file shifts
+// once to give it a new slot with fresh headroom, and the later loca
+// offsets, held in memory, follow. The caller has checked glyf is there.
+void modify_glyph(std::vector<uint8_t>& font, TableDirectory& tables, std::vector<uint32_t>& loca, uint16_t index, const std::vector<WBPoint>& points) {
+    TableRecord& glyf = *find_table(tables, TABLE_GLYF);
+    std::vector<uint8_t> newGlyph = encode_glyph(points);
+    uint32_t capacity = loca[index + 1] - loca[index];
+
+    if (newGlyph.size() > capacity) {
+        // a multiple of 4 keeps later tables aligned and short loca even
+        uint32_t grow = (glyph_slot_size(newGlyph.size()) - capacity + 3) & ~3u;
+        size_t at = glyf.offset + loca[index + 1];
+        font.insert(font.begin() + at, grow, 0);
+        for (size_t i = index + 1; i < loca.size(); i++) {
+            loca[i] += grow;
+        }
+        for (size_t i = 0; i < tables.records.size(); i++) {
+            TableRecord& record = tables.records[i];
+            if (record.offset >= at && &record != &glyf) {
+                record.offset += grow;
+                write_u32(font, 12 + 16 * i + 8, record.offset);
+            }
+        }
+        glyf.length += grow;
+        write_u32(font, 12 + 16 * tables.index[TABLE_GLYF] + 12, glyf.length);
+        capacity += grow;
     }
 
-    return glyphLength + glyphOffset; // switch to newGlyph.size() + glyphOffset; once shifting glyph table is done
+    size_t glyphStart = glyf.offset + loca[index];
+    std::copy(newGlyph.begin(), newGlyph.end(), font.begin() + glyphStart);
+    std::fill(font.begin() + glyphStart + newGlyph.size(), font.begin() + glyphStart + capacity, 0);
 }
 
 uint32_t calculate_checksum(const std::vector<uint8_t>& data, size_t offset, size_t length) {
@@ -165,45 +151,50 @@ uint32_t calculate_checksum(const std::vector<uint8_t>& data, size_t offset, siz
     return sum;
 }
 
-void update_checksums(std::vector<uint8_t>& font, std::unordered_map<std::string, TableDirectoryEntry>& tables) {
+void update_checksums(std::vector<uint8_t>& font, TableDirectory& tables) {
     uint32_t total = 0;
-    for (auto& [tag, entry] : tables) {
+    for (size_t i = 0; i < tables.records.size(); ++i) {
+        TableRecord& entry = tables.records[i];
         uint32_t checksum = calculate_checksum(font, entry.offset, entry.length);
         entry.checksum = checksum;
-        size_t dir_offset = 12 + (16 * distance(tables.begin(), tables.find(tag)));
+        size_t dir_offset = 12 + 16 * i; // records are kept in directory order
         write_u32(font, dir_offset + 4, checksum);
         total += checksum;
     }
 
     // Set checkSumAdjustment in head to 0 temporarily
-    auto& head = tables["head"];
-    write_u32(font, head.offset + 8, 0);
+    TableRecord* head = find_table(tables, TABLE_HEAD);
+    if (!head) {
+        return;
+    }
+    write_u32(font, head->offset + 8, 0);
     uint32_t font_checksum = calculate_checksum(font, 0, font.size());
     uint32_t checksum_adjustment = 0xB1B0AFBA - font_checksum;
-    write_u32(font, head.offset + 8, checksum_adjustment);
+    write_u32(font, head->offset + 8, checksum_adjustment);
 }
 
-// Update loca table
-uint32_t update_loca(std::vector<uint8_t>& font, TableDirectoryEntry& loca, uint16_t index, uint32_t newEnd, bool longLocaFormat, uint16_t numGlyphs) {
-    size_t locaOffset = loca.offset;
-    uint32_t oldEnd = 0;
-    uint32_t offsetDiff = 0;
-    if (longLocaFormat) {
-        oldEnd = read_u32(font, locaOffset + (index + 1) * 4);
-        offsetDiff = newEnd - oldEnd;
-        for (int i = index + 1; i < numGlyphs; i++) {
-            uint32_t oldVal = read_u32(font, locaOffset + i * 4);
-            write_u32(font, locaOffset + i * 4, oldVal + offsetDiff);
-        }
-    } else {
-        oldEnd = (uint32_t) read_u16(font, locaOffset + (index + 1) * 2);
-        offsetDiff = newEnd - oldEnd;
-        for (int i = index + 1; i < numGlyphs; i++) {
-            uint32_t oldVal = read_u16(font, locaOffset + i * 4);
-            write_u16(font, locaOffset + i * 4, oldVal + offsetDiff);
+std::vector<uint32_t> read_loca(const std::vector<uint8_t>& font, const TableRecord& loca, bool longLocaFormat, uint16_t numGlyphs) {
+    std::vector<uint32_t> offsets(numGlyphs + 1);
+    for (int i = 0; i <= numGlyphs; i++) {
+        offsets[i] = longLocaFormat ? read_u32(font, loca.offset + i * 4)
+                                    : (uint32_t) read_u16(font, loca.offset + i * 2) * 2;
+    }
+    return offsets;
+}
+
+// False when the offsets no longer fit the short format
+bool write_loca(std::vector<uint8_t>& font, const TableRecord& loca, const std::vector<uint32_t>& offsets, bool longLocaFormat) {
+    if (!longLocaFormat && offsets.back() > 0x1FFFE) {
+        return false;
+    }
+    for (size_t i = 0; i < offsets.size(); i++) {
+        if (longLocaFormat) {
+            write_u32(font, loca.offset + i * 4, offsets[i]);
+        } else {
+            write_u16(font, loca.offset + i * 2, offsets[i] / 2);
         }
     }
-    return offsetDiff;
+    return true;
 }
 
 void padTo4(std::vector<uint8_t>& font) {
@@ -211,66 +202,114 @@ void padTo4(std::vector<uint8_t>& font) {
     font.insert(font.end(), pad, 0);
 }
 
-void updateLengthRecord(std::vector<uint8_t>& font, uint32_t length) {
-    int numTables = read_u16(font, 4);
-    for (int i = 0; i < numTables; ++i) {
-        size_t offset = 12 + i * 16;
-        TableDirectoryEntry entry;
-        memcpy(entry.tag, &font[offset], 4);
-        entry.tag[4] = '\0';
-        if (strcmp(entry.tag, "glyf") == 0)
-            write_u32(font, offset + 12, length);
+// Edits the glyphs in font, whose directory and decoded loca the caller
+// has, and patches loca, the aggregates and the checksums to match
+static FontDiagnostic edit_glyphs(std::vector<uint8_t>& font, TableDirectory& tables, std::vector<uint32_t>& loca, bool longLocaFormat, const std::map<uint16_t, std::vector<WBPoint>>& glyphs, FontAggregates* aggregates) {
+    uint16_t numGlyphs = loca.size() - 1;
+    std::vector<uint16_t> edited;
+    for (const auto& glyph : glyphs) {
+        if (glyph.first >= numGlyphs) {
+            return {false, FONT_BAD_EDIT, "glyf", glyph.first, "glyph index out of range"};
+        }
+        modify_glyph(font, tables, loca, glyph.first, glyph.second);
+        if (aggregates) {
+            set_glyph_bounds(*aggregates, glyph.first, points_bounds(glyph.second));
+        }
+        edited.push_back(glyph.first);
     }
-}
-
-int writeback_one(std::vector<uint8_t>& font, int glyphIndex, std::vector<WBPoint> points, std::unordered_map<std::string, TableDirectoryEntry> tableMap, int numTables, bool longLocaFormat) {
-    if (!tableMap.count("glyf") || !tableMap.count("loca") || !tableMap.count("head")) {
-        return 1;
+    if (!write_loca(font, *find_table(tables, TABLE_LOCA), loca, longLocaFormat)) {
+        return {false, FONT_BAD_EDIT, "loca", -1, "glyf outgrew the short loca format"};
     }
-
-    uint32_t newOffset = modify_glyph(font, tableMap["glyf"], tableMap["loca"], glyphIndex, longLocaFormat, points); // modify glyph index 1
-
-    // update loca table
-    uint16_t numGlyphs = get_num_glyphs(font, tableMap["maxp"]);
-    uint32_t newDiff = update_loca(font, tableMap["loca"], glyphIndex, newOffset, longLocaFormat, numGlyphs);
-
     padTo4(font);
-    updateLengthRecord(font, newDiff + tableMap["glyf"].length);
-    tableMap["glyf"].length += newDiff;
 
-    update_checksums(font, tableMap);
+    // head/maxp/hhea come from the tree roots, so no glyph is rescanned
+    if (aggregates) {
+        write_font_aggregates(*aggregates, edited, font, tables);
+    }
+    update_checksums(font, tables);
+    return {true, FONT_OK, "", -1, ""};
+}
 
-    return 0;
+static FontDiagnostic write_font_file(const std::string& output_filename, const std::vector<uint8_t>& font) {
+    std::ofstream out(output_filename, std::ios::binary);
+    out.write(reinterpret_cast<const char*>(font.data()), font.size());
+    out.close();
+    if (!out) {
+        return {false, FONT_IO, "", -1, "could not write " + output_filename};
+    }
+    return {true, FONT_OK, "", -1, ""};
 }
 
-int writeback(std::string input_filename, std::string output_filename, std::vector<int> glyphIndices, std::vector<std::vector<WBPoint>> pointsVector) {
+FontDiagnostic writeback(const std::string& input_filename, const std::string& output_filename, const std::map<uint16_t, std::vector<WBPoint>>& glyphs, FontAggregates* aggregates) {
     std::ifstream in(input_filename, std::ios::binary);
     if (!in) {
-        return 1;
+        return {false, FONT_IO, "", -1, "could not read " + input_filename};
     }
 
     std::vector<uint8_t> font((std::istreambuf_iterator<char>(in)), {});
     in.close();
 
-    int numTables = 0;
-    auto tableMap = parse_table_directory(font, numTables);
-    if (!tableMap.count("glyf") || !tableMap.count("loca") || !tableMap.count("head")) {
-        return 1;
+    if (font.size() < 12) {
+        return {false, FONT_TRUNCATED, "", -1, "file shorter than the sfnt header"};
+    }
+    TableDirectory tables = parse_table_directory(&font[12], read_u16(font, 4));
+    for (TableId required : {TABLE_GLYF, TABLE_LOCA, TABLE_HEAD, TABLE_MAXP}) {
+        if (!has_table(tables, required)) {
+            return {false, FONT_MISSING_TABLE, tag_name(TABLE_TAGS[required]), -1, "required table missing"};
+        }
     }
 
-    bool longLocaFormat = read_u16(font, tableMap["head"].offset + 50) != 0;
+    bool longLocaFormat = read_u16(font, find_table(tables, TABLE_HEAD)->offset + 50) != 0;
+    uint16_t numGlyphs = get_num_glyphs(font, *find_table(tables, TABLE_MAXP));
 
-    std::cerr << "starting loop:\n";
-    for (int i = 0; i < pointsVector.size(); i++) {
-        int w_one = writeback_one(font, glyphIndices[i], pointsVector[i], tableMap, numTables, longLocaFormat);
-        if (w_one) {
-            return 1;
-        }
+    // loca is decoded once, kept in memory while the glyphs are written and
+    // encoded once at the end
+    std::vector<uint32_t> loca = read_loca(font, *find_table(tables, TABLE_LOCA), longLocaFormat, numGlyphs);
+    FontDiagnostic diag = edit_glyphs(font, tables, loca, longLocaFormat, glyphs, aggregates);
+    if (!diag.ok) {
+        return diag;
     }
+    return write_font_file(output_filename, font);
+}
 
-    std::ofstream out(output_filename, std::ios::binary);
-    out.write(reinterpret_cast<const char*>(font.data()), font.size());
-    out.close();
+FontDiagnostic writeback_font(const VerifiedFont& font, const std::string& output_filename, const std::map<uint16_t, std::vector<WBPoint>>& glyphs, FontAggregates* aggregates, VerifiedFont& edited) {
+    if (font.loca.empty()) {
+        return {false, FONT_MISSING_TABLE, "glyf", -1, "only glyf outlines can be edited"};
+    }
+    edited = VerifiedFont();
+    edited.data = font.data;
+    edited.tables = font.tables;
+    edited.loca = font.loca;
+    edited.numGlyphs = font.numGlyphs;
+    edited.unitsPerEm = font.unitsPerEm;
+    edited.glyfOffset = font.glyfOffset; // glyf itself never moves
+    edited.shortLoca = font.shortLoca;
+    FontDiagnostic diag = edit_glyphs(edited.data, edited.tables, edited.loca, !font.shortLoca, glyphs, aggregates);
+    if (!diag.ok) {
+        return diag;
+    }
 
-    return 0;
+    std::vector<uint16_t> ids;
+    for (const auto& glyph : glyphs) {
+        ids.push_back(glyph.first);
+    }
+    diag = check_glyphs(edited, ids);
+    if (!diag.ok) {
+        return diag;
+    }
+
+    // cmap, kern/GPOS and what is built from them are not touched by an edit
+    edited.charMap = std::atomic_load(&font.charMap);
+    edited.kerning = std::atomic_load(&font.kerning);
+    edited.coverage = std::atomic_load(&font.coverage);
+    if (edited.charMap) {
+        edited.cacheBytes.bytes += sizeof(CharMap) + char_map_bytes(*edited.charMap);
+    }
+    if (edited.kerning) {
+        edited.cacheBytes.bytes += sizeof(KernTable) + kern_table_bytes(*edited.kerning);
+    }
+    if (edited.coverage) {
+        edited.cacheBytes.bytes += sizeof(CoverageSet) + coverage_bytes(*edited.coverage);
+    }
+    return write_font_file(output_filename, edited.data);
 }
@@ -1,15 +1,31 @@
 #ifndef WRITEBACK_H
 #define WRITEBACK_H
 
+#include <cstdint>
+#include <map>
 #include <string>
 #include <vector>
 
+#include "validate.h"
+
+struct FontAggregates;
+
 struct WBPoint {
     int x, y;
     bool onCurve;
     bool endPt;
 };
 
-int writeback(std::string input_filename, std::string output_filename, std::vector<int> glyphIndices, std::vector<std::vector<WBPoint>> points);
+// Rewrites each glyph in the map with its new points, in glyph order. With
+// aggregates, the glyphs' new bounds are folded in and head/maxp/hhea are
+// refreshed from them; without, those tables are left as they were. The
+// output is left untouched when the diagnostic is not ok.
+FontDiagnostic writeback(const std::string& input_filename, const std::string& output_filename, const std::map<uint16_t, std::vector<WBPoint>>& glyphs, FontAggregates* aggregates = nullptr);
+
+// The same edit applied to a verified font in memory: edited starts as a
+// copy of font's bytes, directory and loca, only the edited glyphs are
+// checked again, and it is written to output_filename. The cmap and
+// kerning caches font has built carry over.
+FontDiagnostic writeback_font(const VerifiedFont& font, const std::string& output_filename, const std::map<uint16_t, std::vector<WBPoint>>& glyphs, FontAggregates* aggregates, VerifiedFont& edited);
 
 #endif